@@ -10,7 +10,11 @@
 #include <btas/generic/cp_als.h>
 #include <btas/generic/cp_rals.h>
 #include <btas/generic/cp_df_als.h>
+#include <btas/generic/cp_arls.h>
+#include <btas/generic/cp_gn.h>
+#include <btas/generic/cp_batch.h>
 #include <btas/generic/coupled_cp_als.h>
+#include <btas/generic/tensor_train.h>
 #include <btas/generic/dot_impl.h>
 #include <btas/generic/scal_impl.h>
 #include <btas/generic/axpy_impl.h>
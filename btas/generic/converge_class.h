@@ -1,12 +1,70 @@
 #ifndef BTAS_GENERIC_CONV_BASE_CLASS
 #define BTAS_GENERIC_CONV_BASE_CLASS
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include <btas/generic/dot_impl.h>
+#include <btas/generic/numeric_type.h>
 #include <btas/varray/varray.h>
 
 namespace btas {
+  namespace detail {
+    // Squared norm of the CP model made of the factors modes[0..nmodes) of A
+    // and the weights A.back(),
+    // <M, M> = sum_rs conj(lambda_r) lambda_s prod_m (A_m^H A_m)(r,s),
+    // in O(nmodes R^2) from the cached Gram matrices V, indexed like A. If V
+    // is empty the Gram matrices are computed into grams, which keeps its
+    // buffers between calls.
+    template <typename Tensor>
+    double cp_norm2_from_grams(const std::vector<Tensor> &A, const std::vector<Tensor> &V, const size_t *modes,
+                               size_t nmodes, std::vector<Tensor> &grams) {
+      using value_type = typename Tensor::value_type;
+      size_t rank = A[0].extent(1);
+      const value_type *lambda = A.back().data();
+      if (V.empty()) {
+        grams.resize(std::max(grams.size(), nmodes));
+        for (size_t m = 0; m < nmodes; ++m) {
+          if (grams[m].size() != rank * rank) grams[m] = Tensor(rank, rank);
+          gemm(impl::adjoint_trans<value_type>(), CblasNoTrans, 1.0, A[modes[m]], A[modes[m]], 0.0, grams[m]);
+        }
+      }
+
+      double nrm = 0.0;
+      for (size_t r = 0; r < rank; ++r) {
+        for (size_t s = 0; s < rank; ++s) {
+          value_type c = impl::conj(lambda[r]) * lambda[s];
+          for (size_t m = 0; m < nmodes; ++m)
+            c *= (V.empty() ? grams[m] : V[modes[m]]).data()[r * rank + s];
+          nrm += std::real(c);
+        }
+      }
+      return std::abs(nrm);
+    }
+
+    // Re <M, T> from the MTTKRP of one mode of T,
+    // sum_ir conj(lambda_r A(i,r)) MtKRP(i,r), in O(I R)
+    template <typename Tensor>
+    double cp_inner_from_mttkrp(const Tensor &A, const Tensor &lambda, const Tensor &MtKRP) {
+      using value_type = typename Tensor::value_type;
+      size_t rows = A.extent(0), rank = A.extent(1);
+      const value_type *a = A.data(), *m = MtKRP.data(), *l = lambda.data();
+      value_type iprod(0);
+      for (size_t i = 0; i < rows; ++i)
+        for (size_t r = 0; r < rank; ++r)
+          iprod += impl::conj(l[r] * a[i * rank + r]) * m[i * rank + r];
+      return std::real(iprod);
+    }
+
+    // Copies src into dst, reusing the buffer of dst
+    template <typename Tensor>
+    void copy_into(const Tensor &src, Tensor &dst) {
+      if (dst.size() != src.size()) dst = Tensor(src.range());
+      std::copy(src.begin(), src.end(), dst.begin());
+    }
+  }  // namespace detail
+
   /**
     \brief Default class to deciding when the ALS problem is converged
     Instead of using the change in the loss function
@@ -31,9 +89,11 @@ namespace btas {
     /// Function to check convergence of the ALS problem
     /// convergence when \f$ \sum_n^{ndim} \frac{\|A^{i}_n - A^{i+1}_n\|}{dim(A^{i}_n} \leq \epsilon \f$
     /// \param[in] btas_factors Current set of factor matrices
-    bool operator () (const std::vector<Tensor> & btas_factors){
+    /// \param[in] V Cached Gram matrices of the factors, not used by this test
+    bool operator () (const std::vector<Tensor> & btas_factors,
+                      const std::vector<Tensor> & V = std::vector<Tensor>()){
       size_t ndim = btas_factors.size() - 1;
-      if (prev.empty() || prev[0].size() != btas_factors[0].size()) {
+      if (prev.size() != ndim || prev[0].size() != btas_factors[0].size()) {
         prev.clear();
         for (size_t i = 0; i < ndim; ++i) {
           prev.push_back(Tensor(btas_factors[i].range()));
@@ -41,13 +101,19 @@ namespace btas {
         }
       }
 
+      // The change and the update of prev in one pass, without temporaries
       auto diff = 0.0;
       rank_ = btas_factors[0].extent(1);
       for (size_t r = 0; r < ndim; ++r) {
         ord_t elements = btas_factors[r].size();
-        auto change = prev[r] - btas_factors[r];
-        diff += std::sqrt(btas::dot(change, change) / elements);
-        prev[r] = btas_factors[r];
+        auto *ptr_prev = prev[r].data();
+        const auto *ptr_A = btas_factors[r].data();
+        double change = 0.0;
+        for (ord_t i = 0; i < elements; ++i) {
+          change += std::norm(ptr_A[i] - ptr_prev[i]);
+          ptr_prev[i] = ptr_A[i];
+        }
+        diff += std::sqrt(change / elements);
       }
 
       if (diff < this->tol_) {
@@ -86,32 +152,16 @@ namespace btas {
     /// Function to check convergence of the ALS problem
     /// convergence when \f$ \|T - \hat{T}^{i+1}_n\|}{dim(A^{i}_n} \leq \epsilon \f$
     /// \param[in] btas_factors Current set of factor matrices
-    bool operator()(const std::vector<Tensor> &btas_factors) {
+    /// \param[in] V Cached Gram matrices \f$ A^T A \f$ of the factors, if empty they
+    /// are recomputed from \c btas_factors
+    bool operator()(const std::vector<Tensor> &btas_factors,
+                    const std::vector<Tensor> &V = std::vector<Tensor>()) {
       if (normT_ < 0) BTAS_EXCEPTION("One must set the norm of the reference tensor");
+      // <T_hat, T> from the MTTKRP of the last mode, <T_hat, T_hat> from the Gram matrices
       auto n = btas_factors.size() - 2;
-      ord_t size = btas_factors[n].size();
-      ind_t rank = btas_factors[n].extent(1);
-      Tensor temp(btas_factors[n + 1].range());
-      temp.fill(0.0);
-      auto *ptr_A = btas_factors[n].data();
-      auto *ptr_MtKRP = MtKRP_.data();
-      for (ord_t i = 0; i < size; ++i) {
-        *(ptr_MtKRP + i) *= *(ptr_A + i);
-      }
-
-      auto * ptr_temp = temp.data();
-      for (ord_t i = 0; i < size; ++i) {
-        *(ptr_temp + i % rank) += *(ptr_MtKRP + i);
-      }
+      double iprod = detail::cp_inner_from_mttkrp(btas_factors[n], btas_factors[n + 1], MtKRP_);
 
-      size = temp.size();
-      ptr_A = btas_factors[n+1].data();
-      double iprod = 0.0;
-      for (ord_t i = 0; i < size; ++i) {
-        iprod += *(ptr_temp + i) * *(ptr_A + i);
-      }
-
-      double normFactors = norm(btas_factors);
+      double normFactors = norm(btas_factors, V);
       double normResidual = sqrt(abs(normT_ * normT_ + normFactors * normFactors - 2 * iprod));
       double fit = 1 - (normResidual / normT_);
 
@@ -140,17 +190,33 @@ namespace btas {
     }
 
     void set_MtKRP(Tensor & MtKRP){
-      MtKRP_ = MtKRP;
+      detail::copy_into(MtKRP, MtKRP_);
     }
 
     double get_fit(){
       return final_fit_;
     }
 
+    /// Overrides the fit reported by get_fit(), e.g. with an exactly
+    /// computed fit when the test only saw estimates of the fit
+    void set_fit(double fit){
+      final_fit_ = fit;
+    }
+
     void verbose(bool verb) {
       verbose_ = verb;
     }
 
+    /// \returns the fit of the latest sweep, -1 before the first sweep or after convergence
+    double get_last_fit() const {
+      return fitOld_;
+    }
+
+    /// Restores the fit of the latest sweep, e.g. when resuming from a checkpoint
+    void set_last_fit(double fit){
+      fitOld_ = fit;
+    }
+
   private:
     double tol_;
     double fitOld_ = -1.0;
@@ -161,29 +227,13 @@ namespace btas {
     Tensor MtKRP_;
     bool verbose_ = false;
 
-    double norm(const std::vector<Tensor> &btas_factors) {
-      ind_t rank = btas_factors[0].extent(1);
-      auto n = btas_factors.size() - 1;
-      Tensor coeffMat;
-      auto &temp1 = btas_factors[n];
-      ger(1.0, temp1, temp1, coeffMat);
-
-      auto rank2 = rank * (ord_t) rank;
-      Tensor temp(rank, rank);
-      for (size_t i = 0; i < n; ++i) {
-        gemm(CblasTrans, CblasNoTrans, 1.0, btas_factors[i], btas_factors[i], 0.0, temp);
-        auto *ptr_coeff = coeffMat.data();
-        auto *ptr_temp = temp.data();
-        for (ord_t j = 0; j < rank2; ++j) {
-          *(ptr_coeff + j) *= *(ptr_temp + j);
-        }
-      }
+    std::vector<Tensor> grams_;
+    std::vector<size_t> modes_;
 
-      auto nrm = 0.0;
-      for(auto & i: coeffMat){
-        nrm += i;
-      }
-      return sqrt(abs(nrm));
+    double norm(const std::vector<Tensor> &btas_factors, const std::vector<Tensor> &V) {
+      modes_.resize(btas_factors.size() - 1);
+      for (size_t i = 0; i < modes_.size(); ++i) modes_[i] = i;
+      return sqrt(detail::cp_norm2_from_grams(btas_factors, V, modes_.data(), modes_.size(), grams_));
     }
   };
 
@@ -212,76 +262,26 @@ namespace btas {
     /// Function to check convergence of the ALS problem
     /// convergence when \f$ \|T - \hat{T}^{i+1}_n\|}{dim(A^{i}_n} \leq \epsilon \f$
     /// \param[in] btas_factors Current set of factor matrices
-    bool operator () (const std::vector<Tensor> & btas_factors) {
+    /// \param[in] V Cached Gram matrices \f$ A^T A \f$ of the factors, if empty they
+    /// are recomputed from \c btas_factors
+    bool operator () (const std::vector<Tensor> & btas_factors,
+                      const std::vector<Tensor> & V = std::vector<Tensor>()) {
       if (normTR_ < 0 || normTL_ < 0) BTAS_EXCEPTION("One must set the norm of the reference tensor");
 
-      // First KRP (hadamard contract) out the first dimension of MtKRP using the last factor matrix
-      // Need to do this for the right and the left side
-      ord_t contract_size = btas_factors[ndimL_ - 1].extent(0);
-      ord_t rank = btas_factors[0].extent(1);
-      Tensor tempL(rank), tempR(rank);
-      tempL.fill(0.0);
-      tempR.fill(0.0);
-
-      {
-        auto &A = btas_factors[ndimL_ - 1];
-        for (ord_t i = 0; i < contract_size; ++i) {
-          auto *ptr_A = A.data() + i * rank;
-          auto *ptr_MtKRP = MtKRPL_.data() + i * rank;
-          for (ord_t r = 0; r < rank; ++r) {
-            *(tempL.data() + r) += *(ptr_A + r) * *(ptr_MtKRP + r);
-          }
-        }
-      }
-
-      {
-        auto n = btas_factors.size() - 2;
-        contract_size = btas_factors[n].extent(0);
-        auto &A = btas_factors[n];
-        for (ord_t i = 0; i < contract_size; ++i) {
-          auto *ptr_A = A.data() + i * rank;
-          auto *ptr_MtKRP = MtKRPR_.data() + i * rank;
-          for (ord_t r = 0; r < rank; ++r) {
-            *(tempR.data() + r) += *(ptr_A + r) * *(ptr_MtKRP + r);
-          }
-        }
-      }
-
-      // Scale the final product by lambdas
-      // These are the innerproducts of left and right tensors with their factors
-      double iprodL = 0.0;
-      double iprodR = 0.0;
+      // The inner products of the left and right tensors with their models
+      // from the MTTKRP of the last mode of each side
       auto n = btas_factors.size() - 1;
-      {
-        auto * ptr_A = btas_factors[n].data();
-        auto * ptr_temp = tempL.data();
-        for (ord_t i = 0; i < rank; ++i) {
-          iprodL += *(ptr_temp + i) * *(ptr_A + i);
-        }
-      }
-      {
-        auto * ptr_A = btas_factors[n].data();
-        auto * ptr_temp = tempR.data();
-        for (ord_t i = 0; i < rank; ++i) {
-          iprodR += *(ptr_temp + i) * *(ptr_A + i);
-        }
-      }
-
-      // Take the inner product of the factors <[[A,B,C..]], [[A,B,C,...]]>
-      std::vector<Tensor> tensors_left;
-      std::vector<Tensor> tensors_right;
-      tensors_left.push_back(btas_factors[0]);
-      tensors_right.push_back(btas_factors[0]);
-      for (size_t i = 1; i < ndimL_; ++i) {
-        tensors_left.push_back(btas_factors[i]);
-      }
-      for (size_t i = ndimL_; i < n + 1; ++i) {
-        tensors_right.push_back(btas_factors[i]);
-      }
-      tensors_left.push_back(btas_factors[n]);
-
-      double normFactorsL = norm(tensors_left);
-      double normFactorsR = norm(tensors_right);
+      double iprodL = detail::cp_inner_from_mttkrp(btas_factors[ndimL_ - 1], btas_factors[n], MtKRPL_);
+      double iprodR = detail::cp_inner_from_mttkrp(btas_factors[n - 1], btas_factors[n], MtKRPR_);
+
+      // Take the inner product of the factors <[[A,B,C..]], [[A,B,C,...]]>,
+      // the coupled mode 0 belongs to both models
+      modes_.resize(n);
+      for (size_t i = 0; i < n; ++i) modes_[i] = i;
+      double normFactorsL = sqrt(detail::cp_norm2_from_grams(btas_factors, V, modes_.data(), ndimL_, grams_));
+      modes_[ndimL_ - 1] = 0;
+      double normFactorsR = sqrt(detail::cp_norm2_from_grams(btas_factors, V, modes_.data() + ndimL_ - 1,
+                                                             n - ndimL_ + 1, grams_));
 
       // Find the residual sqrt(<T,T>  + <[[A,B,C...]],[[A,B,C,...]]> - 2 * <T, [[A,B,C,...]]>)
       double normResidualL = sqrt(abs(normTL_ * normTL_ + normFactorsL * normFactorsL - 2 * iprodL));
@@ -308,11 +308,11 @@ namespace btas {
     }
 
     void set_MtKRPL(Tensor & MtKRPL){
-      MtKRPL_ = MtKRPL;
+      detail::copy_into(MtKRPL, MtKRPL_);
     }
 
     void set_MtKRPR(Tensor & MtKRPR){
-      MtKRPR_ = MtKRPR;
+      detail::copy_into(MtKRPR, MtKRPR_);
     }
 
     double get_fit(){
@@ -328,31 +328,8 @@ namespace btas {
     Tensor MtKRPL_, MtKRPR_;
     size_t ndimL_;
 
-    double norm(const std::vector<Tensor> & btas_factors) {
-      ord_t rank = btas_factors[0].extent(1);
-      auto n = btas_factors.size() - 1;
-      Tensor coeffMat(rank, rank);
-      auto temp = btas_factors[n];
-      temp.resize(Range{Range1{rank}, Range1{1}});
-      gemm(CblasNoTrans, CblasTrans, 1.0, temp, temp, 0.0, coeffMat);
-
-      auto rank2 = rank * rank;
-      for (size_t i = 0; i < n; ++i) {
-        Tensor temp(rank, rank);
-        gemm(CblasTrans, CblasNoTrans, 1.0, btas_factors[i], btas_factors[i], 0.0, temp);
-        auto *ptr_coeff = coeffMat.data();
-        auto *ptr_temp = temp.data();
-        for (ord_t j = 0; j < rank2; ++j) {
-          *(ptr_coeff + j) *= *(ptr_temp + j);
-        }
-      }
-
-      auto nrm = 0.0;
-      for(auto & i: coeffMat){
-        nrm += i;
-      }
-      return sqrt(abs(nrm));
-    }
+    std::vector<Tensor> grams_;
+    std::vector<size_t> modes_;
   };
 } //namespace btas
 #endif  // BTAS_GENERIC_CONV_BASE_CLASS
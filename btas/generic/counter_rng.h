@@ -0,0 +1,130 @@
+#ifndef BTAS_GENERIC_COUNTER_RNG_H
+#define BTAS_GENERIC_COUNTER_RNG_H
+
+#include <btas/generic/task_pool.h>
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+
+namespace btas {
+
+  /// Counter based random number generator, Philox4x32-10 of Salmon et al.
+  /// <a href=https://doi.org/10.1145/2063384.2063405> See reference </a>.
+  /// Every draw is a pure function of the seed, the stream and the index of
+  /// the draw, so any element of a random tensor can be computed
+  /// independently of the others. Tensors filled by fill_random_uniform() and
+  /// fill_random_normal() are therefore the same for every thread count.
+  class CounterRNG {
+  public:
+    using result_type = std::array<uint32_t, 4>;
+
+    /// \param[in] seed Seed of the generator
+    /// \param[in] stream Independent sequences of the same seed, e.g. one per factor matrix
+    explicit CounterRNG(uint32_t seed, uint32_t stream = 0) : key_{{seed, stream}} {}
+
+    /// \returns the 128 random bits of draw \c index
+    result_type operator()(uint64_t index) const {
+      result_type ctr = {{uint32_t(index), uint32_t(index >> 32), 0, 0}};
+      std::array<uint32_t, 2> key = key_;
+      for (int r = 0; r < 10; ++r) {
+        uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+        uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+        ctr = {{uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1), uint32_t(p0 >> 32) ^ ctr[3] ^ key[1],
+                uint32_t(p0)}};
+        key[0] += 0x9E3779B9;
+        key[1] += 0xBB67AE85;
+      }
+      return ctr;
+    }
+
+    /// \returns a double in [0, 1) made of the 53 high bits of \c hi and \c lo
+    static double to_unit(uint32_t hi, uint32_t lo) {
+      return double(((uint64_t(hi) << 32) | lo) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /// \returns two uniform draws in [0, 1) from draw \c index
+    std::array<double, 2> uniform(uint64_t index) const {
+      auto w = (*this)(index);
+      return {{to_unit(w[0], w[1]), to_unit(w[2], w[3])}};
+    }
+
+    /// \returns two independent standard normal draws from draw \c index, Box-Muller transform
+    std::array<double, 2> normal(uint64_t index) const {
+      auto u = uniform(index);
+      // 1 - u is in (0, 1], the log is finite
+      double r = std::sqrt(-2.0 * std::log(1.0 - u[0]));
+      double theta = 6.283185307179586 * u[1];
+      return {{r * std::cos(theta), r * std::sin(theta)}};
+    }
+
+  private:
+    std::array<uint32_t, 2> key_;
+  };
+
+  namespace detail {
+
+    // Builds an element from the pair of draws of its index, complex
+    // elements use both of them.
+    template <typename T>
+    struct random_element {
+      static T make(const std::array<double, 2> &x) { return T(x[0]); }
+    };
+    template <typename T>
+    struct random_element<std::complex<T>> {
+      static std::complex<T> make(const std::array<double, 2> &x) { return std::complex<T>(T(x[0]), T(x[1])); }
+    };
+
+    // Sets element i of the contiguous storage to f(i), the range is split in
+    // nthreads equal chunks.
+    template <typename Tensor, typename F>
+    void fill_indexed(Tensor &A, size_t nthreads, F f) {
+      using value_type = typename Tensor::value_type;
+      value_type *data = A.data();
+      parallel_chunks(A.size(), nthreads, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) data[i] = random_element<value_type>::make(f(i));
+      });
+    }
+  }  // namespace detail
+
+  /// Fills \c A with numbers drawn uniformly from [low, high), the real and
+  /// imaginary parts of complex tensors are drawn independently.
+  /// \param[in,out] A Tensor with contiguous storage
+  /// \param[in] low Lower bound
+  /// \param[in] high Upper bound
+  /// \param[in] seed Seed of the generator
+  /// \param[in] stream Stream of the generator, tensors of the same seed should use different streams
+  /// \param[in] nthreads Number of threads, does not change the result. Default = 1, 0 = all cores
+  template <typename Tensor>
+  void fill_random_uniform(Tensor &A, double low, double high, uint32_t seed, uint32_t stream = 0,
+                           size_t nthreads = 1) {
+    CounterRNG rng(seed, stream);
+    double width = high - low;
+    detail::fill_indexed(A, nthreads, [&](uint64_t i) {
+      auto u = rng.uniform(i);
+      return std::array<double, 2>{{low + width * u[0], low + width * u[1]}};
+    });
+  }
+
+  /// Fills \c A with numbers drawn from a normal distribution, the real and
+  /// imaginary parts of complex tensors are drawn independently.
+  /// \param[in,out] A Tensor with contiguous storage
+  /// \param[in] mean Mean of the distribution
+  /// \param[in] stddev Standard deviation of the distribution
+  /// \param[in] seed Seed of the generator
+  /// \param[in] stream Stream of the generator, tensors of the same seed should use different streams
+  /// \param[in] nthreads Number of threads, does not change the result. Default = 1, 0 = all cores
+  template <typename Tensor>
+  void fill_random_normal(Tensor &A, double mean, double stddev, uint32_t seed, uint32_t stream = 0,
+                          size_t nthreads = 1) {
+    CounterRNG rng(seed, stream);
+    detail::fill_indexed(A, nthreads, [&](uint64_t i) {
+      auto z = rng.normal(i);
+      return std::array<double, 2>{{mean + stddev * z[0], mean + stddev * z[1]}};
+    });
+  }
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_COUNTER_RNG_H
@@ -33,8 +33,8 @@ namespace btas{
     and $Z \in \mathbb{R}^{X \times \dots}$ and thus share a factor matrix
     Decomposition optimization will use alternating least squares (ALS).
 
-   \warning this code takes a non-const reference \c tensor_ref but does
-   not modify the values. This is a result of API (reshape needs non-const tensor)
+   \note the coupled tensors are held by const reference and are never
+   modified, so several solvers may share them concurrently.
 
     Synopsis:
     \code
@@ -81,6 +81,7 @@ namespace btas{
   class COUPLED_CP_ALS : public CP<Tensor, ConvClass> {
   public:
     using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
     using CP<Tensor,ConvClass>::ndim;
     using CP<Tensor,ConvClass>::normCol;
     using CP<Tensor,ConvClass>::generate_KRP;
@@ -95,7 +96,7 @@ namespace btas{
     /// Reference tensor has no symmetries.
     /// \param[in] left the reference tensor, $B$ to be decomposed.
     /// \param[in] right the reference tensor, $Z$ to be decomposed.
-    COUPLED_CP_ALS(Tensor& left, Tensor& right) :
+    COUPLED_CP_ALS(const Tensor& left, const Tensor& right) :
             CP<Tensor, ConvClass>(left.rank() + right.rank() - 1),
             tensor_ref_left(left), tensor_ref_right(right), ndimL(left.rank())
     {
@@ -114,7 +115,7 @@ namespace btas{
     /// \param[in] left the reference tensor, $B$ to be decomposed.
     /// \param[in] right the reference tensor, $Z$ to be decomposed.
     /// \param[in] symms the symmetries of the reference tensor.
-    COUPLED_CP_ALS(Tensor &left, Tensor &right, std::vector<size_t> &symms) :
+    COUPLED_CP_ALS(const Tensor &left, const Tensor &right, std::vector<size_t> &symms) :
             CP<Tensor, ConvClass>(left.rank() + right.rank()),
             tensor_ref_left(left), tensor_ref_right(right), ndimL(left.rank())
     {
@@ -154,8 +155,8 @@ namespace btas{
     }
 
   protected:
-    Tensor &tensor_ref_left;        // Tensor in first term of the loss function
-    Tensor &tensor_ref_right;       // Tensor in second term of the loss function
+    const Tensor &tensor_ref_left;  // Tensor in first term of the loss function
+    const Tensor &tensor_ref_right; // Tensor in second term of the loss function
     size_t ndimL;                      // Number of dimensions the left tensor has
 
     /// Creates an initial guess by computing the SVD of each mode
@@ -219,10 +220,10 @@ namespace btas{
           bool left = tensor == 0;
           for (size_t i = left ? 0 : 1; i < ndim_curr; i++) {
             ind_t R = tensor_ref.extent(i);
-            Tensor S(R, R), lambda(R);
+            Tensor S, lambda(R);
 
             // Contract refrence tensor to make it square matrix of mode i
-            gemm(CblasNoTrans, CblasTrans, 1.0, flatten(tensor_ref, i), flatten(tensor_ref, i), 0.0, S);
+            mode_gram(tensor_ref, i, S);
 
             // Find the Singular vectors of the matrix using eigenvalue decomposition
             eigenvalue_decomp(S, lambda);
@@ -381,19 +382,30 @@ namespace btas{
       // intermediate
       bool is_converged = false;
       bool matlab = fast_pI;
+      // Gram matrices of the factors are cached and only recomputed when a factor changes
+      this->init_gram();
       while (count < max_als && !is_converged) {
         count++;
         this->num_ALS++;
+        auto sweep_start = this->observe_sweep_begin(count, rank);
         for (size_t i = 0; i < ndim; i++) {
           auto tmp = symmetries[i];
           if (tmp == i) {
+            auto mode_start = this->observe_mode_begin();
             direct(i, rank, fast_pI, matlab, converge_test);
+            // the coupled mode contracts both tensors, the others only one
+            double ref_size = i == 0 ? (double) tensor_ref_left.size() + tensor_ref_right.size()
+                                     : (double) (i < ndimL ? tensor_ref_left : tensor_ref_right).size();
+            this->observe_mode_end(i, mode_start, 2.0 * ref_size * rank);
           } else {
             A[i] = A[tmp];
+            AtA[i] = AtA[tmp];
           }
         }
         detail::get_fit(converge_test, epsilon);
-        is_converged = converge_test(A);
+        auto converge_start = this->phase_start();
+        is_converged = converge_test(A, AtA);
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
       }
     }
 
@@ -433,12 +445,9 @@ namespace btas{
                   contract_size = tensor_ref.extent(ndim_curr - 1),
                   LHSsize = tensor_ref.size() / contract_size;
 
-          auto R = tensor_ref.range();
 
           Tensor contract_tensor(LHSsize, rank);
-          tensor_ref.resize(Range{Range1{LHSsize}, Range1{contract_size}});
-          gemm(CblasNoTrans, CblasNoTrans, 1.0, tensor_ref, A[A_dim], 0.0, contract_tensor);
-          tensor_ref.resize(R);
+          detail::gemm_matricized(CblasNoTrans, tensor_ref, LHSsize, contract_size, A[A_dim], contract_tensor);
           --A_dim;
           for (size_t contract_dim = ndim_curr - 2; contract_dim > 0; --contract_dim, --A_dim) {
             contract_size = tensor_ref.extent(contract_dim);
@@ -467,32 +476,37 @@ namespace btas{
         auto rank2 = rank * (ord_t) rank;
         {
           for (size_t i = 1; i < ndimL; ++i) {
-            Tensor temp(rank, rank);
-            gemm(CblasTrans, CblasNoTrans, 1.0, A[i], A[i], 0.0, temp);
+            const auto *gram_ptr = AtA[i].data();
             for (ord_t j = 0; j < rank2; ++j) {
-              *(J1.data() + j) *= *(temp.data() + j);
+              *(J1.data() + j) *= *(gram_ptr + j);
             }
           }
           Tensor J2(rank, rank);
           J2.fill(1.0);
           for (size_t i = ndimL; i < ndim; ++i) {
-            Tensor temp(rank, rank);
-            gemm(CblasTrans, CblasNoTrans, 1.0, A[i], A[i], 0.0, temp);
+            const auto *gram_ptr = AtA[i].data();
             for (ord_t j = 0; j < rank2; ++j) {
-              *(J2.data() + j) *= *(temp.data() + j);
+              *(J2.data() + j) *= *(gram_ptr + j);
             }
           }
           J1 += J2;
         }
         // Finally Form the product of K * J^\dagger
-        Tensor a0(coupled_dim, rank);
-        gemm(CblasNoTrans, CblasNoTrans, 1.0, K, pseudoInverse(J1, fast_pI), 0.0, a0);
-        this->normCol(a0);
-        A[0] = a0;
+        if (matlab) {
+          spd_solve(J1, K, this->solve_counter);
+        } else {
+          Tensor a0(coupled_dim, rank);
+          gemm(CblasNoTrans, CblasNoTrans, 1.0, K, pseudoInverse(J1, fast_pI), 0.0, a0);
+          ++(fast_pI ? this->solve_counter.fast_pinv : this->solve_counter.svd);
+          K = a0;
+        }
+        this->normCol(K);
+        A[0] = K;
+        this->update_gram(0);
       }
       else {
         bool left = n < ndimL;
-        Tensor &tensor_ref = left ? tensor_ref_left : tensor_ref_right;
+        const Tensor &tensor_ref = left ? tensor_ref_left : tensor_ref_right;
 
         size_t ndim_curr = tensor_ref.rank(),
                 A_dim = 0,
@@ -500,13 +514,10 @@ namespace btas{
                 LHSsize = tensor_ref.size() / contract_size,
                 pseudo_rank = rank,
                 skip_dim = A[n].extent(0);
-        auto R = tensor_ref.range();
 
-        tensor_ref.resize(Range{Range1{contract_size}, Range1{LHSsize}});
         Tensor contract_tensor(LHSsize, rank);
-        gemm(CblasTrans, CblasNoTrans, 1.0, tensor_ref, A[A_dim], 0.0, contract_tensor);
+        detail::gemm_matricized(CblasTrans, tensor_ref, contract_size, LHSsize, A[A_dim], contract_tensor);
 
-        tensor_ref.resize(R);
         A_dim = left ? ndimL - 1 : ndim - 1;
         // TODO Use pointer arithmetic here instead of () operator
         for (size_t contract_dim = ndim_curr - 1; contract_dim > 0; --contract_dim, --A_dim) {
@@ -546,15 +557,13 @@ namespace btas{
         }
         contract_tensor.resize(Range{Range1{skip_dim}, Range1{rank}});
 
-        Tensor G(rank, rank);
-        gemm(CblasTrans, CblasNoTrans, 1.0, A[0], A[0], 0.0, G);
+        Tensor G = AtA[0];
         auto rank2 = rank * (ord_t) rank;
         for (size_t i = (left ? 1 : ndimL); i < (left ? ndimL : ndim); ++i) {
           if (i != n) {
-            Tensor temp(rank, rank);
-            gemm(CblasTrans, CblasNoTrans, 1.0, A[i], A[i], 0.0, temp);
+            const auto *gram_ptr = AtA[i].data();
             for (ord_t j = 0; j < rank2; ++j) {
-              *(G.data() + j) *= *(temp.data() + j);
+              *(G.data() + j) *= *(gram_ptr + j);
             }
           }
         }
@@ -562,10 +571,17 @@ namespace btas{
           detail::set_MtKRPL(converge_test, contract_tensor);
         else if(n == this->ndim - 1)
           detail::set_MtKRPR(converge_test, contract_tensor);
-        Tensor an(skip_dim, rank);
-        gemm(CblasNoTrans, CblasNoTrans, 1.0, contract_tensor, pseudoInverse(G, fast_pI), 0.0, an);
-        this->normCol(an);
-        A[n] = an;
+        if (matlab) {
+          spd_solve(G, contract_tensor, this->solve_counter);
+        } else {
+          Tensor an(skip_dim, rank);
+          gemm(CblasNoTrans, CblasNoTrans, 1.0, contract_tensor, pseudoInverse(G, fast_pI), 0.0, an);
+          ++(fast_pI ? this->solve_counter.fast_pinv : this->solve_counter.svd);
+          contract_tensor = an;
+        }
+        this->normCol(contract_tensor);
+        A[n] = contract_tensor;
+        this->update_gram(n);
       }
     }
 
@@ -7,11 +7,20 @@
 #define BTAS_GENERIC_CP_H
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include <btas/generic/default_random_seed.h>
+#include <btas/generic/counter_rng.h>
 #include <btas/generic/core_contract.h>
 #include <btas/generic/flatten.h>
 #include <btas/generic/khatri_rao_product.h>
@@ -21,7 +30,9 @@
 #include <btas/generic/converge_class.h>
 #include <btas/generic/rals_helper.h>
 #include <btas/generic/reconstruct.h>
+#include <btas/generic/cp_format.h>
 #include <btas/generic/linear_algebra.h>
+#include <btas/generic/cp_observer.h>
 
 namespace btas{
   namespace detail{
@@ -30,7 +41,7 @@ namespace btas{
     // times the factor matrices (excluding one factor)
     // if the converge_class isn't a FitCheck do nothing
     template<typename T, typename Tensor>
-    void set_MtKRP(T& t, Tensor & tensor){
+    void set_MtKRP(T& /*t*/, Tensor & /*tensor*/){
       return;
     }
 
@@ -53,7 +64,7 @@ namespace btas{
     // \hat{X} is the CP approximation (epsilon), if
     // converge_class object isn't FitCheck do nothing
     template<typename T>
-    void get_fit(T& t, double & epsilon){
+    void get_fit(T& /*t*/, double & epsilon){
       //epsilon = epsilon;
       epsilon = -1;
       return;
@@ -70,6 +81,136 @@ namespace btas{
       epsilon = t.get_fit();
       return;
     }
+
+    // Functions that overwrite the fit stored in the converge_class,
+    // if converge_class object isn't FitCheck do nothing
+    template<typename T>
+    void set_fit(T& /*t*/, double /*fit*/){
+      return;
+    }
+
+    template<typename Tensor>
+    void set_fit(FitCheck<Tensor> & t, double fit){
+      t.set_fit(fit);
+    }
+
+    // Functions that get/restore the fit of the latest sweep for checkpointing,
+    // if converge_class object isn't FitCheck do nothing
+    template<typename T>
+    double last_fit(T& /*t*/){
+      return -1.0;
+    }
+
+    template<typename Tensor>
+    double last_fit(FitCheck<Tensor> & t){
+      return t.get_last_fit();
+    }
+
+    template<typename T>
+    void set_last_fit(T& /*t*/, double /*fit*/){
+      return;
+    }
+
+    template<typename Tensor>
+    void set_last_fit(FitCheck<Tensor> & t, double fit){
+      t.set_last_fit(fit);
+    }
+
+    // Computes C = op(T) B where T is the row-major storage of a tensor read
+    // as a rows x cols matrix and B is read as a K x (B.size() / K) matrix.
+    // Neither tensor is reshaped, so a const reference tensor can be shared
+    // between solvers. C must already hold op(T).rows x B.cols elements.
+    template<typename Tensor>
+    void gemm_matricized(CBLAS_TRANSPOSE transT, const Tensor & T, unsigned long rows, unsigned long cols,
+                         const Tensor & B, Tensor & C){
+      unsigned long M = (transT == CblasNoTrans) ? rows : cols;
+      unsigned long K = (transT == CblasNoTrans) ? cols : rows;
+      unsigned long N = B.size() / K;
+      gemm(CblasRowMajor, transT, CblasNoTrans, M, N, K, 1.0, T.data(), cols,
+           B.data(), N, 0.0, C.data(), N);
+    }
+
+    // Conjugates the elements of T in place. The MTTKRP of a complex tensor
+    // contracts with the conjugate factors, nothing is done for real tensors.
+    template<typename Tensor>
+    void conjugate(Tensor & /*T*/, std::false_type){ }
+
+    template<typename Tensor>
+    void conjugate(Tensor & T, std::true_type){
+      for (auto & t : T) t = std::conj(t);
+    }
+
+    template<typename Tensor>
+    void conjugate(Tensor & T){
+      conjugate(T, impl::is_complex<typename Tensor::value_type>());
+    }
+
+    // Returns the factor A the MTTKRP contracts with: A itself for real
+    // tensors, otherwise its conjugate, which is written to buffer. A is not modified.
+    template<typename Tensor>
+    const Tensor & conjugate_factor(const Tensor & A, Tensor & buffer){
+      if (!impl::is_complex<typename Tensor::value_type>::value) return A;
+      buffer = A;
+      conjugate(buffer);
+      return buffer;
+    }
+
+    // Computes the MTTKRP of mode n, T_(n) conj(KRP), on the row-major storage
+    // of T read as T(L, I_n, R), where L (R) are the modes left (right) of n.
+    // The larger of the two sides is contracted with the conjugate Khatri-Rao
+    // product of its factors in one GEMM, the other side is then summed with
+    // its Khatri-Rao product as weights. T is neither permuted nor copied and
+    // the GEMM result holds I_n R min(L, R) elements. The columns of both
+    // Khatri-Rao products run with the last mode fastest, as the storage of T.
+    template<typename Tensor>
+    Tensor mttkrp_matricized(const Tensor & T, const std::vector<Tensor> & A, size_t n){
+      using value_type = typename Tensor::value_type;
+      size_t ndim = T.rank();
+      unsigned long rank = A[0].extent(1), dim = T.extent(n);
+      auto krp = [&](size_t first, size_t last) {
+        Tensor K(1, rank), temp;
+        K.fill(value_type(1.0));
+        for (size_t k = first; k < last; ++k) {
+          khatri_rao_product(K, A[k], temp);
+          K = temp;
+        }
+        conjugate(K);
+        return K;
+      };
+      Tensor left = krp(0, n), right = krp(n + 1, ndim);
+      unsigned long L = left.extent(0), R = right.extent(0);
+
+      Tensor M(dim, rank);
+      M.fill(value_type(0.0));
+      if (R >= L) {
+        // Y(l, i, r) = sum_a T(l, i, a) right(a, r), M(i, r) = sum_l left(l, r) Y(l, i, r)
+        Tensor Y(L * dim, rank);
+        gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, L * dim, rank, R, 1.0, T.data(), R, right.data(), rank,
+             0.0, Y.data(), rank);
+        for (unsigned long l = 0; l < L; ++l) {
+          const auto *w_ptr = left.data() + l * rank;
+          for (unsigned long i = 0; i < dim; ++i) {
+            const auto *y_ptr = Y.data() + (l * dim + i) * rank;
+            auto *m_ptr = M.data() + i * rank;
+            for (unsigned long r = 0; r < rank; ++r) *(m_ptr + r) += *(w_ptr + r) * *(y_ptr + r);
+          }
+        }
+      } else {
+        // Y(i, a, r) = sum_l T(l, i, a) left(l, r), M(i, r) = sum_a right(a, r) Y(i, a, r)
+        Tensor Y(dim * R, rank);
+        gemm(CblasRowMajor, CblasTrans, CblasNoTrans, dim * R, rank, L, 1.0, T.data(), dim * R, left.data(), rank,
+             0.0, Y.data(), rank);
+        for (unsigned long i = 0; i < dim; ++i) {
+          auto *m_ptr = M.data() + i * rank;
+          for (unsigned long a = 0; a < R; ++a) {
+            const auto *w_ptr = right.data() + a * rank;
+            const auto *y_ptr = Y.data() + (i * R + a) * rank;
+            for (unsigned long r = 0; r < rank; ++r) *(m_ptr + r) += *(w_ptr + r) * *(y_ptr + r);
+          }
+        }
+      }
+      return M;
+    }
   }//namespace detail
 
   /** \brief Base class to compute the Canonical Product (CP) decomposition of an order-N
@@ -340,6 +481,164 @@ namespace btas{
       else BTAS_EXCEPTION("Attempting to return a NULL object. Compute CP decomposition first.");
     }
 
+    /// Seeds the decomposition with existing factor matrices, e.g. from an
+    /// earlier run. A following compute_rank() or compute_rank_random() at
+    /// the same rank continues the ALS from these factors, at a larger rank
+    /// the new columns are filled with random numbers.
+    /// \param[in] factors \c ndim factor matrices, optionally followed by the
+    /// weights lambda (set to one if omitted).
+    /// \throws Exception if the number of factors or their column dimensions
+    /// are inconsistent.
+    void set_factor_matrices(const std::vector<Tensor> &factors) {
+      if (factors.size() != ndim && factors.size() != ndim + 1)
+        BTAS_EXCEPTION("Provide one factor matrix per mode, optionally followed by lambda");
+      ind_t rank = factors[0].extent(1);
+      for (size_t i = 0; i < ndim; ++i) {
+        if (factors[i].rank() != 2 || factors[i].extent(1) != rank)
+          BTAS_EXCEPTION("Factor matrices must be matrices with the same column dimension");
+      }
+      if (factors.size() == ndim + 1 && factors[ndim].size() != (ord_t) rank)
+        BTAS_EXCEPTION("lambda must have one weight per column of the factor matrices");
+      A = factors;
+      if (factors.size() == ndim) {
+        Tensor lambda(rank);
+        lambda.fill(1.0);
+        A.push_back(lambda);
+      }
+      AtA.clear();
+      factors_set = true;
+    }
+
+    /// Writes the factor matrices every \c interval ALS sweeps to \c file,
+    /// along with the number of sweeps and the history of the fit, see
+    /// write_checkpoint(). \c interval = 0 turns checkpointing off.
+    /// Checkpoints are written by CP_ALS, CP_RALS and CP_DF_ALS.
+    /// \throws Exception if \c interval > 0 and the solver does not write checkpoints.
+    void set_checkpoint(const std::string &file, size_t interval) {
+      if (interval > 0 && !supports_checkpoints()) BTAS_EXCEPTION("This CP solver does not write checkpoints");
+      checkpoint_file = file;
+      checkpoint_interval = interval;
+    }
+
+    /// Writes the current state of the decomposition to the binary file \c file.
+    /// The file is written under a temporary name and then renamed, so an
+    /// interrupted write leaves the previous checkpoint intact.
+    /// \param[in] file Path of the checkpoint.
+    /// \param[in] sweeps Sweeps of the current ALS, resume() continues from here.
+    /// \throws Exception if there are no factors or the file cannot be written.
+    void write_checkpoint(const std::string &file, size_t sweeps = 0) const {
+      if (A.empty()) BTAS_EXCEPTION("Nothing to checkpoint, compute the CP decomposition first");
+      std::string tmp = file + ".tmp";
+      {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) BTAS_EXCEPTION("Unable to open the checkpoint file");
+        auto put = [&](uint64_t v) { out.write(reinterpret_cast<const char *>(&v), sizeof(v)); };
+        out.write(checkpoint_magic, sizeof(checkpoint_magic));
+        put(sizeof(typename Tensor::value_type));
+        put(ndim);
+        put(num_ALS);
+        put(sweeps);
+        put(fit_history.size());
+        out.write(reinterpret_cast<const char *>(fit_history.data()), fit_history.size() * sizeof(double));
+        put(A.size());
+        for (auto &a : A) {
+          put(a.rank());
+          for (size_t i = 0; i < a.rank(); ++i) put(a.extent(i));
+          out.write(reinterpret_cast<const char *>(a.data()), a.size() * sizeof(typename Tensor::value_type));
+        }
+        if (!out) BTAS_EXCEPTION("Writing the checkpoint file failed");
+      }
+      if (std::rename(tmp.c_str(), file.c_str()) != 0) BTAS_EXCEPTION("Unable to replace the checkpoint file");
+    }
+
+    /// Restores a decomposition written by write_checkpoint(). The next
+    /// compute_rank() or compute_rank_random() at the checkpointed rank
+    /// continues the ALS from the saved factors, sweep count and fit, so the
+    /// \c max_als budget and the convergence test carry over. The state of the
+    /// RALS regularization is not saved and restarts from its initial value.
+    /// \param[in] file Path of the checkpoint.
+    /// \throws Exception if the solver does not resume from checkpoints, or the
+    /// file cannot be read or does not match this decomposition.
+    void resume(const std::string &file) {
+      if (!supports_checkpoints()) BTAS_EXCEPTION("This CP solver does not resume from checkpoints");
+      std::ifstream in(file, std::ios::binary);
+      if (!in) BTAS_EXCEPTION("Unable to open the checkpoint file");
+      auto get = [&]() {
+        uint64_t v = 0;
+        in.read(reinterpret_cast<char *>(&v), sizeof(v));
+        return v;
+      };
+      char magic[sizeof(checkpoint_magic)];
+      in.read(magic, sizeof(magic));
+      if (!in || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0)
+        BTAS_EXCEPTION("Not a CP checkpoint file");
+      if (get() != sizeof(typename Tensor::value_type)) BTAS_EXCEPTION("Checkpoint was written for another value type");
+      if (get() != ndim) BTAS_EXCEPTION("Checkpoint was written for a tensor of different order");
+      size_t als = get(), sweeps = get();
+      std::vector<double> history(get());
+      in.read(reinterpret_cast<char *>(history.data()), history.size() * sizeof(double));
+      std::vector<Tensor> factors(get());
+      for (auto &a : factors) {
+        std::vector<ind_t> extents(get());
+        for (auto &e : extents) e = get();
+        a = Tensor(typename Tensor::range_type(extents));
+        in.read(reinterpret_cast<char *>(a.data()), a.size() * sizeof(typename Tensor::value_type));
+      }
+      if (!in) BTAS_EXCEPTION("Checkpoint file is truncated");
+
+      set_factor_matrices(factors);
+      num_ALS = als;
+      fit_history = history;
+      resume_sweeps = sweeps;
+      resume_rank = A[0].extent(1);
+    }
+
+    /// \returns the fit after every ALS sweep recorded while checkpointing
+    /// (-1 where the convergence test does not compute the fit).
+    const std::vector<double> & get_fit_history() const { return fit_history; }
+
+    /// returns the number of ALS sweeps performed since construction
+    size_t get_num_ALS() const { return num_ALS; }
+
+    /// returns how many times each linear solver path was used to solve
+    /// the ALS normal equations since construction (or the last reset)
+    /// \return The counts of Cholesky, LDL^T, eigenvalue, SVD and fast pseudo-inverse based solves.
+    const SPDSolveCounter & get_solve_counter() const { return solve_counter; }
+
+    /// resets the linear solver path counts to zero
+    void reset_solve_counter() { solve_counter.reset(); }
+
+    /// Attaches an observer which is notified after every factor matrix
+    /// update and every ALS sweep with the time spent in each CPPhase, FLOP
+    /// estimates, the fit and the linear solver used. Phases are only timed
+    /// while an observer is attached. CP_GN updates every factor in one
+    /// Gauss-Newton step, it reports each step as a sweep and no factor
+    /// matrix updates.
+    /// \param[in] observer Not owned, must outlive the decompositions it
+    /// observes. \c nullptr detaches the current observer.
+    void set_observer(CPObserver *observer) { this->observer = observer; }
+
+    /// \returns the attached observer, \c nullptr if there is none
+    CPObserver *get_observer() const { return observer; }
+
+    /// For single precision tensors: the MTTKRP and the factor matrices stay
+    /// in the precision of the tensor while the Gram matrices are accumulated
+    /// and the \f$ R \times R \f$ normal equations assembled and solved in
+    /// double precision. Has no effect
+    /// on double precision tensors. Default = false.
+    void set_mixed_precision(bool mixed) { mixed_precision = mixed; }
+
+    /// Draws the random initial guesses from the counter based generator of
+    /// CounterRNG with \c nthreads threads, seeded by random_seed_accessor()
+    /// with one stream per mode. The guess does not depend on \c nthreads.
+    /// 0 = the serial \c std::mt19937 guesses (default). The sketches of
+    /// compress_compute_rand() are drawn with the same number of threads.
+    void set_parallel_random(size_t nthreads) { random_threads = nthreads; }
+
+    /// Selects the random matrix of the randomized compression of
+    /// compress_compute_rand(). Default = Sketch::gaussian.
+    void set_randomized_sketch(Sketch sketch) { this->sketch = sketch; }
+
     /// Default function, uses the factor matrices from the CP
     /// decomposition and reconstructs the
     /// approximated tensor.
@@ -386,8 +685,144 @@ namespace btas{
   protected:
     size_t num_ALS;                      // Number of ALS iterations
     std::vector<Tensor> A;            // Factor matrices
+    std::vector<Tensor> AtA;          // Cached Gram matrices A[i]^T A[i] of the factor matrices
     size_t ndim;                         // Modes in the reference tensor
     std::vector<size_t> symmetries;      // Symmetries of the reference tensor
+    SPDSolveCounter solve_counter;       // Which linear solver paths were taken in pseudoinverse_helper
+    bool factors_set = false;            // Factors were seeded by set_factor_matrices or resume
+    std::string checkpoint_file;         // Where checkpoints are written
+    size_t checkpoint_interval = 0;      // Sweeps between checkpoints, 0 = off
+    std::vector<double> fit_history;     // Fit after every sweep while checkpointing
+    size_t resume_sweeps = 0;            // Sweeps already done by the resumed ALS
+    ind_t resume_rank = 0;               // Rank of the resumed ALS
+    static constexpr char checkpoint_magic[8] = {'B', 'T', 'A', 'S', 'C', 'P', '0', '1'};
+    bool mixed_precision = false;        // Solve the normal equations in double precision
+    size_t random_threads = 0;           // Threads of the counter based random guess, 0 = std::mt19937
+    Sketch sketch = Sketch::gaussian;    // Random matrix of the randomized compression
+    CPObserver *observer = nullptr;      // Notified of the statistics of every update and sweep, not owned
+    CPPhaseStats mode_stats;             // Phases of the factor matrix update in progress
+    CPSweepRecord sweep_record;          // Statistics of the sweep in progress
+    const char *solver_path = "";        // Linear solver used by the last pseudoinverse_helper
+
+    using observer_clock = std::chrono::steady_clock;
+
+    /// \returns the current time if an observer is attached, otherwise the clock is not read
+    observer_clock::time_point phase_start() const {
+      return observer ? observer_clock::now() : observer_clock::time_point();
+    }
+
+    /// Adds the time since \c start and \c flops to \c phase of the update in progress
+    void phase_stop(CPPhase phase, observer_clock::time_point start, double flops) {
+      if (!observer) return;
+      auto p = static_cast<size_t>(phase);
+      mode_stats.seconds[p] += std::chrono::duration<double>(observer_clock::now() - start).count();
+      mode_stats.flops[p] += flops;
+    }
+
+    /// Solvers call this at the start of sweep \c count of the ALS of rank \c rank.
+    /// \returns The start time of the sweep
+    observer_clock::time_point observe_sweep_begin(size_t count, ind_t rank) {
+      if (!observer) return observer_clock::time_point();
+      sweep_record = CPSweepRecord();
+      sweep_record.sweep = count;
+      sweep_record.rank = rank;
+      // store the counts at the start of the sweep, the difference is reported
+      sweep_record.solves = solve_counter;
+      return observer_clock::now();
+    }
+
+    /// Solvers call this before updating a factor matrix.
+    /// \returns The start time of the update
+    observer_clock::time_point observe_mode_begin() {
+      if (!observer) return observer_clock::time_point();
+      mode_stats = CPPhaseStats();
+      solver_path = "";
+      return observer_clock::now();
+    }
+
+    /// Solvers call this after updating factor matrix \c n. The time not spent
+    /// in the timed helpers (Gram, solve, normalization) is the MTTKRP.
+    /// \param[in] n The updated factor matrix
+    /// \param[in] start The return value of observe_mode_begin
+    /// \param[in] mttkrp_flops Estimated FLOPs of the MTTKRP of this update
+    void observe_mode_end(size_t n, observer_clock::time_point start, double mttkrp_flops) {
+      if (!observer) return;
+      double elapsed = std::chrono::duration<double>(observer_clock::now() - start).count();
+      auto p = static_cast<size_t>(CPPhase::mttkrp);
+      mode_stats.seconds[p] = std::max(0.0, elapsed - mode_stats.total_seconds());
+      mode_stats.flops[p] = mttkrp_flops;
+      CPModeRecord record;
+      record.sweep = sweep_record.sweep;
+      record.mode = n;
+      record.rank = sweep_record.rank;
+      record.stats = mode_stats;
+      record.solver = solver_path;
+      sweep_record.stats += mode_stats;
+      observer->mode_updated(record);
+    }
+
+    /// Solvers call this after the convergence test of a sweep
+    /// \param[in] start The return value of observe_sweep_begin
+    /// \param[in] converge_start The time the convergence test started
+    /// \param[in] converge_test The convergence test of the sweep, provides the fit
+    void observe_sweep_end(observer_clock::time_point start, observer_clock::time_point converge_start,
+                           ConvClass &converge_test) {
+      if (!observer) return;
+      auto now = observer_clock::now();
+      auto p = static_cast<size_t>(CPPhase::converge);
+      ind_t rank = sweep_record.rank;
+      sweep_record.stats.seconds[p] = std::chrono::duration<double>(now - converge_start).count();
+      // fit from the cached Gram matrices and the last MTTKRP
+      sweep_record.stats.flops[p] = ndim * (double) rank * rank + 2.0 * A[ndim - 1].size();
+      sweep_record.wall_seconds = std::chrono::duration<double>(now - start).count();
+      sweep_record.fit = sweep_fit(converge_test);
+      auto &s = sweep_record.solves;
+      s.cholesky = solve_counter.cholesky - s.cholesky;
+      s.ldlt = solve_counter.ldlt - s.ldlt;
+      s.eigen = solve_counter.eigen - s.eigen;
+      s.svd = solve_counter.svd - s.svd;
+      s.fast_pinv = solve_counter.fast_pinv - s.fast_pinv;
+      observer->sweep_finished(sweep_record);
+    }
+
+    /// \returns Estimated FLOPs of a dense MTTKRP, \f$ 2 R \prod_n I_n \f$
+    double dense_mttkrp_flops(ind_t rank) const {
+      double flops = 2.0 * rank;
+      for (size_t i = 0; i < ndim; ++i) flops *= A[i].extent(0);
+      return flops;
+    }
+
+    /// \returns the fit after the latest convergence test, -1 if \c converge_test does not compute it
+    double sweep_fit(ConvClass &converge_test) {
+      // a converged FitCheck only holds the final fit
+      double fit = detail::last_fit(converge_test);
+      if (fit < 0) detail::get_fit(converge_test, fit);
+      return fit;
+    }
+
+    /// Solvers call this at the start of the ALS of rank \c rank, which
+    /// consumes the factors seeded by set_factor_matrices() or resume().
+    /// \returns The number of sweeps already performed, non-zero only for the
+    /// first ALS after resume(), whose fit is restored in \c converge_test.
+    size_t resumed_sweeps(ind_t rank, ConvClass &converge_test) {
+      factors_set = false;
+      size_t count = (rank == resume_rank) ? resume_sweeps : 0;
+      if (count > 0 && !fit_history.empty()) detail::set_last_fit(converge_test, fit_history.back());
+      resume_sweeps = 0;
+      resume_rank = 0;
+      return count;
+    }
+
+    /// \returns true if the solver calls resumed_sweeps() and checkpoint_sweep()
+    virtual bool supports_checkpoints() const { return false; }
+
+    /// Solvers call this after sweep \c count of the ALS, records the fit and
+    /// writes a checkpoint every \c checkpoint_interval sweeps.
+    void checkpoint_sweep(size_t count, ConvClass &converge_test) {
+      if (checkpoint_interval == 0) return;
+      fit_history.push_back(sweep_fit(converge_test));
+      if (count % checkpoint_interval == 0) write_checkpoint(checkpoint_file, count);
+    }
 
     /// Virtual function. Solver classes should implement a build function to
     /// generate factor matrices then compute the CP decomposition
@@ -436,23 +871,78 @@ namespace btas{
                               bool calculate_epsilon, double &epsilon,
                               bool &fast_pI) = 0;
 
-    /// Generates V by first Multiply A^T.A then Hadamard product V(i,j) *=
-    /// A^T.A(i,j);
+    /// Computes the Gram matrix A[n]^T A[n] of factor matrix \c n and stores it
+    /// in the cache \c AtA. Must be called every time \c A[n] changes.
+    /// \param[in] n The factor matrix whose Gram matrix is refreshed
+    void update_gram(size_t n) {
+      auto start = phase_start();
+      ind_t rank = A[n].extent(1);
+      if (AtA[n].range().area() != rank * (ord_t) rank)
+        AtA[n] = Tensor(rank, rank);
+      gemm(impl::adjoint_trans<typename Tensor::value_type>(), CblasNoTrans, 1.0, A[n], A[n], 0.0, AtA[n]);
+      phase_stop(CPPhase::gram, start, 2.0 * A[n].size() * rank);
+    }
+
+    /// Rebuilds the Gram matrix cache \c AtA for every factor matrix.
+    /// Should be called once the factor matrices are (re)initialized, i.e.
+    /// before the first sweep of an ALS optimization.
+    void init_gram() {
+      AtA.resize(ndim);
+      for (size_t i = 0; i < ndim; ++i) {
+        update_gram(i);
+      }
+    }
+
+    /// Generates V by taking the Hadamard product of the cached Gram matrices
+    /// V(i,j) *= conj(A^H.A(i,j)) for every mode except \c n
+    /// \param[in] n The mode being optimized, all other modes held constant
+    /// \param[in] rank The current rank, column dimension of the factor matrices
+    /// \param[in] lambda regularization parameter, lambda is added to the diagonal of V
+    /// \tparam Matrix The type of V, the products are accumulated in its precision
+    template <typename Matrix = Tensor>
+    Matrix generate_V(size_t n, ind_t rank, double lambda = 0.0) {
+      const ord_t rank2 = rank * (ord_t) rank;
+      Matrix V(rank, rank);
+      V.fill(1.0);
+      auto *V_ptr = V.data();
+      for (size_t i = 0; i < ndim; ++i) {
+        if (i != n) {
+          const auto *lhs_ptr = AtA[i].data();
+          for (ord_t j = 0; j < rank2; j++)
+            *(V_ptr + j) *= typename Matrix::value_type(impl::conj(*(lhs_ptr + j)));
+        }
+      }
+
+      ord_t j_times_rank = 0;
+      for (ind_t j = 0; j < rank; ++j, j_times_rank+=rank) {
+        *(V_ptr + j_times_rank + j) += lambda;
+      }
+
+      return V;
+    }
+
+    /// Generates V as generate_V, but the Gram matrices are recomputed from
+    /// the factor matrices in the precision of \c Matrix rather than taken
+    /// from the cache, which holds them in the precision of the tensor.
     /// \param[in] n The mode being optimized, all other modes held constant
     /// \param[in] rank The current rank, column dimension of the factor matrices
     /// \param[in] lambda regularization parameter, lambda is added to the diagonal of V
-    Tensor generate_V(size_t n, ind_t rank, double lambda = 0.0) {
+    /// \tparam Matrix The type of V and of the promoted factor matrices
+    template <typename Matrix>
+    Matrix generate_V_promoted(size_t n, ind_t rank, double lambda = 0.0) {
+      using value_type = typename Matrix::value_type;
       const ord_t rank2 = rank * (ord_t) rank;
-      Tensor V(rank, rank);
+      Matrix V(rank, rank), factor, gram(rank, rank);
       V.fill(1.0);
       auto *V_ptr = V.data();
-      Tensor lhs_prod(rank, rank);
       for (size_t i = 0; i < ndim; ++i) {
         if (i != n) {
-          gemm(CblasTrans, CblasNoTrans, 1.0, A[i], A[i], 0.0, lhs_prod);
-          const auto *lhs_ptr = lhs_prod.data();
+          factor = Matrix(A[i].range());
+          std::copy(A[i].begin(), A[i].end(), factor.begin());
+          gemm(impl::adjoint_trans<value_type>(), CblasNoTrans, 1.0, factor, factor, 0.0, gram);
+          const auto *lhs_ptr = gram.data();
           for (ord_t j = 0; j < rank2; j++)
-            *(V_ptr + j) *= *(lhs_ptr + j);
+            *(V_ptr + j) *= impl::conj(*(lhs_ptr + j));
         }
       }
 
@@ -506,6 +996,7 @@ namespace btas{
 
     Tensor normCol(size_t factor) {
       if (factor >= ndim) BTAS_EXCEPTION("Factor is out of range");
+      auto start = phase_start();
       ind_t rank = A[factor].extent(1);
       ord_t size = A[factor].size();
       Tensor lambda(rank);
@@ -513,7 +1004,7 @@ namespace btas{
       auto A_ptr = A[factor].data();
       auto lam_ptr = lambda.data();
       for (ord_t i = 0; i < size; ++i) {
-        *(lam_ptr + i % rank) += *(A_ptr + i) * *(A_ptr + i);
+        *(lam_ptr + i % rank) += std::norm(*(A_ptr + i));
       }
       for (ind_t col = 0; col < rank; ++col) {
         *(lam_ptr + col) = sqrt(*(lam_ptr + col));
@@ -521,6 +1012,7 @@ namespace btas{
       for (ord_t i = 0; i < size; ++i) {
         *(A_ptr + i) /= *(lam_ptr + i % rank);
       }
+      phase_stop(CPPhase::normalize, start, 3.0 * size);
       return lambda;
     }
 
@@ -532,30 +1024,48 @@ namespace btas{
 
     void normCol(Tensor &Mat) {
       if (Mat.rank() > 2) BTAS_EXCEPTION("normCol with rank > 2 not yet supported");
+      auto start = phase_start();
       ind_t rank = Mat.extent(1);
       ord_t size = Mat.size();
       A[ndim].fill(0.0);
       auto Mat_ptr = Mat.data();
       auto A_ptr = A[ndim].data();
       for (ord_t i = 0; i < size; ++i) {
-        *(A_ptr + i % rank) += *(Mat_ptr + i) * *(Mat_ptr + i);
+        *(A_ptr + i % rank) += std::norm(*(Mat_ptr + i));
       }
       for (ind_t i = 0; i < rank; ++i) {
         *(A_ptr + i) = sqrt(*(A_ptr + i));
       }
       for (ord_t i = 0; i < size; ++i) {
-        if (*(A_ptr + i % rank) > 1e-12)
+        if (std::abs(*(A_ptr + i % rank)) > 1e-12)
           *(Mat_ptr + i) /= *(A_ptr + i % rank);
         else
           *(Mat_ptr + i) = 0;
 
       }
+      phase_stop(CPPhase::normalize, start, 3.0 * size);
+    }
+
+    /// Fills the random initial guess of the factor matrix of mode \c mode,
+    /// uniform in [-1, 1).
+    /// \param[in,out] a The factor matrix
+    /// \param[in] mode Stream of the counter based generator
+    /// \param[in,out] generator Serial generator used when set_parallel_random() is off
+    void fill_random(Tensor &a, size_t mode, std::mt19937 &generator) {
+      if (random_threads > 0) {
+        fill_random_uniform(a, -1.0, 1.0, random_seed_accessor(), mode, random_threads);
+        return;
+      }
+      std::uniform_real_distribution<> distribution(-1.0, 1.0);
+      for (auto iter = a.begin(); iter != a.end(); ++iter) {
+        *(iter) = distribution(generator);
+      }
     }
 
     /// \param[in] Mat Calculates the 2-norm of the matrix mat
     /// \return the 2-norm.
 
-    double norm(const Tensor &Mat) { return sqrt(dot(Mat, Mat)); }
+    double norm(const Tensor &Mat) { return sqrt(std::abs(dot(Mat, Mat))); }
 
     /// SVD referencing code from
     /// http://www.netlib.org/lapack/explore-html/de/ddd/lapacke_8h_af31b3cb47f7cc3b9f6541303a2968c9f.html
@@ -563,17 +1073,17 @@ namespace btas{
     /// https://arxiv.org/pdf/0804.4809.pdf
 
     /// Trying to solve Ax = B
-    /// First try Cholesky to solve this problem directly
-    /// second tryfast pseudo-inverse algorithm described in
-    /// https://arxiv.org/pdf/0804.4809.pdf
-    /// If all else fails use SVD
+    /// If \c cholesky, solve the symmetric positive semi-definite system with
+    /// spd_solve: Cholesky first, then LDL^T, then an eigenvalue based pseudo-inverse.
+    /// Otherwise use the fast pseudo-inverse algorithm described in
+    /// https://arxiv.org/pdf/0804.4809.pdf or SVD
 
     /// \param[in] mode_of_A The mode being optimized used to compute hadamard LHS (V) of ALS problem (Vx = B)
+    ///                      from the cached Gram matrices of the other modes
     /// \param[in,out] fast_pI If true, try to compute the pseudo inverse via fast LU decomposition, else use SVD;
     ///                on return reports whether the fast route was used.
-    /// \param[in, out] cholesky If true, try to solve the linear equation Vx = B (the ALS problem)
-    ///                using a Cholesky decomposition (lapacke subroutine) on return reports if
-    ///                inversion was successful.
+    /// \param[in, out] cholesky If true, solve the linear equation Vx = B (the ALS problem)
+    ///                with the symmetric solver chain of spd_solve (lapacke subroutines).
     /// \param[in, out] B In: The RHS of the ALS problem ( Vx = B ). Out: The solved linear equation
     ///                     \f$ V^{-1} B \f$
     /// \param[in] lambda Regularization parameter lambda is added to the diagonal of V
@@ -584,19 +1094,67 @@ namespace btas{
         BTAS_EXCEPTION("pseudoinverse helper solves Ax = B.  B cannot be an empty tensor");
       }
 
+      auto start = phase_start();
       ind_t rank = A[0].extent(1);
-      auto a = this->generate_V(mode_of_A, rank, lambda);
+      // Hadamard products of the Gram matrices and applying the inverse
+      double flops = (ndim - 1) * (double) rank * rank + 2.0 * B.size() * rank;
+
+      using value_type = typename Tensor::value_type;
+      using dvalue_type = typename std::conditional<impl::is_complex<value_type>::value,
+                                                    std::complex<double>, double>::type;
+      if (mixed_precision && !std::is_same<value_type, dvalue_type>::value) {
+        // The Gram matrices, the R x R system and the right-hand side are
+        // promoted, the MTTKRP which produced B stays in the precision of the tensor
+        using DMatrix = btas::Tensor<dvalue_type>;
+        auto a = this->template generate_V_promoted<DMatrix>(mode_of_A, rank, lambda);
+        for (size_t i = 0; i < ndim; ++i)
+          if (i != mode_of_A) flops += 2.0 * A[i].size() * rank;
+        DMatrix b(B.extent(0), rank);
+        std::copy(B.begin(), B.end(), b.begin());
+        flops += solve_normal_equations(a, b, fast_pI, cholesky);
+        std::copy(b.begin(), b.end(), B.begin());
+      } else {
+        auto a = this->generate_V(mode_of_A, rank, lambda);
+        flops += solve_normal_equations(a, B, fast_pI, cholesky);
+      }
+      phase_stop(CPPhase::solve, start, flops);
+    }
 
+    /// Solves \f$ X V = B \f$ for the symmetric \c V, the work of pseudoinverse_helper
+    /// \param[in, out] V The Hadamard product of the Gram matrices, overwritten
+    /// \param[in, out] B In: The right-hand side. Out: The solution.
+    /// \param[in,out] fast_pI See pseudoinverse_helper
+    /// \param[in] cholesky Solve with spd_solve rather than a pseudo-inverse
+    /// \return The estimated FLOPs of the factorization
+    template <typename Matrix>
+    double solve_normal_equations(Matrix &V, Matrix &B, bool &fast_pI, bool cholesky) {
+      auto rank = V.extent(0);
+      const double rank3 = (double) rank * rank * rank;
       if (cholesky) {
-        cholesky = cholesky_inverse(a, B);
-        return;
+        SPDSolveCounter before = solve_counter;
+        spd_solve(V, B, solve_counter);
+        if (solve_counter.cholesky != before.cholesky) {
+          solver_path = "cholesky";
+          return rank3 / 3;
+        } else if (solve_counter.ldlt != before.ldlt) {
+          solver_path = "ldlt";
+          return rank3 / 3;
+        }
+        solver_path = "eigen";
+        return 9 * rank3;
       }
-      auto pInv = pseudoInverse(a, fast_pI);
-      Tensor an(B.extent(0), rank);
+      auto pInv = pseudoInverse(V, fast_pI);
+      ++(fast_pI ? solve_counter.fast_pinv : solve_counter.svd);
+      solver_path = fast_pI ? "fast_pinv" : "svd";
+      Matrix an(B.extent(0), rank);
       gemm(CblasNoTrans, CblasNoTrans, 1.0, B, pInv, 0.0, an);
       B = an;
+      return fast_pI ? 6 * rank3 : 24 * rank3;
     }
   };
+
+  template <typename Tensor, class ConvClass>
+  constexpr char CP<Tensor, ConvClass>::checkpoint_magic[8];
 };// namespace btas
 
 #endif //BTAS_GENERIC_CP_H
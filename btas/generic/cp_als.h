@@ -8,6 +8,7 @@
 #include <btas/generic/cp.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <vector>
@@ -21,8 +22,9 @@ namespace btas{
     ranks. Also provides Tucker and randomized Tucker-like compressions coupled
     with CP-ALS decomposition. Does not support strided ranges.
 
-   \warning this code takes a non-const reference \c tensor_ref but does
-   not modify the values. This is a result of API (reshape needs non-const tensor)
+   \note \c tensor_ref is held by const reference and is never modified,
+   the compression methods decompose a separate core tensor. Several solvers
+   may therefore share one reference tensor concurrently.
 
     Synopsis:
     \code
@@ -68,6 +70,9 @@ namespace btas{
                                                     // Then computes CP decomposition
                                                     // of core.
 
+    A.set_line_search(k)                            // Extrapolate the factor matrices every
+                                                    // k sweeps of the ALS (default off)
+
    //See documentation for full range of options
 
     // Accessing Factor Matrices
@@ -83,6 +88,7 @@ namespace btas{
           {
   public:
     using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
     using CP<Tensor,ConvClass>::ndim;
     using CP<Tensor,ConvClass>::symmetries;
     using typename CP<Tensor,ConvClass>::ind_t;
@@ -92,7 +98,7 @@ namespace btas{
     /// that stores the reference tensor.
     /// Reference tensor has no symmetries.
     /// \param[in] tensor the reference tensor to be decomposed.
-    CP_ALS(Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
+    CP_ALS(const Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
                             size(tensor.size()){
       for (size_t i = 0; i < ndim; ++i) {
         symmetries.push_back(i);
@@ -108,7 +114,7 @@ namespace btas{
     /// symmetries of {0,1,1,3}
     /// \param[in] tensor the reference tensor to be decomposed.
     /// \param[in] symms the symmetries of the reference tensor.
-    CP_ALS(Tensor &tensor, std::vector<size_t> &symms) : CP<Tensor, ConvClass>(tensor.rank()),
+    CP_ALS(const Tensor &tensor, std::vector<size_t> &symms) : CP<Tensor, ConvClass>(tensor.rank()),
                                                          tensor_ref(tensor), size(tensor.size()){
       symmetries = symms;
       if (symmetries.size() > ndim) BTAS_EXCEPTION("Too many symmetries provided")
@@ -120,6 +126,52 @@ namespace btas{
 
     ~CP_ALS() = default;
 
+    /// Turns on line search acceleration of the ALS. Every \c interval sweeps the
+    /// factor matrices are extrapolated along the direction of the last sweep,
+    /// \f$ A^{new} = A^{old} + s (A^{ALS} - A^{old}) \f$ with \f$ s = it^{1/power} \f$,
+    /// and the extrapolation is kept only if it lowers the loss function.
+    /// Reference: R. Bro, Multi-way Analysis in the Food Industry (1998).
+    /// \param[in] interval Number of sweeps between extrapolations, 0 turns
+    /// the line search off. Default = 0.
+    /// \param[in] power The step size is the iteration count to the power 1 / \c power.
+    /// Default = 3.
+    /// \note The loss is evaluated from the MTTKRP of the last mode, which is not
+    /// computed when the last mode is symmetric to another one, this throws then.
+    void set_line_search(size_t interval, double power = 3.0) {
+      if (power <= 0) BTAS_EXCEPTION("The line search power must be larger than 0");
+      if (interval > 0 && symmetries[ndim - 1] != ndim - 1)
+        BTAS_EXCEPTION("The line search requires a last mode which is not symmetric to another mode");
+      ls_interval = interval;
+      ls_power = power;
+    }
+
+    /// Refines the Tucker factors of compress_compute_tucker() with the higher-order
+    /// orthogonal iteration, see tucker_hooi(). The multilinear rank is the one
+    /// chosen by the truncated HOSVD, the refined core is a more accurate
+    /// compression of the same size.
+    /// \param[in] max_iter Maximum number of HOOI sweeps, 0 turns HOOI off. Default = 0.
+    /// \param[in] nthreads Number of threads of the HOOI mode products. Default = 1.
+    void set_tucker_hooi(size_t max_iter, size_t nthreads = 1) {
+      hooi_iter = max_iter;
+      hooi_threads = nthreads;
+    }
+
+    /// Turns on the packed symmetric MTTKRP of the direct algorithm. The last two modes
+    /// of the reference tensor must be symmetric, \c symmetries[ndim - 1] == ndim - 2,
+    /// as for the pair symmetric integrals \f$ (ij|kl) = (ij|lk) \f$. The reference
+    /// tensor is copied once into a matrix holding only the elements with
+    /// \f$ i_{N-2} \leq i_{N-1} \f$ and the symmetric pair is contracted on this
+    /// matrix, which halves the leading cost of the MTTKRPs. The contraction of the
+    /// pair with its factor matrix is shared by all modes updated before the pair in
+    /// a sweep. Has no effect when the Khatri-Rao product is formed.
+    /// \param[in] packing Use the packed reference tensor. Default = false.
+    void set_symmetric_packing(bool packing) {
+      if (packing && (ndim < 3 || symmetries.size() != ndim || symmetries[ndim - 1] != ndim - 2))
+        BTAS_EXCEPTION("Symmetric packing requires the last two modes to be symmetric");
+      symmetric_packing = packing;
+      packed_ref = Tensor();
+    }
+
     /// \brief Computes decomposition of the order-N tensor \c tensor
     /// with rank = \c RankStep * \c panels *  max_dim(reference_tensor) + max_dim(reference_tensor)
     /// Initial guess for factor matrices start at rank = max_dim(reference_tensor)
@@ -222,7 +274,8 @@ namespace btas{
     /// here</a>. Using this approximation the CP decomposition is
     /// computed to either finite error or finite rank. Default settings
     /// calculate to finite error. Factor matrices from get_factor_matrices() are
-    /// scaled by the Tucker transformations.
+    /// scaled by the Tucker transformations. With set_tucker_hooi() the Tucker
+    /// factors are refined by HOOI before the core is decomposed.
 
     /// \param[in] tcutSVD Truncation threshold for SVD of each mode in Tucker
     /// decomposition.
@@ -248,12 +301,17 @@ namespace btas{
                                    ind_t max_als = 1e4, bool fast_pI = false) {
       // Tensor compression
       std::vector<Tensor> transforms;
-      tucker_compression(tensor_ref, tcutSVD, transforms);
-      size = tensor_ref.size();
-      double epsilon = -1.0;
-
-      // CP decomposition
-      epsilon = this->compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      Tensor core;
+      tucker_compression(tensor_ref, tcutSVD, transforms, core);
+      if (hooi_iter > 0) tucker_hooi(tensor_ref, tcutSVD, transforms, core, hooi_iter, 1e-10, hooi_threads);
+
+      // CP decomposition of the core, the reference tensor is left untouched
+      CP_ALS<Tensor, ConvClass> core_solver(core, symmetries);
+      core_solver.set_line_search(ls_interval, ls_power);
+      auto epsilon = core_solver.compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      A = core_solver.A;
+      this->solve_counter += core_solver.solve_counter;
+      this->num_ALS += core_solver.get_num_ALS();
 
       // scale factor matrices
       for (size_t i = 0; i < ndim; i++) {
@@ -306,10 +364,17 @@ namespace btas{
                           ind_t rank = 0, bool direct = true, bool calculate_epsilon = false,
                           ind_t max_als = 1e5, bool fast_pI = false) {
       std::vector<Tensor> transforms;
-      randomized_decomposition(tensor_ref, transforms, desired_compression_rank, oversampl, powerit);
-      size = tensor_ref.size();
-
-      auto epsilon = this->compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      Tensor core;
+      randomized_decomposition(tensor_ref, core, transforms, desired_compression_rank, oversampl, powerit,
+                               std::max<size_t>(1, this->random_threads), this->sketch);
+
+      // CP decomposition of the core, the reference tensor is left untouched
+      CP_ALS<Tensor, ConvClass> core_solver(core, symmetries);
+      core_solver.set_line_search(ls_interval, ls_power);
+      auto epsilon = core_solver.compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      A = core_solver.A;
+      this->solve_counter += core_solver.solve_counter;
+      this->num_ALS += core_solver.get_num_ALS();
 
       // scale factor matrices
       for (size_t i = 0; i < ndim; i++) {
@@ -323,9 +388,18 @@ namespace btas{
 
 
   protected:
-    Tensor &tensor_ref;         // Tensor to be decomposed
+    bool supports_checkpoints() const override { return true; }
+
+    const Tensor &tensor_ref;   // Tensor to be decomposed
     ord_t size;                   // Total number of elements
-    bool factors_set = false;   // Are the factors preset (not implemented yet).
+    size_t ls_interval = 0;     // Sweeps between line search extrapolations, 0 = off
+    double ls_power = 3.0;      // Extrapolation step is iteration^(1/ls_power)
+    Tensor MtKRP_last;          // MTTKRP of the last mode from the latest sweep, kept for the line search
+    size_t hooi_iter = 0;       // HOOI sweeps refining the Tucker factors, 0 = off
+    size_t hooi_threads = 1;    // Threads of the HOOI mode products
+    bool symmetric_packing = false;   // Contract the symmetric last mode pair on packed_ref
+    Tensor packed_ref;          // tensor_ref with the last mode pair packed, built by the first ALS
+    Tensor pair_contraction;    // packed_ref contracted with the pair's factor, reused within a sweep
 
     /// Creates an initial guess by computing the SVD of each mode
     /// If the rank of the mode is smaller than the CP rank requested
@@ -386,10 +460,10 @@ namespace btas{
           auto tmp = symmetries[i];
           if (tmp != i) continue;
           ind_t R = tensor_ref.extent(i);
-          Tensor S(R, R), lambda(R);
+          Tensor S, lambda(R);
 
           // Contract refrence tensor to make it square matrix of mode i
-          gemm(CblasNoTrans, CblasTrans, 1.0, flatten(tensor_ref, i), flatten(tensor_ref, i), 0.0, S);
+          mode_gram(tensor_ref, i, S);
 
           // Find the Singular vectors of the matrix using eigenvalue decomposition
           eigenvalue_decomp(S, lambda);
@@ -503,7 +577,7 @@ namespace btas{
         // compute the ALS of factor matrices with rank = i + 1.
         ALS(rank_new, converge_test, direct, max_als, calculate_epsilon, epsilon, fast_pI);
       }
-      if(factors_set && ! opt_in_for_loop){
+      if(this->factors_set && ! opt_in_for_loop){
         ALS(rank, converge_test, direct, max_als, calculate_epsilon, epsilon, fast_pI);
       }
     }
@@ -530,8 +604,12 @@ namespace btas{
     void build_random(ind_t rank, ConvClass &converge_test, bool direct, ind_t max_als,
                       bool calculate_epsilon, double &epsilon,
                       bool &fast_pI) override {
+      // Continue from seeded factors rather than a random guess
+      if (this->factors_set) {
+        build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+        return;
+      }
       std::mt19937 generator(random_seed_accessor());
-      std::uniform_real_distribution<> distribution(-1.0, 1.0);
       for (size_t i = 0; i < this->ndim; ++i) {
         // If this mode is symmetric to a previous mode, set it equal to
         // previous mode, else make a random matrix.
@@ -540,9 +618,7 @@ namespace btas{
           A.push_back(A[tmp]);
         } else {
           Tensor a(tensor_ref.extent(i), rank);
-          for (auto iter = a.begin(); iter != a.end(); ++iter) {
-            *(iter) = distribution(generator);
-          }
+          this->fill_random(a, i, generator);
           this->A.push_back(a);
           this->normCol(i);
         }
@@ -574,29 +650,61 @@ namespace btas{
     void ALS(ind_t rank, ConvClass &converge_test, bool dir, int max_als, bool calculate_epsilon,
              double &epsilon, bool &fast_pI) {
 
-      size_t count = 0;
+      size_t count = this->resumed_sweeps(rank, converge_test);
 
       // Until either the initial guess is converged or it runs out of iterations
       // update the factor matrices with or without Khatri-Rao product
       // intermediate
       bool is_converged = false;
       bool matlab = fast_pI;
+      // Gram matrices of the factors are cached and only recomputed when a factor changes
+      this->init_gram();
+      // Line search step power, grows as extrapolations are rejected
+      double power = ls_power;
+      size_t failed_ls = 0;
+      if (symmetric_packing && dir && packed_ref.empty()) pack_reference();
       //std::cout << "count\tfit\tFit Change" << std::endl;
       while (count < max_als && !is_converged) {
         count++;
         this->num_ALS++;
+        auto sweep_start = this->observe_sweep_begin(count, rank);
+        bool extrapolate = ls_interval > 0 && count % ls_interval == 0;
+        std::vector<Tensor> A_old;
+        if (extrapolate) A_old = A;
+        // The factor of the symmetric pair changed in the previous sweep
+        pair_contraction = Tensor();
+        bool packed = dir && !packed_ref.empty();
         for (size_t i = 0; i < ndim; i++) {
           auto tmp = symmetries[i];
           if (tmp != i) {
             A[i] = A[tmp];
+            AtA[i] = AtA[tmp];
+            continue;
+          }
+          auto mode_start = this->observe_mode_begin();
+          if (packed && i == ndim - 2) {
+            direct_packed_pair(i, rank, fast_pI, matlab, converge_test);
           } else if (dir) {
             direct(i, rank, fast_pI, matlab, converge_test);
           } else {
             update_w_KRP(i, rank, fast_pI, matlab, converge_test);
           }
+          this->observe_mode_end(i, mode_start, this->dense_mttkrp_flops(rank) / (packed ? 2 : 1));
+        }
+        if (extrapolate) {
+          if (line_search(A_old, count, power, converge_test)) {
+            failed_ls = 0;
+          } else if (++failed_ls == 4) {
+            // Too many consecutive rejected extrapolations, shrink the step
+            power += 1.0;
+            failed_ls = 0;
+          }
         }
         //std::cout << count << "\t";
-        is_converged = converge_test(A);
+        auto converge_start = this->phase_start();
+        is_converged = converge_test(A, AtA);
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
+        this->checkpoint_sweep(count, converge_test);
         //T *= 0.6;
       }
 
@@ -606,7 +714,7 @@ namespace btas{
           detail::get_fit(converge_test, epsilon);
           epsilon = 1 - epsilon;
         } else{
-          epsilon = this->norm(this->reconstruct() - tensor_ref);
+          epsilon = cp_residual_norm(tensor_ref, A);
         }
       }
     }
@@ -623,48 +731,12 @@ namespace btas{
     /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit. test to see if the ALS is converged
     void update_w_KRP(size_t n, ind_t rank, bool &fast_pI,
                       bool &matlab, ConvClass &converge_test) {
-      Tensor temp(A[n].extent(0), rank);
-      Tensor an(A[n].range());
-
-#ifdef BTAS_HAS_INTEL_MKL
-
-      // Computes the Khatri-Rao product intermediate
-      auto KhatriRao = this->generate_KRP(n, rank, true);
-
-      // moves mode n of the reference tensor to the front to simplify contraction
-      swap_to_first(tensor_ref, n);
-      std::vector<ind_t> tref_indices, KRP_dims, An_indices;
-
-      // resize the Khatri-Rao product to the proper dimensions
-      for (size_t i = 1; i < ndim; i++) {
-        KRP_dims.push_back(tensor_ref.extent(i));
-      }
-      KRP_dims.push_back(rank);
-      KhatriRao.resize(KRP_dims);
-      KRP_dims.clear();
-
-      // build contraction indices to contract over correct modes
-      An_indices.push_back(0);
-      An_indices.push_back(ndim);
-      tref_indices.push_back(0);
-      for (size_t i = 1; i < ndim; i++) {
-        tref_indices.push_back(i);
-        KRP_dims.push_back(i);
-      }
-      KRP_dims.push_back(ndim);
-
-      contract(1.0, tensor_ref, tref_indices, KhatriRao, KRP_dims, 0.0, temp, An_indices);
-
-      // move the nth mode of the reference tensor back where it belongs
-      swap_to_first(tensor_ref, n, true);
-
-#else  // BTAS_HAS_CBLAS
-      // without MKL program cannot perform the swapping algorithm, must compute
-      // flattened intermediate
-      gemm(CblasNoTrans, CblasNoTrans, 1.0, flatten(tensor_ref, n), this->generate_KRP(n, rank, true), 0.0, temp);
-#endif
+      // The MTTKRP reads the reference tensor in place, with the Khatri-Rao
+      // products of the modes left and right of n, see detail::mttkrp_matricized
+      Tensor temp = detail::mttkrp_matricized(tensor_ref, A, n);
 
       detail::set_MtKRP(converge_test, temp);
+      if (ls_interval > 0 && n == ndim - 1) MtKRP_last = temp;
 
       // contract the product from above with the pseudoinverse of the Hadamard
       // produce an optimize factor matrix
@@ -676,6 +748,7 @@ namespace btas{
 
       // Replace the old factor matrix with the new optimized result
       A[n] = temp;
+      this->update_gram(n);
     }
 
 
@@ -700,6 +773,30 @@ namespace btas{
     /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit. test to see if the ALS is converged
 
     void direct(size_t n, ind_t rank, bool &fast_pI, bool &matlab, ConvClass &converge_test) {
+      Tensor temp = direct_mttkrp(n, rank, A);
+
+      // multiply resulting matrix temp by pseudoinverse to calculate optimized
+      // factor matrix
+      detail::set_MtKRP(converge_test, temp);
+      if (ls_interval > 0 && n == ndim - 1) MtKRP_last = temp;
+      // Temp is then rewritten with unnormalized new A[n] matrix
+      this->pseudoinverse_helper(n, fast_pI, matlab, temp);
+
+      // Normalize the columns of the new factor matrix and update
+      this->normCol(temp);
+      A[n] = temp;
+      this->update_gram(n);
+    }
+
+    /// Contracts the reference tensor with every factor matrix but the one of
+    /// mode \c n, without forming the Khatri-Rao product, see direct().
+    /// \param[in] n The mode which is not contracted
+    /// \param[in] rank The current rank, column dimension of the factor matrices
+    /// \param[in] factors The factor matrices, \c A or a candidate of the line search.
+    /// The packed symmetric pair is only used for \c A, its contraction is cached per sweep.
+    /// The MTTKRP of a complex tensor contracts with the conjugate factors, they are not modified.
+    /// \return The MTTKRP of mode \c n, \f$ I_n \times R \f$
+    Tensor direct_mttkrp(size_t n, ind_t rank, const std::vector<Tensor> &factors) {
 
       // Determine if n is the last mode, if it is first contract with first mode
       // and transpose the product
@@ -716,23 +813,24 @@ namespace btas{
         dimensions.push_back(tensor_ref.extent(i));
       }
 
-      // Modifying the dimension of tensor_ref so store the range here to resize
-      Range R = tensor_ref.range();
-      Tensor an(A[n].range());
-
-      // Resize the tensor which will store the product of tensor_ref and the first factor matrix
-      Tensor temp = Tensor(size / tensor_ref.extent(contract_dim), rank);
-      tensor_ref.resize(Range{
-              Range1{last_dim ? tensor_ref.extent(contract_dim) : size / tensor_ref.extent(contract_dim)},
-              Range1{last_dim ? size / tensor_ref.extent(contract_dim) : tensor_ref.extent(contract_dim)}});
-
-      // contract tensor ref and the first factor matrix
-      gemm((last_dim ? CblasTrans : CblasNoTrans), CblasNoTrans, 1.0, tensor_ref, A[contract_dim], 0.0, temp);
-
-      // Resize tensor_ref
-      tensor_ref.resize(R);
-      // Remove the dimension which was just contracted out
-      LH_size /= tensor_ref.extent(contract_dim);
+      // With a packed reference the symmetric last mode pair is contracted at once
+      bool packed = !packed_ref.empty() && n < ndim - 2 && &factors == &A;
+      Tensor temp;
+      if (packed) {
+        temp = contract_packed_pair(rank);
+        LH_size /= tensor_ref.extent(ndim - 2) * tensor_ref.extent(ndim - 1);
+      } else {
+        // Contract tensor ref, viewed as a matrix, and the first factor matrix
+        temp = Tensor(size / tensor_ref.extent(contract_dim), rank);
+        Tensor conj_buffer;
+        detail::gemm_matricized(last_dim ? CblasTrans : CblasNoTrans, tensor_ref,
+                                last_dim ? tensor_ref.extent(contract_dim) : size / tensor_ref.extent(contract_dim),
+                                last_dim ? size / tensor_ref.extent(contract_dim) : tensor_ref.extent(contract_dim),
+                                detail::conjugate_factor(factors[contract_dim], conj_buffer), temp);
+
+        // Remove the dimension which was just contracted out
+        LH_size /= tensor_ref.extent(contract_dim);
+      }
 
       // n tells which dimension not to contract, and contract_dim says which dimension I am trying to contract.
       // If n == contract_dim then that mode is skipped.
@@ -740,7 +838,7 @@ namespace btas{
       // move the pointer that preserves the last dimension to n = ndim -2.
       // In all cases I want to walk through the orders in tensor_ref backward so contract_dim = ndim - 2
       n = last_dim ? ndim - 2: n;
-      contract_dim = ndim - 2;
+      contract_dim = packed ? ndim - 3 : ndim - 2;
 
       while (contract_dim > 0) {
         // Now temp is three index object where temp has size
@@ -750,7 +848,7 @@ namespace btas{
                           Range1{pseudo_rank}});
         Tensor contract_tensor(Range{Range1{temp.extent(0)}, Range1{temp.extent(2)}});
         contract_tensor.fill(0.0);
-        const auto &a = A[(last_dim ? contract_dim + 1 : contract_dim)];
+        const auto &a = factors[(last_dim ? contract_dim + 1 : contract_dim)];
         // If the middle dimension is the mode not being contracted, I will move
         // it to the right hand side temp((size of tensor_ref/product of
         // dimension contracted, rank * mode n dimension)
@@ -771,7 +869,7 @@ namespace btas{
               const auto *temp_ptr = temp.data() + i_times_rank_idx2 + j_times_rank;
               const auto *A_ptr = a.data() + j_times_rank;
               for (ind_t r = 0; r < rank; r++) {
-                *(contract_ptr + r) += *(temp_ptr + r) * *(A_ptr + r);
+                *(contract_ptr + r) += *(temp_ptr + r) * impl::conj(*(A_ptr + r));
               }
             }
             i_times_rank_idx2 += j_times_rank;
@@ -793,7 +891,7 @@ namespace btas{
               ord_t k_times_rank = 0;
               for (ind_t k = 0; k < offset; k++, k_times_rank+=rank) {
                 for (ind_t r = 0; r < rank; r++) {
-                  *(contract_ptr + k_times_rank + r) += *(temp_ptr + k_times_rank + r) * *(A_ptr + r);
+                  *(contract_ptr + k_times_rank + r) += *(temp_ptr + k_times_rank + r) * impl::conj(*(A_ptr + r));
                 }
               }
             }
@@ -817,7 +915,7 @@ namespace btas{
         contract_tensor.fill(0.0);
 
         ind_t idx1 = temp.extent(0), idx2 = temp.extent(1);
-        const auto &a = A[(last_dim ? 1 : 0)];
+        const auto &a = factors[(last_dim ? 1 : 0)];
         ord_t i_times_rank = 0, i_times_rank_idx2 = 0;
         for (ind_t i = 0; i < idx1; i++, i_times_rank += rank) {
           const auto *A_ptr = a.data() + i_times_rank;
@@ -826,7 +924,7 @@ namespace btas{
             const auto *temp_ptr = temp.data() + i_times_rank_idx2 + j_times_rank;
             auto *contract_ptr = contract_tensor.data() + j * rank;
             for (ind_t r = 0; r < rank; r++) {
-              *(contract_ptr + r) += *(A_ptr + r) * *(temp_ptr + r);
+              *(contract_ptr + r) += impl::conj(*(A_ptr + r)) * *(temp_ptr + r);
             }
           }
           i_times_rank_idx2 += j_times_rank;
@@ -834,16 +932,189 @@ namespace btas{
         temp = contract_tensor;
       }
 
-      n = last_dim ? ndim - 1: n;
-      // multiply resulting matrix temp by pseudoinverse to calculate optimized
-      // factor matrix
+      return temp;
+    }
+
+    /// Copies the reference tensor into \c packed_ref, a matrix with one row per
+    /// index of the leading modes and one column per index pair
+    /// \f$ a \leq b \f$ of the symmetric last two modes, column \f$ b(b+1)/2 + a \f$.
+    /// The two mirrored elements are averaged.
+    void pack_reference() {
+      ind_t dim = tensor_ref.extent(ndim - 1);
+      ord_t dim2 = dim * (ord_t) dim;
+      ord_t rows = size / dim2, pairs = dim * (ord_t) (dim + 1) / 2;
+      packed_ref = Tensor(rows, pairs);
+      for (ord_t l = 0; l < rows; ++l) {
+        const auto *t_ptr = tensor_ref.data() + l * dim2;
+        auto *p_ptr = packed_ref.data() + l * pairs;
+        for (ind_t b = 0; b < dim; ++b) {
+          for (ind_t a = 0; a <= b; ++a, ++p_ptr) {
+            *p_ptr = 0.5 * (*(t_ptr + a * dim + b) + *(t_ptr + b * dim + a));
+          }
+        }
+      }
+    }
+
+    /// Contracts the packed reference tensor with the factor matrix of the
+    /// symmetric pair, \f$ \sum_{a,b} T(l,a,b) A(a,r) A(b,r) \f$. Pairs with
+    /// \f$ a < b \f$ are counted twice. The product is computed once per sweep.
+    /// The factor matrix is conjugated, as in every MTTKRP.
+    /// \param[in] rank The current rank, column dimension of the factor matrices
+    /// \return The packed reference contracted over the last two modes
+    Tensor contract_packed_pair(ind_t rank) {
+      if (pair_contraction.empty()) {
+        const auto &a = A[ndim - 2];
+        ind_t dim = a.extent(0);
+        Tensor KRP(packed_ref.extent(1), rank);
+        auto *k_ptr = KRP.data();
+        for (ind_t b = 0; b < dim; ++b) {
+          const auto *b_ptr = a.data() + b * rank;
+          for (ind_t i = 0; i <= b; ++i, k_ptr += rank) {
+            const auto *i_ptr = a.data() + i * rank;
+            double weight = (i == b) ? 1.0 : 2.0;
+            for (ind_t r = 0; r < rank; ++r)
+              *(k_ptr + r) = weight * impl::conj(*(i_ptr + r) * *(b_ptr + r));
+          }
+        }
+        pair_contraction = Tensor(packed_ref.extent(0), rank);
+        gemm(CblasNoTrans, CblasNoTrans, 1.0, packed_ref, KRP, 0.0, pair_contraction);
+      }
+      return pair_contraction;
+    }
+
+    /// Computes the optimized factor matrix of the first mode of the symmetric
+    /// last mode pair from the packed reference tensor. The Khatri-Rao product
+    /// of the leading modes is contracted with the packed reference, then the
+    /// packed pair is contracted with the factor matrix of the last mode.
+    /// \param[in] n The mode being optimized, \c ndim - 2
+    /// \param[in] rank The current rank, column dimension of the factor matrices
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    /// \param[in, out] matlab If \c fast_pI = true then try to solve VA = B instead of taking pseudoinverse
+    /// in the same manner that matlab would compute the inverse.
+    /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit.
+    void direct_packed_pair(size_t n, ind_t rank, bool &fast_pI, bool &matlab, ConvClass &converge_test) {
+      ind_t dim = tensor_ref.extent(n);
+      ord_t rows = packed_ref.extent(0);
+
+      // Khatri-Rao product of the leading modes, formed row by row
+      Tensor KRP(rows, rank);
+      std::vector<ind_t> idx(n, 0);
+      for (ord_t row = 0; row < rows; ++row) {
+        auto *z_ptr = KRP.data() + row * rank;
+        std::fill(z_ptr, z_ptr + rank, 1.0);
+        for (size_t k = 0; k < n; ++k) {
+          const auto *a_ptr = A[k].data() + idx[k] * rank;
+          for (ind_t r = 0; r < rank; ++r) *(z_ptr + r) *= impl::conj(*(a_ptr + r));
+        }
+        for (size_t k = n; k > 0; --k) {
+          if (++idx[k - 1] < tensor_ref.extent(k - 1)) break;
+          idx[k - 1] = 0;
+        }
+      }
+      Tensor pairs(packed_ref.extent(1), rank);
+      gemm(CblasTrans, CblasNoTrans, 1.0, packed_ref, KRP, 0.0, pairs);
+
+      // Unpack the symmetric pair while contracting the last mode
+      Tensor temp(dim, rank);
+      temp.fill(0.0);
+      const auto &a = A[n + 1];
+      for (ind_t i = 0; i < dim; ++i) {
+        auto *t_ptr = temp.data() + i * rank;
+        for (ind_t b = 0; b < dim; ++b) {
+          const auto *p_ptr = pairs.data() + ((i <= b) ? b * (ord_t) (b + 1) / 2 + i : i * (ord_t) (i + 1) / 2 + b) * rank;
+          const auto *a_ptr = a.data() + b * rank;
+          for (ind_t r = 0; r < rank; ++r) *(t_ptr + r) += *(p_ptr + r) * impl::conj(*(a_ptr + r));
+        }
+      }
+
       detail::set_MtKRP(converge_test, temp);
-      // Temp is then rewritten with unnormalized new A[n] matrix
       this->pseudoinverse_helper(n, fast_pI, matlab, temp);
-
-      // Normalize the columns of the new factor matrix and update
       this->normCol(temp);
       A[n] = temp;
+      this->update_gram(n);
+    }
+
+    /// Computes the part of the loss function which depends on the factors,
+    /// \f$ \|T - \hat{T}\|^2 - \|T\|^2 = \|\hat{T}\|^2 - 2 \langle T, \hat{T} \rangle \f$,
+    /// from the Gram matrices of the factors and the MTTKRP of the last mode.
+    /// \param[in] factors The factor matrices and weights of \f$ \hat{T} \f$
+    /// \param[in] grams The Gram matrices of \c factors
+    /// \param[in] MtKRP The reference tensor contracted with all but the last factor matrix
+    /// \returns The factor dependent part of the squared 2-norm error
+    double partial_loss(const std::vector<Tensor> &factors, const std::vector<Tensor> &grams,
+                        const Tensor &MtKRP) {
+      ind_t rank = factors[0].extent(1);
+      const auto &lambda = factors[ndim];
+      ord_t size_last = MtKRP.size();
+      const auto *m_ptr = MtKRP.data();
+      const auto *a_ptr = factors[ndim - 1].data();
+      double iprod = 0.0;
+      for (ord_t i = 0; i < size_last; ++i) {
+        iprod += std::real(*(m_ptr + i) * impl::conj(*(a_ptr + i) * lambda(i % rank)));
+      }
+
+      Tensor V(rank, rank);
+      V.fill(1.0);
+      auto rank2 = rank * (ord_t) rank;
+      for (size_t i = 0; i < ndim; ++i) {
+        const auto *gram_ptr = grams[i].data();
+        for (ord_t j = 0; j < rank2; ++j) {
+          *(V.data() + j) *= *(gram_ptr + j);
+        }
+      }
+      double norm_model = 0.0;
+      for (ind_t i = 0; i < rank; ++i) {
+        for (ind_t j = 0; j < rank; ++j) {
+          norm_model += std::real(impl::conj(lambda(i)) * V(i, j) * lambda(j));
+        }
+      }
+      return norm_model - 2.0 * iprod;
+    }
+
+    /// Extrapolates the factor matrices along the direction of the last sweep,
+    /// \f$ A^{new} = A^{old} + s (A - A^{old}) \f$, and keeps the extrapolated
+    /// factors if they lower the loss function. The loss of the current factors
+    /// comes from the cached Gram matrices and the MTTKRP saved during the sweep,
+    /// the extrapolated factors need their Gram matrices and one direct MTTKRP.
+    /// \param[in] A_old The factor matrices before the last sweep
+    /// \param[in] iteration The current ALS iteration, determines the step size
+    /// \param[in] power The step size is \c iteration to the power 1 / \c power
+    /// \param[in, out] converge_test Test to see if ALS is converged, on acceptance
+    /// holds the MTTKRP of the extrapolated factors.
+    /// \returns true if the extrapolated factors were accepted.
+    bool line_search(const std::vector<Tensor> &A_old, size_t iteration, double power, ConvClass &converge_test) {
+      double step = std::pow((double) iteration, 1.0 / power);
+      ind_t rank = A[0].extent(1);
+
+      // The weights are extrapolated with the factors, no renormalization
+      std::vector<Tensor> A_new(ndim + 1), AtA_new(ndim);
+      for (size_t i = 0; i <= ndim; ++i) {
+        if (i < ndim && symmetries[i] != i) {
+          A_new[i] = A_new[symmetries[i]];
+          AtA_new[i] = AtA_new[symmetries[i]];
+          continue;
+        }
+        A_new[i] = A[i] - A_old[i];
+        scal(step, A_new[i]);
+        A_new[i] += A_old[i];
+        if (i < ndim) {
+          AtA_new[i] = Tensor(rank, rank);
+          gemm(impl::adjoint_trans<typename Tensor::value_type>(), CblasNoTrans, 1.0, A_new[i], A_new[i], 0.0,
+               AtA_new[i]);
+        }
+      }
+
+      // MTTKRP of the last mode by the direct contraction
+      Tensor MtKRP_new = direct_mttkrp(ndim - 1, rank, A_new);
+
+      if (partial_loss(A_new, AtA_new, MtKRP_new) < partial_loss(A, AtA, MtKRP_last)) {
+        A = A_new;
+        AtA = AtA_new;
+        MtKRP_last = MtKRP_new;
+        detail::set_MtKRP(converge_test, MtKRP_new);
+        return true;
+      }
+      return false;
     }
 
   };
@@ -0,0 +1,444 @@
+#ifndef BTAS_GENERIC_CP_ARLS_H
+#define BTAS_GENERIC_CP_ARLS_H
+
+#include <btas/generic/cp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace btas{
+
+  /// Distribution used by CP_ARLS to sample the rows of the Khatri-Rao product
+  enum class ARLSSampling {
+    uniform,        // every row of the Khatri-Rao product is equally likely
+    leverage        // rows sampled proportional to the product of the factor leverage scores
+  };
+
+  /** \brief Computes the Canonical Product (CP) decomposition of an order-N
+    tensor using alternating randomized least squares (CP-ARLS).
+
+    Instead of solving the full least squares problem of each mode,
+    \f$ \min_{A_n} \| T_{(n)} - A_n (\odot_{k \neq n} A_k)^T \| \f$,
+    only \c S rows of the Khatri-Rao product and the corresponding mode-n
+    fibers of the reference tensor are sampled, so the cost of a sweep does not
+    depend on the size of the reference tensor. Rows are either sampled uniformly or
+    proportional to the product of the leverage scores of the factor matrices.
+    References: <a href="https://arxiv.org/abs/1701.06600">arXiv:1701.06600</a>
+    and <a href="https://arxiv.org/abs/2006.16438">arXiv:2006.16438</a>.
+
+    Because the fit computed during the sweeps is only an estimate, the fit of
+    the final factors is checked exactly against the reference tensor once the
+    ALS is finished with cp_residual_norm(), see get_exact_fit(). A NormCheck
+    or a FitCheck with a loose tolerance are the recommended convergence tests.
+
+    This computes the CP decomposition of btas::Tensor objects with row
+    major storage only with fixed (compile-time) and variable (run-time)
+    ranks. Does not support strided ranges.
+
+    Synopsis:
+    \code
+    // Constructors
+    CP_ARLS A(tensor)                   // CP_ARLS object with empty factor
+                                        // matrices and no symmetries
+    CP_ARLS A(tensor, symms)            // CP_ARLS object with empty factor
+                                        // matrices and symmetries
+
+    // Options
+    A.set_sampling(ARLSSampling::leverage, S) // Sample S rows of the Khatri-Rao
+                                              // product using leverage scores
+
+    // Operations
+    A.compute_rank_random(rank, converge_test)      // Computes the CP_ARLS of tensor to
+                                                    // rank. Factor matrices built at rank
+                                                    // with random numbers
+
+    A.compute_error(converge_test, omega)           // Computes the CP_ARLS of tensor to
+                                                    // 2-norm
+                                                    // error < omega.
+
+    A.get_exact_fit()                   // Returns the exact fit of the last decomposition
+
+   //See documentation for full range of options
+
+    // Accessing Factor Matrices
+    A.get_factor_matrices()             // Returns a vector of factor matrices, if
+                                        // they have been computed
+
+    A.reconstruct()                     // Returns the tensor computed using the
+                                        // CP factor matrices
+    \endcode
+  */
+  template <typename Tensor, class ConvClass = NormCheck<Tensor> >
+  class CP_ARLS : public CP<Tensor, ConvClass>
+          {
+  public:
+    using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
+    using CP<Tensor,ConvClass>::ndim;
+    using CP<Tensor,ConvClass>::symmetries;
+    using typename CP<Tensor,ConvClass>::ind_t;
+    using typename CP<Tensor,ConvClass>::ord_t;
+
+    /// Create a CP ARLS object, child class of the CP object
+    /// that stores the reference tensor.
+    /// Reference tensor has no symmetries.
+    /// \param[in] tensor the reference tensor to be decomposed.
+    CP_ARLS(const Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
+                                   size(tensor.size()){
+      for (size_t i = 0; i < ndim; ++i) {
+        symmetries.push_back(i);
+      }
+    }
+
+    /// Create a CP ARLS object, child class of the CP object
+    /// that stores the reference tensor.
+    /// Reference tensor has symmetries.
+    /// Symmetries should be set such that the higher modes index
+    /// are set equal to lower mode indices (a 4th order tensor,
+    /// where the second & third modes are equal would have a
+    /// symmetries of {0,1,1,3}
+    /// \param[in] tensor the reference tensor to be decomposed.
+    /// \param[in] symms the symmetries of the reference tensor.
+    CP_ARLS(const Tensor &tensor, std::vector<size_t> &symms) : CP<Tensor, ConvClass>(tensor.rank()),
+                                                                tensor_ref(tensor), size(tensor.size()){
+      symmetries = symms;
+      if (symmetries.size() > ndim) BTAS_EXCEPTION("Too many symmetries provided")
+      for (size_t i = 0; i < ndim; ++i) {
+        if (symmetries[i] > i) BTAS_EXCEPTION("Symmetries should always refer to factors at earlier positions");
+      }
+    }
+
+    ~CP_ARLS() = default;
+
+    /// Sets how the rows of the Khatri-Rao product are sampled
+    /// \param[in] sampling Sample rows uniformly or by their leverage scores
+    /// \param[in] num_samples Number of rows sampled for each least squares problem,
+    /// if 0 use \f$ 10 R \lceil \ln R \rceil \f$ rows where R is the CP rank. Default = 0.
+    void set_sampling(ARLSSampling sampling, size_t num_samples = 0) {
+      sampling_ = sampling;
+      num_samples_ = num_samples;
+    }
+
+    /// returns the exact fit \f$ 1 - \|T - \hat{T}\| / \|T\| \f$ of the factor matrices
+    /// computed by the last ALS optimization.
+    /// \throw Exception if the CP decomposition is not yet computed.
+    double get_exact_fit() const {
+      if (A.empty()) BTAS_EXCEPTION("Factor matrices have not been computed. You must first calculate CP decomposition.");
+      return exact_fit_;
+    }
+
+    /// \brief Computes decomposition of the order-N tensor \c tensor
+    /// with rank = \c RankStep * \c panels *  max_dim(reference_tensor) + max_dim(reference_tensor)
+    /// Initial guess for factor matrices start at rank = max_dim(reference_tensor)
+    /// and builds rank \c panel times by \c RankStep * max_dim(reference_tensor) increments.
+    /// The first panel is built from random numbers, SVD initial guesses are not used.
+
+    /// \param[in, out] converge_list Tests to see if ALS is converged, holds the value of fit.
+    /// should be as many tests as there are panels
+    /// \param[in] RankStep CP_ARLS increment of the panel
+    /// \param[in] panels number of times the rank will be built
+    /// \param[in]
+    /// max_als Max number of iterations allowed to converge the ALS approximation default = 1e4
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    /// default = true
+    /// \param[in]
+    /// calculate_epsilon Should the 2-norm error be calculated \f$ ||T_{\rm exact} -
+    /// T_{\rm approx}|| = \epsilon. \f$ Default = false.
+    /// \param[in] direct Not used, the Khatri-Rao product is never formed.
+    /// \returns 2-norm
+    /// error between exact and approximate tensor, -1 if calculate_epsilon =
+    /// false && ConvClass != FitCheck.
+    double compute_PALS(std::vector <ConvClass> &converge_list, double RankStep = 0.5, size_t panels = 4,
+                        int max_als = 20, bool fast_pI = false, bool calculate_epsilon = false,
+                        bool direct = true) override {
+      if (RankStep <= 0) BTAS_EXCEPTION("Panel step size cannot be less than or equal to zero");
+      if (converge_list.size() < panels) BTAS_EXCEPTION(
+              "Too few convergence tests.  Must provide a list of panels convergence tests");
+      double epsilon = -1.0;
+      ind_t max_dim = tensor_ref.extent(0);
+      for (size_t i = 1; i < ndim; ++i) {
+        ind_t dim = tensor_ref.extent(i);
+        max_dim = (dim > max_dim ? dim : max_dim);
+      }
+
+      ind_t rank = max_dim;
+      for (size_t count = 0; count < panels; ++count) {
+        auto converge_test = converge_list[count];
+        build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+        rank += RankStep * max_dim;
+      }
+      return epsilon;
+    }
+
+  protected:
+    const Tensor &tensor_ref;                       // Tensor to be decomposed
+    ord_t size;                                     // Total number of elements
+    ARLSSampling sampling_ = ARLSSampling::uniform; // Distribution of the sampled Khatri-Rao rows
+    size_t num_samples_ = 0;                        // Number of sampled rows, 0 = chosen from the rank
+    double exact_fit_ = 0.0;                        // Exact fit of the last ALS optimization
+    double norm_ref_ = -1.0;                        // Frobenius norm of tensor_ref, computed once
+    std::vector<std::vector<double> > probs_;       // Row sampling probabilities of each factor matrix
+
+    /// Grows the factor matrices to rank \c rank then optimizes them with CP-ARLS.
+    /// New columns are filled with random numbers; the SVD initial guess
+    /// is not available because it requires the full reference tensor.
+
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit.
+    /// \param[in] direct Not used, the Khatri-Rao product is never formed.
+    /// \param[in] max_als If CP decomposition is to finite
+    /// error, max_als is the highest rank approximation computed before giving up
+    /// on CP-ALS.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated \f$ ||T_{\rm exact} - T_{\rm approx}|| = \epsilon \f$ .
+    /// \param[in] step Not used, the factors are grown directly to \c rank.
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    /// \param[in] SVD_initial_guess Must be false
+    /// \param[in] SVD_rank Not used
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    void build(ind_t rank, ConvClass &converge_test, bool /*direct*/, ind_t max_als, bool calculate_epsilon,
+               ind_t /*step*/, double &epsilon,
+               bool SVD_initial_guess, ind_t /*SVD_rank*/, bool &fast_pI) override {
+      if (SVD_initial_guess) BTAS_EXCEPTION("CP_ARLS does not support the SVD initial guess");
+      ind_t rank_old = A.empty() ? 0 : A[0].extent(1);
+      if (rank_old >= rank && !A.empty()) {
+        ALS(rank_old, converge_test, max_als, calculate_epsilon, epsilon, fast_pI);
+        return;
+      }
+
+      std::mt19937 generator(random_seed_accessor());
+      std::vector<Tensor> factors;
+      for (size_t i = 0; i < ndim; ++i) {
+        auto tmp = symmetries[i];
+        if (tmp != i) {
+          factors.push_back(factors[tmp]);
+          continue;
+        }
+        ind_t row_extent = tensor_ref.extent(i), zero = 0;
+        Tensor a(row_extent, rank);
+        this->fill_random(a, i, generator);
+        // Keep the columns already optimized
+        if (rank_old > 0) {
+          auto lower_old = {zero, zero}, upper_old = {row_extent, rank_old};
+          auto old_view = make_view(a.range().slice(lower_old, upper_old), a.storage());
+          auto A_itr = A[i].begin();
+          for (auto iter = old_view.begin(); iter != old_view.end(); ++iter, ++A_itr) {
+            *(iter) = *(A_itr);
+          }
+        }
+        factors.push_back(a);
+      }
+      A = factors;
+      Tensor lambda(rank);
+      lambda.fill(0.0);
+      A.push_back(lambda);
+      for (size_t i = 0; i < ndim; ++i) {
+        if (symmetries[i] == i)
+          this->normCol(i);
+        else
+          A[i] = A[symmetries[i]];
+      }
+
+      ALS(rank, converge_test, max_als, calculate_epsilon, epsilon, fast_pI);
+    }
+
+    /// Create a rank \c rank initial guess using
+    /// random numbers from a uniform distribution. Factors seeded by
+    /// set_factor_matrices() are used instead, grown to \c rank with random columns.
+
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit.
+    /// \param[in] direct Not used, the Khatri-Rao product is never formed.
+    /// \param[in] max_als If CP decomposition is to finite
+    /// error, max_als is the highest rank approximation computed before giving up
+    /// on CP-ALS.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated \f$ ||T_{\rm exact} - T_{\rm approx}|| = \epsilon \f$ .
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    /// \throws Exception if the seeded factor matrices have a rank larger than \c rank
+    void build_random(ind_t rank, ConvClass &converge_test, bool direct, ind_t max_als,
+                      bool calculate_epsilon, double &epsilon,
+                      bool &fast_pI) override {
+      if (this->factors_set) {
+        if (A[0].extent(1) > rank) BTAS_EXCEPTION("CP_ARLS: the seeded factor matrices have a rank larger than rank");
+        this->factors_set = false;
+      } else {
+        A.clear();
+      }
+      build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+    }
+
+    /// performs the randomized ALS method to minimize the loss function for a single rank
+    /// then computes the exact fit of the resulting factor matrices.
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit.
+    /// \param[in] max_als If CP decomposition is to finite
+    /// error, max_als is the highest rank approximation computed before giving up
+    /// on CP-ALS.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated ||T_exact - T_approx|| = epsilon.
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    void ALS(ind_t rank, ConvClass &converge_test, int max_als, bool calculate_epsilon,
+             double &epsilon, bool &fast_pI) {
+      size_t count = 0;
+      bool is_converged = false;
+      bool matlab = fast_pI;
+      size_t num_samples = num_samples_;
+      if (num_samples == 0) {
+        num_samples = 10 * rank * std::max(1.0, std::ceil(std::log((double) rank)));
+      }
+
+      std::mt19937 generator(random_seed_accessor());
+      this->init_gram();
+      probs_.resize(ndim);
+      for (size_t i = 0; i < ndim; ++i) probs_[i] = row_probabilities(i);
+      while (count < max_als && !is_converged) {
+        count++;
+        this->num_ALS++;
+        auto sweep_start = this->observe_sweep_begin(count, rank);
+        for (size_t i = 0; i < ndim; i++) {
+          auto tmp = symmetries[i];
+          if (tmp != i) {
+            A[i] = A[tmp];
+            AtA[i] = AtA[tmp];
+            probs_[i] = probs_[tmp];
+          } else {
+            auto mode_start = this->observe_mode_begin();
+            sampled_update(i, rank, num_samples, generator, fast_pI, matlab, converge_test);
+            // only num_samples rows of the Khatri-Rao product enter the MTTKRP
+            this->observe_mode_end(i, mode_start, 2.0 * num_samples * A[i].extent(0) * rank);
+          }
+        }
+        auto converge_start = this->phase_start();
+        is_converged = converge_test(A, AtA);
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
+      }
+
+      // The fit seen by converge_test is only an estimate, check it exactly
+      if (norm_ref_ < 0) norm_ref_ = std::sqrt(dot(tensor_ref, tensor_ref));
+      double residual = cp_residual_norm(tensor_ref, A, norm_ref_);
+      exact_fit_ = 1.0 - residual / norm_ref_;
+      detail::set_fit(converge_test, exact_fit_);
+      if (calculate_epsilon) {
+        if (typeid(converge_test) == typeid(btas::FitCheck<Tensor>)) {
+          epsilon = 1.0 - exact_fit_;
+        } else {
+          epsilon = residual;
+        }
+      }
+    }
+
+    /// Computes the sampling probabilities of the rows of factor matrix \c n.
+    /// Leverage scores are \f$ \ell_i = a_i (A_n^T A_n)^{\dagger} a_i^T \f$
+    /// computed from the cached Gram matrix. Called once per update of \c A[n],
+    /// the Gram solve is not part of the solve counter of the ALS.
+    /// \param[in] n The factor matrix to sample
+    /// \returns The probability of sampling each row of \c A[n]
+    std::vector<double> row_probabilities(size_t n) {
+      ind_t rows = A[n].extent(0), rank = A[n].extent(1);
+      std::vector<double> prob(rows, 1.0 / rows);
+      if (sampling_ == ARLSSampling::uniform) return prob;
+
+      Tensor X = A[n];
+      SPDSolveCounter gram_counter;
+      spd_solve(AtA[n], X, gram_counter);
+      double total = 0.0;
+      for (ind_t i = 0; i < rows; ++i) {
+        const auto *x_ptr = X.data() + i * rank;
+        const auto *a_ptr = A[n].data() + i * rank;
+        double lev = 0.0;
+        for (ind_t r = 0; r < rank; ++r) lev += *(x_ptr + r) * *(a_ptr + r);
+        prob[i] = std::max(lev, 0.0);
+        total += prob[i];
+      }
+      // A zero factor cannot be sampled by leverage, fall back to uniform
+      if (total <= 0.0) return std::vector<double>(rows, 1.0 / rows);
+      for (auto &p : prob) p /= total;
+      return prob;
+    }
+
+    /// Calculates an optimized CP factor matrix from \c num_samples sampled rows
+    /// of the Khatri-Rao product and the matching mode-n fibers of the reference tensor.
+    /// Solves \f$ A_n (Z^T W Z) = X^T W Z \f$ where Z are the sampled Khatri-Rao rows,
+    /// X the sampled fibers and W the importance weights of the samples.
+    /// \param[in] n The mode being optimized, all other modes held constant
+    /// \param[in] rank The current rank, column dimension of the factor matrices
+    /// \param[in] num_samples The number of sampled rows of the Khatri-Rao product
+    /// \param[in, out] generator Random number generator used for sampling
+    /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
+    /// \param[in, out] matlab If \c fast_pI = true then solve the normal equations with
+    /// spd_solve instead of taking pseudoinverse.
+    /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit.
+    void sampled_update(size_t n, ind_t rank, size_t num_samples, std::mt19937 &generator,
+                        bool &fast_pI, bool &matlab, ConvClass &converge_test) {
+      ind_t dim_n = tensor_ref.extent(n);
+
+      // Row-major strides of the reference tensor
+      std::vector<ord_t> strides(ndim, 1);
+      for (size_t k = ndim - 1; k > 0; --k) strides[k - 1] = strides[k] * tensor_ref.extent(k);
+
+      // The probabilities of the other modes are cached from their last update
+      std::vector<std::discrete_distribution<ind_t> > dists(ndim);
+      for (size_t k = 0; k < ndim; ++k) {
+        if (k == n) continue;
+        dists[k] = std::discrete_distribution<ind_t>(probs_[k].begin(), probs_[k].end());
+      }
+
+      // Z holds the weighted Khatri-Rao rows, X the weighted mode-n fibers
+      Tensor Z(num_samples, rank), X(num_samples, dim_n);
+      const auto *T_ptr = tensor_ref.data();
+      for (size_t s = 0; s < num_samples; ++s) {
+        auto *z_ptr = Z.data() + s * rank;
+        std::fill(z_ptr, z_ptr + rank, 1.0);
+        double p = 1.0;
+        ord_t offset = 0;
+        for (size_t k = 0; k < ndim; ++k) {
+          if (k == n) continue;
+          auto idx = dists[k](generator);
+          p *= probs_[k][idx];
+          offset += idx * strides[k];
+          const auto *a_ptr = A[k].data() + idx * rank;
+          for (ind_t r = 0; r < rank; ++r) *(z_ptr + r) *= *(a_ptr + r);
+        }
+        double w = 1.0 / std::sqrt(num_samples * p);
+        for (ind_t r = 0; r < rank; ++r) *(z_ptr + r) *= w;
+        auto *x_ptr = X.data() + s * dim_n;
+        for (ind_t i = 0; i < dim_n; ++i) *(x_ptr + i) = w * *(T_ptr + offset + i * strides[n]);
+      }
+
+      Tensor temp(dim_n, rank), V(rank, rank);
+      gemm(CblasTrans, CblasNoTrans, 1.0, X, Z, 0.0, temp);
+      gemm(CblasTrans, CblasNoTrans, 1.0, Z, Z, 0.0, V);
+
+      // The sampled MTTKRP is an unbiased estimate of the exact one
+      detail::set_MtKRP(converge_test, temp);
+
+      if (matlab) {
+        spd_solve(V, temp, this->solve_counter);
+      } else {
+        auto pInv = pseudoInverse(V, fast_pI);
+        Tensor an(dim_n, rank);
+        gemm(CblasNoTrans, CblasNoTrans, 1.0, temp, pInv, 0.0, an);
+        ++(fast_pI ? this->solve_counter.fast_pinv : this->solve_counter.svd);
+        temp = an;
+      }
+
+      this->normCol(temp);
+      A[n] = temp;
+      this->update_gram(n);
+      probs_[n] = row_probabilities(n);
+    }
+  };
+
+} //namespace btas
+
+#endif //BTAS_GENERIC_CP_ARLS_H
@@ -0,0 +1,203 @@
+#ifndef BTAS_GENERIC_CP_BATCH_H
+#define BTAS_GENERIC_CP_BATCH_H
+
+#include <btas/generic/cp_als.h>
+#include <btas/generic/converge_class.h>
+#include <btas/generic/task_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace btas{
+
+  /// Settings of a single decomposition in a CP_ALS batch
+  template <typename Tensor>
+  struct CPBatchOptions {
+    using ind_t = typename Tensor::range_type::index_type::value_type;
+
+    ind_t rank = 1;             // CP rank of the decomposition
+    double tol = 1e-3;          // Convergence threshold on the change of the fit
+    ind_t max_als = 1e4;        // Maximum number of ALS sweeps
+    bool fast_pI = false;       // Solve the normal equations with the Cholesky chain
+    bool direct = true;         // Compute the MTTKRP without forming the Khatri-Rao product
+  };
+
+  /// Factor matrices and statistics of a single decomposition in a CP_ALS batch
+  template <typename Tensor>
+  struct CPBatchResult {
+    std::vector<Tensor> factors;  // Factor matrices, lambda last. Empty if the decomposition failed
+    double fit = -1.0;            // Final fit \f$ 1 - \|T - \hat{T}\| / \|T\| \f$
+    size_t iterations = 0;        // Number of ALS sweeps
+    double seconds = 0.0;         // Wall time of the decomposition
+    size_t thread = 0;            // Worker which ran the decomposition
+    SPDSolveCounter solves;       // Linear solver paths taken
+    std::string error;            // Exception message if the decomposition failed
+  };
+
+  /// Computes the CP decompositions of a collection of independent tensors
+  /// with CP_ALS, concurrently on a pool of \c nthreads workers. Each worker
+  /// runs one decomposition at a time with BLAS pinned to a single thread, so
+  /// throughput scales with the number of cores rather than relying on the
+  /// BLAS threading of small matrix products. Tensors are dealt to the workers
+  /// largest first and idle workers steal from the busy ones. The tensors are
+  /// only read, factor matrices are initialized from \c random_seed_accessor()
+  /// so the results match decomposing the tensors one at a time.
+
+  /// \param[in] tensors The reference tensors to be decomposed.
+  /// \param[in] options Settings for each tensor, a single entry is used for all tensors.
+  /// \param[in] nthreads Number of workers, 0 uses std::thread::hardware_concurrency().
+  /// \returns The factor matrices and statistics of each decomposition, in the
+  /// order of \c tensors. Exceptions thrown by a decomposition are reported in
+  /// CPBatchResult::error and do not stop the rest of the batch.
+  template <typename Tensor>
+  std::vector<CPBatchResult<Tensor>> cp_als_batch(const std::vector<Tensor> &tensors,
+                                                  const std::vector<CPBatchOptions<Tensor>> &options,
+                                                  size_t nthreads = 0) {
+    auto ntensors = tensors.size();
+    if (options.size() != 1 && options.size() != ntensors)
+      BTAS_EXCEPTION("Provide either one set of options or one per tensor");
+    nthreads = detail::num_workers(nthreads, ntensors);
+
+    std::vector<CPBatchResult<Tensor>> results(ntensors);
+    if (ntensors == 0) return results;
+
+    // Deal the tensors largest first, so the long decompositions start early
+    std::vector<size_t> order(ntensors);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return tensors[a].size() > tensors[b].size(); });
+
+    detail::run_tasks(order, nthreads, [&](size_t t, size_t id) {
+      auto &opt = options[options.size() == 1 ? 0 : t];
+      auto &res = results[t];
+      res.thread = id;
+      auto start = std::chrono::steady_clock::now();
+      try {
+        FitCheck<Tensor> conv(opt.tol);
+        conv.set_norm(std::sqrt(dot(tensors[t], tensors[t])));
+        CP_ALS<Tensor, FitCheck<Tensor>> solver(tensors[t]);
+        res.fit = solver.compute_rank_random(opt.rank, conv, opt.max_als, opt.fast_pI, false, opt.direct);
+        res.factors = solver.get_factor_matrices();
+        res.iterations = solver.get_num_ALS();
+        res.solves = solver.get_solve_counter();
+      } catch (std::exception &e) {
+        res.error = e.what();
+      }
+      res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+
+    return results;
+  }
+
+  /// Result of a rank search, see cp_rank_search()
+  template <typename Tensor>
+  struct CPRankSearchResult {
+    using ind_t = typename Tensor::range_type::index_type::value_type;
+
+    ind_t rank = 0;               // Smallest rank found with epsilon <= tcutCP, else the most accurate rank tried
+    double epsilon = -1.0;        // Relative error \f$ \|T - \hat{T}\| / \|T\| \f$ at \c rank
+    std::vector<Tensor> factors;  // Factor matrices at \c rank, lambda last
+    std::vector<std::pair<ind_t, double>> evaluated;  // (rank, epsilon) of every decomposition, in order
+    size_t rounds = 0;            // Number of parallel rounds
+  };
+
+  /// Finds the smallest CP rank whose decomposition has a relative error
+  /// \f$ \|T - \hat{T}\| / \|T\| \leq \f$ \c tcutCP, the criterion of
+  /// CP::compute_error with a FitCheck. Instead of one build per rank, each
+  /// round decomposes up to \c nthreads candidate ranks concurrently: first
+  /// ranks growing geometrically (1, 2, 4, ...) until one meets \c tcutCP,
+  /// then evenly spaced ranks inside the remaining bracket until it closes.
+  /// The search takes \f$ O(\log_{nthreads} \mathrm{rank}) \f$ rounds and
+  /// assumes the error does not increase with the rank.
+  /// Every candidate is a fresh \c Solver over the shared const \c tensor,
+  /// with factors initialized by random numbers.
+
+  /// \param[in] tensor The reference tensor to be decomposed.
+  /// \param[in] tcutCP Relative error at which a rank is accepted. Default = 1e-2.
+  /// \param[in] max_rank Largest rank tried. Default = 1e3.
+  /// \param[in] nthreads Candidates per round, 0 uses std::thread::hardware_concurrency().
+  /// \param[in] tol Convergence threshold on the change of the fit of each ALS. Default = 1e-3.
+  /// \param[in] max_als Max number of iterations of each ALS. Default = 1e4.
+  /// \param[in] fast_pI Solve the normal equations with the Cholesky chain. Default = false.
+  /// \param[in] direct Compute the MTTKRP without forming the Khatri-Rao product. Default = true.
+  /// \returns The rank, error and factor matrices found plus every rank evaluated.
+  template <typename Tensor, class Solver = CP_ALS<Tensor, FitCheck<Tensor>>>
+  CPRankSearchResult<Tensor> cp_rank_search(const Tensor &tensor, double tcutCP = 1e-2,
+                                            typename Tensor::range_type::index_type::value_type max_rank = 1e3,
+                                            size_t nthreads = 0, double tol = 1e-3,
+                                            typename Tensor::range_type::index_type::value_type max_als = 1e4,
+                                            bool fast_pI = false, bool direct = true) {
+    using ind_t = typename Tensor::range_type::index_type::value_type;
+    if (max_rank <= 0) BTAS_EXCEPTION("Decomposition rank must be greater than 0");
+    nthreads = detail::num_workers(nthreads, max_rank);
+    double normT = std::sqrt(dot(tensor, tensor));
+
+    CPRankSearchResult<Tensor> result;
+    bool found = false;
+
+    // Decomposes the candidate ranks concurrently and keeps the best answer so far
+    auto evaluate = [&](const std::vector<ind_t> &ranks) {
+      std::vector<double> eps(ranks.size());
+      std::vector<std::vector<Tensor>> factors(ranks.size());
+      // larger ranks take longer, start them first
+      std::vector<size_t> order(ranks.size());
+      for (size_t i = 0; i < ranks.size(); ++i) order[i] = ranks.size() - 1 - i;
+      detail::run_tasks(order, detail::num_workers(nthreads, ranks.size()), [&](size_t t, size_t) {
+        FitCheck<Tensor> conv(tol);
+        conv.set_norm(normT);
+        Solver solver(tensor);
+        eps[t] = 1.0 - solver.compute_rank_random(ranks[t], conv, max_als, fast_pI, false, direct);
+        factors[t] = solver.get_factor_matrices();
+      });
+      ++result.rounds;
+      for (size_t i = 0; i < ranks.size(); ++i) {
+        result.evaluated.emplace_back(ranks[i], eps[i]);
+        bool meets = eps[i] <= tcutCP;
+        bool better = found ? (meets && ranks[i] < result.rank)
+                            : (meets || result.epsilon < 0 || eps[i] < result.epsilon);
+        if (better) {
+          result.rank = ranks[i];
+          result.epsilon = eps[i];
+          result.factors = std::move(factors[i]);
+          found = found || meets;
+        }
+      }
+      return eps;
+    };
+
+    // Grow the ranks geometrically until one meets tcutCP, lo is the smallest rank not ruled out
+    ind_t lo = 1, start = 1;
+    while (!found && lo <= max_rank) {
+      std::vector<ind_t> ranks;
+      for (ind_t r = start; ranks.size() < nthreads && r < max_rank; r *= 2) ranks.push_back(r);
+      if (ranks.size() < nthreads) ranks.push_back(max_rank);
+      auto eps = evaluate(ranks);
+      for (size_t i = 0; i < ranks.size() && eps[i] > tcutCP; ++i) lo = ranks[i] + 1;
+      start = 2 * ranks.back();
+    }
+
+    // Close the bracket [lo, result.rank) with evenly spaced interior ranks
+    while (found && lo < result.rank) {
+      ind_t width = result.rank - lo;
+      std::vector<ind_t> ranks;
+      if (width <= (ind_t) nthreads) {
+        for (ind_t r = lo; r < result.rank; ++r) ranks.push_back(r);
+      } else {
+        for (size_t i = 0; i < nthreads; ++i) ranks.push_back(lo + (ind_t) ((i + 1) * width / (nthreads + 1)));
+      }
+      auto eps = evaluate(ranks);
+      for (size_t i = 0; i < ranks.size() && ranks[i] < result.rank; ++i)
+        if (eps[i] > tcutCP) lo = ranks[i] + 1;
+    }
+
+    return result;
+  }
+
+} //namespace btas
+
+#endif //BTAS_GENERIC_CP_BATCH_H
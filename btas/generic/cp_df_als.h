@@ -15,6 +15,7 @@
 
 #include <btas/generic/default_random_seed.h>
 #include <btas/generic/core_contract.h>
+#include <btas/generic/df_tiles.h>
 #include <btas/generic/flatten.h>
 #include <btas/generic/khatri_rao_product.h>
 #include <btas/generic/randomized.h>
@@ -34,8 +35,14 @@ namespace btas{
     for this mode.
     Decomposition optimization will use alternating least squares (ALS).
 
-    \warning this code takes a non-const reference \c tensor_ref but does
-   not modify the values. This is a result of API (reshape needs non-const tensor)
+    \note the connected tensors are held by const reference and are never
+   modified, so several solvers may share them concurrently.
+
+    Either connected tensor may instead be supplied by a DFTileSource which
+    generates tiles of the connecting dimension on demand and caches the most
+    recently used ones, so neither tensor has to fit in memory. Every update
+    of a factor of the other side streams both tensors once. The SVD initial
+    guess forms the full tensor and requires materialized tensors.
 
     Synopsis:
     \code
@@ -44,6 +51,9 @@ namespace btas{
                                         // matrices and no symmetries
     CP_DF_ALS A(B, Z, symms)            // CP_DF_ALS object with empty factor
                                         // matrices and symmetries
+    CP_DF_ALS A(DFTileSource(B), DFTileSource(dims, generator, tile_rows, cache_tiles))
+                                        // CP_DF_ALS object with Z generated
+                                        // in tiles
 
     // Operations
     A.compute_rank(rank, converge_test)             // Computes the CP_ALS of $T$ tensor to
@@ -83,6 +93,7 @@ namespace btas{
   public:
 
     using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
     using CP<Tensor,ConvClass>::ndim;
     using CP<Tensor,ConvClass>::normCol;
     using CP<Tensor,ConvClass>::generate_KRP;
@@ -97,10 +108,10 @@ namespace btas{
     /// Reference tensor has no symmetries.
     /// \param[in] left the reference tensor, $B$ to be decomposed.
     /// \param[in] right the reference tensor, $Z$ to be decomposed.
-    CP_DF_ALS(Tensor &left, Tensor &right) :
+    CP_DF_ALS(const Tensor &left, const Tensor &right) :
             CP<Tensor,ConvClass>(left.rank() + right.rank() - 2),
             tensor_ref_left(left), tensor_ref_right(right),
-            ndimL(left.rank()), ndimR(right.rank()) {
+            ndimL(left.rank()), ndimR(right.rank()), left_(left), right_(right) {
       for (size_t i = 0; i < ndim; ++i) {
         symmetries.push_back(i);
       }
@@ -116,10 +127,35 @@ namespace btas{
     /// \param[in] left the reference tensor, $B$ to be decomposed.
     /// \param[in] right the reference tensor, $Z$ to be decomposed.
     /// \param[in] symms the symmetries of the reference tensor.
-    CP_DF_ALS(Tensor &left, Tensor &right, std::vector<size_t> &symms) :
+    CP_DF_ALS(const Tensor &left, const Tensor &right, std::vector<size_t> &symms) :
+            CP_DF_ALS(DFTileSource<Tensor>(left), DFTileSource<Tensor>(right), symms) {}
+
+    /// Create a CP DF ALS object from connected tensors which may be
+    /// generated in tiles of the connecting dimension.
+    /// Reference tensor has no symmetries.
+    /// \param[in] left the source of the reference tensor, $B$ to be decomposed.
+    /// \param[in] right the source of the reference tensor, $Z$ to be decomposed.
+    CP_DF_ALS(DFTileSource<Tensor> left, DFTileSource<Tensor> right) :
+            CP<Tensor,ConvClass>(left.rank() + right.rank() - 2),
+            tensor_ref_left(left.materialized() ? left.tensor() : no_tensor()),
+            tensor_ref_right(right.materialized() ? right.tensor() : no_tensor()),
+            ndimL(left.rank()), ndimR(right.rank()), left_(std::move(left)), right_(std::move(right)) {
+      for (size_t i = 0; i < ndim; ++i) {
+        symmetries.push_back(i);
+      }
+    }
+
+    /// Create a CP DF ALS object from connected tensors which may be
+    /// generated in tiles of the connecting dimension.
+    /// Reference tensor has symmetries, see above.
+    /// \param[in] left the source of the reference tensor, $B$ to be decomposed.
+    /// \param[in] right the source of the reference tensor, $Z$ to be decomposed.
+    /// \param[in] symms the symmetries of the reference tensor.
+    CP_DF_ALS(DFTileSource<Tensor> left, DFTileSource<Tensor> right, std::vector<size_t> &symms) :
             CP<Tensor, ConvClass>(left.rank() + right.rank() - 2),
-            tensor_ref_left(left), tensor_ref_right(right),
-            ndimL(left.rank()), ndimR(right.rank())
+            tensor_ref_left(left.materialized() ? left.tensor() : no_tensor()),
+            tensor_ref_right(right.materialized() ? right.tensor() : no_tensor()),
+            ndimL(left.rank()), ndimR(right.rank()), left_(std::move(left)), right_(std::move(right))
     {
       symmetries = symms;
       for (size_t i = 0; i < ndim; ++i) {
@@ -163,13 +199,13 @@ namespace btas{
       double epsilon = -1.0;
       size_t count = 0;
       // Find the largest rank this will be the first panel
-      ind_t max_dim = tensor_ref_left.extent(0);
+      ind_t max_dim = left_.extent(0);
       for (size_t i = 1; i < ndimL; ++i) {
-        ind_t dim = tensor_ref_left.extent(i);
+        ind_t dim = left_.extent(i);
         max_dim = (dim > max_dim ? dim : max_dim);
       }
       for (size_t i = 0; i < ndimR; ++i) {
-        ind_t dim = tensor_ref_right.extent(i);
+        ind_t dim = right_.extent(i);
         max_dim = (dim > max_dim ? dim : max_dim);
       }
 
@@ -232,12 +268,22 @@ namespace btas{
     }
 
   protected:
-    Tensor &tensor_ref_left;        // Left connected tensor
-    Tensor &tensor_ref_right;       // Right connected tensor
+    bool supports_checkpoints() const override { return true; }
+
+    const Tensor &tensor_ref_left;  // Left connected tensor, empty if generated
+    const Tensor &tensor_ref_right; // Right connected tensor, empty if generated
     size_t ndimL;                      // Number of dimensions in left tensor
     size_t ndimR;                      // number of dims in the right tensor
+    DFTileSource<Tensor> left_;        // Tiles of the left tensor
+    DFTileSource<Tensor> right_;       // Tiles of the right tensor
     bool lastLeft = false;
     Tensor leftTimesRight;
+
+    // Bound to tensor_ref_left or tensor_ref_right when that tensor is generated
+    static const Tensor &no_tensor() {
+      static const Tensor empty;
+      return empty;
+    }
     std::vector<size_t> dims;
 
     /// Creates an initial guess by computing the SVD of each mode
@@ -269,12 +315,13 @@ namespace btas{
                ind_t step, double &epsilon,
                bool SVD_initial_guess, ind_t SVD_rank, bool &fast_pI) override {
       {
-        bool factors_set = false;
         // If its the first time into build and SVD_initial_guess
         // build and optimize the initial guess based on the left
         // singular vectors of the reference tensor.
         if (A.empty() && SVD_initial_guess) {
           if (SVD_rank == 0) BTAS_EXCEPTION("Must specify the rank of the initial approximation using SVD");
+          if (!left_.materialized() || !right_.materialized())
+            BTAS_EXCEPTION("The SVD initial guess requires materialized connected tensors");
 
           // easier to do this part by constructing tensor_ref
           // This is an N^5 step but it is only done once so it shouldn't be that expensive.
@@ -300,20 +347,9 @@ namespace btas{
           // Make TR with correct L/R size
           Tensor tensor_ref(trLsize, trRsize);
 
-          // save ranges for after contraction to resize
-          auto TRLrange = tensor_ref_left.range();
-          auto TRRrange = tensor_ref_right.range();
-
-          // resize tensors to matrices
-          tensor_ref_left.resize(Range{Range1{tensor_ref_left.extent(0)},Range1{trLsize}});
-          tensor_ref_right.resize(Range{Range1{tensor_ref_right.extent(0)},Range1{trRsize}});
-
-          // matrix multiplication
-          gemm(CblasTrans, CblasNoTrans, 1.0, tensor_ref_left, tensor_ref_right, 0.0, tensor_ref);
-
-          // Resize tensor_ref's back to original dimensions
-          tensor_ref_left.resize(TRLrange);
-          tensor_ref_right.resize(TRRrange);
+          // matrix multiplication of the left and right tensors viewed as matrices
+          detail::gemm_matricized(CblasTrans, tensor_ref_left, tensor_ref_left.extent(0), trLsize,
+                                  tensor_ref_right, tensor_ref);
           tensor_ref.resize(TRdims);
 
           std::vector<int> modes_w_dim_LT_svd;
@@ -335,10 +371,10 @@ namespace btas{
 
           for (size_t i = 0; i < ndim; i++) {
             ind_t R = tensor_ref.extent(i);
-            Tensor S(R, R), lambda(R);
+            Tensor S, lambda(R);
 
             // Contract refrence tensor to make it square matrix of mode i
-            gemm(CblasNoTrans, CblasTrans, 1.0, flatten(tensor_ref, i), flatten(tensor_ref, i), 0.0, S);
+            mode_gram(tensor_ref, i, S);
 
             // Find the Singular vectors of the matrix using eigenvalue decomposition
             eigenvalue_decomp(S, lambda);
@@ -396,9 +432,9 @@ namespace btas{
             if (i == 0) {
               Tensor a;
               if (j < ndimL - 1) {
-                a = Tensor(Range{tensor_ref_left.range().range(j + 1), Range1{rank_new}});
+                a = Tensor(Range{Range1{left_.extent(j + 1)}, Range1{rank_new}});
               } else {
-                a = Tensor(Range{tensor_ref_right.range().range(j - ndimL + 2), Range1{rank_new}});
+                a = Tensor(Range{Range1{right_.extent(j - ndimL + 2)}, Range1{rank_new}});
               }
 //              std::mt19937 generator(random_seed_accessor());
 //              std::uniform_real_distribution<> distribution(-1.0, 1.0);
@@ -450,7 +486,7 @@ namespace btas{
           // compute the ALS of factor matrices with rank = i + 1.
           ALS(rank_new, converge_test, max_als, calculate_epsilon, epsilon, fast_pI);
         }
-        if(factors_set && ! opt_in_for_loop){
+        if(this->factors_set && ! opt_in_for_loop){
           ALS(rank, converge_test, max_als, calculate_epsilon, epsilon, fast_pI);
         }
       }
@@ -478,24 +514,20 @@ namespace btas{
     void build_random(ind_t rank, ConvClass &converge_test, bool direct, ind_t max_als,
                       bool calculate_epsilon, double &epsilon,
                       bool &fast_pI) override {
-
+      // Continue from seeded factors rather than a random guess
+      if (this->factors_set) {
+        build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+        return;
+      }
       std::mt19937 generator(random_seed_accessor());
-      std::uniform_real_distribution<> distribution(-1.0, 1.0);
       for (size_t i = 1; i < ndimL; ++i) {
-        auto &tensor_ref = tensor_ref_left;
-        Tensor a(Range{Range1{tensor_ref.extent(i)}, Range1{rank}});
-        for (auto iter = a.begin(); iter != a.end(); ++iter) {
-          *(iter) = distribution(generator);
-        }
+        Tensor a(Range{Range1{left_.extent(i)}, Range1{rank}});
+        this->fill_random(a, A.size(), generator);
         A.push_back(a);
       }
       for (size_t i = 1; i < ndimR; ++i) {
-        auto &tensor_ref = tensor_ref_right;
-
-        Tensor a(tensor_ref.extent(i), rank);
-        for (auto iter = a.begin(); iter != a.end(); ++iter) {
-          *(iter) = distribution(generator);
-        }
+        Tensor a(right_.extent(i), rank);
+        this->fill_random(a, A.size(), generator);
         this->A.push_back(a);
       }
 
@@ -527,12 +559,14 @@ namespace btas{
     /// \param[in] fast_pI Should the pseudo inverse be computed using a fast cholesky decomposition
     void ALS(ind_t rank, ConvClass &converge_test, int max_als,
              bool calculate_epsilon, double &epsilon, bool &fast_pI) {
-      size_t count = 0;
+      size_t count = this->resumed_sweeps(rank, converge_test);
       // Until either the initial guess is converged or it runs out of iterations
       // update the factor matrices with or without Khatri-Rao product
       // intermediate
       bool is_converged = false;
       bool matlab = fast_pI;
+      // Gram matrices of the factors are cached and only recomputed when a factor changes
+      this->init_gram();
       Tensor MtKRP(A[ndim - 1].extent(0), rank);
       leftTimesRight = Tensor(1);
       leftTimesRight.fill(0.0);
@@ -540,17 +574,24 @@ namespace btas{
       while (count < max_als && !is_converged) {
         count++;
         this->num_ALS++;
+        auto sweep_start = this->observe_sweep_begin(count, rank);
         for (size_t i = 0; i < ndim; i++) {
           auto tmp = symmetries[i];
           if (tmp == i) {
+            auto mode_start = this->observe_mode_begin();
             direct(i, rank, fast_pI, matlab, converge_test);
+            this->observe_mode_end(i, mode_start, this->dense_mttkrp_flops(rank));
           } else if (tmp < i) {
             A[i] = A[tmp];
+            AtA[i] = AtA[tmp];
           } else {
             BTAS_EXCEPTION("Incorrectly defined symmetry");
           }
         }
-        is_converged = converge_test(A);
+        auto converge_start = this->phase_start();
+        is_converged = converge_test(A, AtA);
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
+        this->checkpoint_sweep(count, converge_test);
       }
 
       // Checks loss function if required
@@ -589,47 +630,45 @@ namespace btas{
       Tensor an(A[n].range());
 
       if (lastLeft != leftTensor) {
-        dims = std::vector<size_t>((leftTensor ? tensor_ref_left.rank() : tensor_ref_right.rank()));
-        Tensor K(tensor_ref_right.extent(0), rank);
-        {
-          lastLeft = leftTensor;
-          // want the tensor without n if n is in the left tensor take the right one and vice versa
-          auto &tensor_ref = leftTensor ? tensor_ref_right : tensor_ref_left;
-
+        using value_type = typename Tensor::value_type;
+        // want the tensor without n if n is in the left tensor take the right one and vice versa
+        auto &other = leftTensor ? right_ : left_;
+        auto &src = leftTensor ? left_ : right_;
+        dims = std::vector<size_t>(src.rank());
+        Tensor K(other.extent(0), rank);
+        lastLeft = leftTensor;
+        // The rows of K only depend on the same rows of the connecting
+        // dimension, so K is built one tile at a time
+        other.for_each_tile([&](size_t first, size_t rows, const value_type *tile) {
           // How many dimension in this side of the tensor
-          size_t ndimCurr = tensor_ref.rank();
-          ord_t sizeCurr = tensor_ref.size();
-          // save range for resize at the end.
-          auto R = tensor_ref.range();
+          size_t ndimCurr = other.rank();
+          ord_t sizeCurr = rows * (other.size() / other.extent(0));
 
           // Start by contracting with the last dimension of tensor without n
           // This is important for picking the correct factor matrix
-          // not for picking from tensor_ref
+          // not for picking from the tensor
           int contract_dim_inter = leftTensor ? ndim - 1 : ndimL - 2;
 
           // This is for size of the dimension being contracted
-          // picked from tensor_ref
-          ind_t contract_size = tensor_ref.extent(ndimCurr - 1);
+          // picked from the tensor
+          ind_t contract_size = other.extent(ndimCurr - 1);
 
           // Make the intermediate that will be contracted then hadamard contracted
-          // Also resize the tensor for gemm contraction
           Tensor contract_tensor(sizeCurr / contract_size, rank);
-          tensor_ref.resize(Range{Range1{sizeCurr / contract_size}, Range1{contract_size}});
 
-          // Contract out the last dimension
-          gemm(CblasNoTrans, CblasNoTrans, 1.0, tensor_ref, A[contract_dim_inter], 0.0, contract_tensor);
-          // Resize tensor_ref back to original size
-          tensor_ref.resize(R);
+          // Contract out the last dimension, viewing the tile as a matrix
+          gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, sizeCurr / contract_size, rank, contract_size, 1.0, tile,
+               contract_size, A[contract_dim_inter].data(), rank, 0.0, contract_tensor.data(), rank);
 
           // This is the size of the LH dimension of contract_tensor
-          sizeCurr /= tensor_ref.extent(ndimCurr - 1);
+          sizeCurr /= contract_size;
           // for A now choose the next factor matrix
           --contract_dim_inter;
 
           // Now want to hadamard contract all the dimension that aren't the connecting dimension
           for (size_t i = 0; i < ndimCurr - 2; ++i, --contract_dim_inter) {
             // The contract_size now starts at the second last dimension
-            contract_size = tensor_ref.extent(ndimCurr - 2 - i);
+            contract_size = other.extent(ndimCurr - 2 - i);
             // Store the LH most dimension size in idx1
             ord_t idx1 = sizeCurr / contract_size;
             contract_tensor.resize(Range{Range1{idx1}, Range1{contract_size}, Range1{rank}});
@@ -657,33 +696,27 @@ namespace btas{
             sizeCurr = idx1;
           }
 
-          // set the hadamard contracted tensor to the intermediate K
-          K = contract_tensor;
-        }
+          // set the hadamard contracted rows of the intermediate K
+          std::copy(contract_tensor.begin(), contract_tensor.end(), K.data() + first * rank);
+        });
         {
-          // contract K with the other side tensor
-          // Tensor_ref now can be the side that contains n
-          Tensor & tensor_ref = leftTensor ? tensor_ref_left : tensor_ref_right;
-          // Modifying the dimension of tensor_ref so store the range here to resize
-          // after contraction.
-          Range R = tensor_ref.range();
-          // make the new factor matrix for after process
+          // contract K with the other side tensor, the side that contains n
 
           // LH side of tensor after contracting (doesn't include rank or connecting dimension)
-          ord_t LH_size = tensor_ref.size() / tensor_ref.extent(0);
+          ord_t LH_size = src.size() / src.extent(0);
           // Temp holds the intermediate after contracting out the connecting dimension
           // It will be set up to enter hadamard product loop
           leftTimesRight = Tensor(LH_size, rank);
-          // resize tensor_ref to remove connecting dimension
-          tensor_ref.resize(Range{Range1{tensor_ref.extent(0)},Range1{LH_size}});
-
-          gemm(CblasTrans, CblasNoTrans, 1.0, tensor_ref, K, 0.0, leftTimesRight);
-          // resize tensor_ref back to original dimensions
-          tensor_ref.resize(R);
-
-          //std::vector<int> dims(tensor_ref.rank());
-          for (size_t i = 1; i < tensor_ref.rank(); ++i) {
-            dims[i - 1] = tensor_ref.extent(i);
+          // contract out the connecting dimension one tile at a time
+          double beta = 0.0;
+          src.for_each_tile([&](size_t first, size_t rows, const value_type *tile) {
+            gemm(CblasRowMajor, CblasTrans, CblasNoTrans, LH_size, rank, rows, 1.0, tile, LH_size,
+                 K.data() + first * rank, rank, beta, leftTimesRight.data(), rank);
+            beta = 1.0;
+          });
+
+          for (size_t i = 1; i < src.rank(); ++i) {
+            dims[i - 1] = src.extent(i);
           }
           dims[dims.size() - 1] = rank;
         }
@@ -693,8 +726,8 @@ namespace btas{
       ord_t LH_size = contract_tensor.size() / rank;
       // If hadamard loop has to skip a dimension it is stored here.
       ord_t pseudo_rank = rank;
-      // number of dimensions in tensor_ref
-      size_t ndimCurr = leftTensor ? tensor_ref_left.rank() : tensor_ref_right.rank();
+      // number of dimensions in the tensor containing n
+      size_t ndimCurr = leftTensor ? ndimL : ndimR;
       // the dimension that is being hadamard contracted out.
       size_t contract_dim = ndimCurr - 2,
               nInTensor = leftTensor ? n : n - ndimL + 1,
@@ -804,6 +837,7 @@ namespace btas{
       // Normalize the columns of the new factor matrix and update
       normCol(contract_tensor);
       A[n] = contract_tensor;
+      this->update_gram(n);
     }
 
   };
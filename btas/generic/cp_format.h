@@ -0,0 +1,216 @@
+#ifndef BTAS_GENERIC_CP_FORMAT_H
+#define BTAS_GENERIC_CP_FORMAT_H
+
+#include <btas/error.h>
+#include <btas/generic/dot_impl.h>
+#include <btas/generic/gemm_impl.h>
+#include <btas/generic/numeric_type.h>
+#include <btas/generic/reconstruct.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace btas {
+
+  // Operations on a CP model stored as in the CP classes: the factor
+  // matrices A_n of size I_n x R followed by the weights lambda of size R,
+  // M = sum_r lambda_r a_1r o a_2r o ... o a_Nr. None of them forms the
+  // dense tensor.
+
+  namespace detail {
+    // Copy of the factor matrix with its elements conjugated
+    template <typename Tensor>
+    Tensor conj_factor(const Tensor &A) {
+      Tensor C(A.range());
+      std::transform(A.begin(), A.end(), C.begin(),
+                     [](const typename Tensor::value_type &a) { return impl::conj(a); });
+      return C;
+    }
+  }  // namespace detail
+
+  /// Computes the inner product of two CP models of the same order,
+  /// \f$ \langle M_A, M_B \rangle = \bar{\lambda}_A^T \left( \ast_n A_n^H B_n \right) \lambda_B \f$,
+  /// in \f$ O(\sum_n I_n R_A R_B) \f$.
+  /// \param[in] A The factor matrices and weights of the first model
+  /// \param[in] B The factor matrices and weights of the second model
+  /// \return The inner product, conjugate linear in \c A
+  template <typename Tensor>
+  typename Tensor::value_type cp_dot(const std::vector<Tensor> &A, const std::vector<Tensor> &B) {
+    using value_type = typename Tensor::value_type;
+    if (A.size() != B.size() || A.size() < 2) BTAS_EXCEPTION("CP models of different order");
+    size_t ndim = A.size() - 1;
+    unsigned long ra = A[0].extent(1), rb = B[0].extent(1);
+
+    // Hadamard product of the factor Gram matrices
+    Tensor H(ra, rb), G(ra, rb);
+    H.fill(value_type(1));
+    for (size_t n = 0; n < ndim; ++n) {
+      if (A[n].extent(0) != B[n].extent(0)) BTAS_EXCEPTION("CP models of different dimensions");
+      gemm(impl::adjoint_trans<value_type>(), CblasNoTrans, 1.0, A[n], B[n], 0.0, G);
+      std::transform(H.begin(), H.end(), G.begin(), H.begin(), std::multiplies<value_type>());
+    }
+    value_type result(0);
+    const auto &la = A[ndim], &lb = B[ndim];
+    for (unsigned long r = 0; r < ra; ++r)
+      for (unsigned long s = 0; s < rb; ++s) result += impl::conj(la(r)) * H(r, s) * lb(s);
+    return result;
+  }
+
+  /// \param[in] A The factor matrices and weights of a CP model
+  /// \return The Frobenius norm of the model in \f$ O(\sum_n I_n R^2) \f$
+  template <typename Tensor>
+  double cp_norm(const std::vector<Tensor> &A) {
+    return std::sqrt(std::abs(cp_dot(A, A)));
+  }
+
+  /// Computes the inner product \f$ \langle M, T \rangle \f$ of a CP model and
+  /// a dense tensor. The modes of \c T are contracted from the last to the
+  /// first, the first contraction is a single GEMM and every later one is
+  /// smaller, so neither the Khatri-Rao product nor \f$ M \f$ is formed. This is
+  /// the MTTKRP of \c T contracted with the weights, \f$ O(\prod_n I_n \, R) \f$.
+  /// \param[in] A The factor matrices and weights of a CP model
+  /// \param[in] T A dense tensor of the same dimensions, row-major
+  /// \return The inner product, conjugate linear in the model
+  template <typename Tensor>
+  typename Tensor::value_type cp_dot(const std::vector<Tensor> &A, const Tensor &T) {
+    using value_type = typename Tensor::value_type;
+    size_t ndim = T.rank();
+    if (A.size() != ndim + 1) BTAS_EXCEPTION("The CP model and the tensor have different orders");
+    for (size_t n = 0; n < ndim; ++n)
+      if (A[n].extent(0) != T.extent(n)) BTAS_EXCEPTION("The CP model and the tensor have different dimensions");
+    unsigned long rank = A[0].extent(1);
+
+    // W(p, r) = sum_i T(p, i) conj(A_N(i, r))
+    unsigned long last = T.extent(ndim - 1), rows = T.size() / last;
+    std::vector<value_type> W(rows * rank), Wn;
+    auto conj_last = detail::conj_factor(A[ndim - 1]);
+    gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, rows, rank, last, 1.0, T.data(), last, conj_last.data(), rank,
+         0.0, W.data(), rank);
+
+    // W'(p, r) = sum_i W(p, i, r) conj(A_n(i, r))
+    for (size_t n = ndim - 1; n > 0; --n) {
+      unsigned long dim = T.extent(n - 1);
+      rows /= dim;
+      Wn.assign(rows * rank, value_type(0));
+      const auto *a = A[n - 1].data();
+      for (unsigned long p = 0; p < rows; ++p) {
+        auto *wn = Wn.data() + p * rank;
+        for (unsigned long i = 0; i < dim; ++i) {
+          const auto *w = W.data() + (p * dim + i) * rank;
+          for (unsigned long r = 0; r < rank; ++r) wn[r] += w[r] * impl::conj(a[i * rank + r]);
+        }
+      }
+      W.swap(Wn);
+    }
+
+    value_type result(0);
+    for (unsigned long r = 0; r < rank; ++r) result += impl::conj(A[ndim](r)) * W[r];
+    return result;
+  }
+
+  namespace detail {
+    // ||T - M|| summed element by element, M is reconstructed in blocks and never stored
+    template <typename Tensor>
+    double cp_residual_norm_exact(const Tensor &T, const std::vector<Tensor> &A) {
+      std::vector<size_t> order(T.rank());
+      std::iota(order.begin(), order.end(), 0);
+      const auto *t = T.data();
+      double r2 = 0.0;
+      reconstruct_blocked(A, order, [&](size_t first, size_t count, const typename Tensor::value_type *m) {
+        for (size_t i = 0; i < count; ++i) r2 += std::norm(t[first + i] - m[i]);
+      });
+      return std::sqrt(r2);
+    }
+  }  // namespace detail
+
+  /// Computes the residual \f$ \|T - M\| \f$ of a CP model from
+  /// \f$ \|T\|^2 - 2 \Re \langle M, T \rangle + \|M\|^2 \f$ with cp_dot(), in
+  /// \f$ O(\prod_n I_n \, R + \sum_n I_n R^2) \f$ and without forming \f$ M \f$.
+  /// The expansion cancels when the model is close to \c T, residuals below
+  /// \f$ \epsilon_{mach}^{1/4} \|T\| \f$ are therefore summed element by element
+  /// from blocks of the model, see reconstruct_blocked().
+  /// \param[in] T The dense tensor
+  /// \param[in] A The factor matrices and weights of a CP model of \c T
+  /// \param[in] normT \f$ \|T\| \f$ if it is known. Default = -1, computed.
+  /// \return The 2-norm error between \c T and the model
+  template <typename Tensor>
+  double cp_residual_norm(const Tensor &T, const std::vector<Tensor> &A, double normT = -1.0) {
+    using real_type = typename impl::real_type<typename Tensor::value_type>::type;
+    if (normT < 0) normT = std::sqrt(std::abs(dot(T, T)));
+    double normM = cp_norm(A);
+    double r2 = normT * normT - 2.0 * std::real(cp_dot(A, T)) + normM * normM;
+    // The rounding error of r2 is about eps (|T|^2 + |M|^2)
+    if (r2 <= std::sqrt(std::numeric_limits<real_type>::epsilon()) * (normT * normT + normM * normM))
+      return detail::cp_residual_norm_exact(T, A);
+    return std::sqrt(r2);
+  }
+
+  /// Multiplies a CP model by a matrix along one mode, \f$ M \times_n U^T \f$
+  /// (the convention of the Tucker transforms). Only the factor of mode \c mode
+  /// changes, to \f$ U^T A_n \f$.
+  /// \param[in] A The factor matrices and weights of a CP model
+  /// \param[in] U Matrix of size \f$ I_n \times J \f$
+  /// \param[in] mode The mode of the product
+  /// \return The CP model of the product, mode \c mode has dimension \f$ J \f$
+  template <typename Tensor>
+  std::vector<Tensor> cp_ttm(const std::vector<Tensor> &A, const Tensor &U, size_t mode) {
+    if (mode + 1 >= A.size()) BTAS_EXCEPTION("Mode outside of the CP model");
+    if (U.extent(0) != A[mode].extent(0)) BTAS_EXCEPTION("The matrix does not match the mode of the CP model");
+    std::vector<Tensor> B(A);
+    B[mode] = Tensor(U.extent(1), A[mode].extent(1));
+    gemm(CblasTrans, CblasNoTrans, 1.0, U, A[mode], 0.0, B[mode]);
+    return B;
+  }
+
+  /// Evaluates one element of a CP model, \f$ \sum_r \lambda_r \prod_n A_n(i_n, r) \f$, in \f$ O(N R) \f$.
+  /// \param[in] A The factor matrices and weights of a CP model
+  /// \param[in] index The index of the element, one per mode
+  /// \return The element
+  template <typename Tensor, typename Index>
+  typename Tensor::value_type cp_element(const std::vector<Tensor> &A, const Index &index) {
+    using value_type = typename Tensor::value_type;
+    size_t ndim = A.size() - 1;
+    if (index.size() != ndim) BTAS_EXCEPTION("The index does not match the order of the CP model");
+    unsigned long rank = A[0].extent(1);
+    std::vector<value_type> z(A[ndim].begin(), A[ndim].end());
+    size_t n = 0;
+    for (auto i : index) {
+      const auto *a = A[n++].data() + i * rank;
+      for (unsigned long r = 0; r < rank; ++r) z[r] *= a[r];
+    }
+    value_type result(0);
+    for (auto v : z) result += v;
+    return result;
+  }
+
+  /// Evaluates a slice of a CP model with one mode fixed, the result is again a
+  /// CP model with the factor of that mode folded into the weights.
+  /// \param[in] A The factor matrices and weights of a CP model of order >= 2
+  /// \param[in] mode The mode which is fixed
+  /// \param[in] index The index of \c mode
+  /// \return The CP model of order N - 1 of the slice
+  template <typename Tensor>
+  std::vector<Tensor> cp_slice(const std::vector<Tensor> &A, size_t mode,
+                               typename Tensor::range_type::index_type::value_type index) {
+    using ind_t = typename Tensor::range_type::index_type::value_type;
+    size_t ndim = A.size() - 1;
+    if (ndim < 2 || mode >= ndim) BTAS_EXCEPTION("Mode outside of the CP model");
+    if (index < 0 || index >= static_cast<ind_t>(A[mode].extent(0)))
+      BTAS_EXCEPTION("Index outside of the mode of the CP model");
+    unsigned long rank = A[0].extent(1);
+    std::vector<Tensor> B;
+    for (size_t n = 0; n < ndim; ++n)
+      if (n != mode) B.push_back(A[n]);
+    Tensor lambda = A[ndim];
+    const auto *a = A[mode].data() + index * rank;
+    for (unsigned long r = 0; r < rank; ++r) lambda(r) *= a[r];
+    B.push_back(lambda);
+    return B;
+  }
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_CP_FORMAT_H
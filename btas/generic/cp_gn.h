@@ -0,0 +1,488 @@
+#ifndef BTAS_GENERIC_CP_GN_H
+#define BTAS_GENERIC_CP_GN_H
+
+#include <btas/generic/cp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace btas{
+
+  /** \brief Computes the Canonical Product (CP) decomposition of an order-N
+    tensor using damped Gauss-Newton (Levenberg-Marquardt) steps.
+
+    All factor matrices are updated at once by solving
+    \f$ (J^T J + \mu I) p = -g \f$ with preconditioned conjugate gradients (PCG),
+    where \f$ J \f$ is the Jacobian of the residual \f$ T - \hat{T} \f$.
+    The Jacobian is never formed: \f$ J^T J \f$ products are built from the
+    Gram matrices \f$ A_n^T A_n \f$ of the factors and the gradient
+    \f$ g_n = A_n \Gamma_n - T_{(n)} (\odot_{k \neq n} A_k) \f$ reuses the
+    MTTKRP of the ALS solvers. The preconditioner is block diagonal,
+    \f$ (\Gamma_n + \mu I)^{-1} \f$ with \f$ \Gamma_n = \circledast_{k \neq n} A_k^T A_k \f$.
+    The damping \f$ \mu \f$ follows Nielsen's trust region update.
+    Reference: <a href="https://doi.org/10.1137/12086951X">SIAM J. Optim. 23, 695 (2013)</a>.
+
+    Converges in far fewer iterations than ALS for ill-conditioned problems
+    (swamps, collinear factors); every iteration costs one MTTKRP per mode,
+    the same as an ALS sweep, plus one MTTKRP for each trial step.
+
+    This computes the CP decomposition of btas::Tensor objects with row
+    major storage only with fixed (compile-time) and variable (run-time)
+    ranks. Does not support strided ranges or symmetries.
+
+    Synopsis:
+    \code
+    // Constructors
+    CP_GN A(tensor)                     // CP_GN object with empty factor
+                                        // matrices
+
+    // Options
+    A.set_cg(max_iter, tol)             // Maximum number of PCG iterations and
+                                        // relative residual of the PCG solve
+
+    // Operations
+    A.compute_rank_random(rank, converge_test)      // Computes the CP_GN of tensor to
+                                                    // rank. Factor matrices built at rank
+                                                    // with random numbers
+
+    A.compute_error(converge_test, omega)           // Computes the CP_GN of tensor to
+                                                    // 2-norm
+                                                    // error < omega.
+
+   //See documentation for full range of options
+
+    // Accessing Factor Matrices
+    A.get_factor_matrices()             // Returns a vector of factor matrices, if
+                                        // they have been computed
+
+    A.reconstruct()                     // Returns the tensor computed using the
+                                        // CP factor matrices
+    \endcode
+  */
+  template <typename Tensor, class ConvClass = NormCheck<Tensor> >
+  class CP_GN : public CP<Tensor, ConvClass>
+          {
+  public:
+    using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
+    using CP<Tensor,ConvClass>::ndim;
+    using typename CP<Tensor,ConvClass>::ind_t;
+    using typename CP<Tensor,ConvClass>::ord_t;
+
+    /// Create a CP GN object, child class of the CP object
+    /// that stores the reference tensor.
+    /// \param[in] tensor the reference tensor to be decomposed.
+    CP_GN(const Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
+                                 size(tensor.size()){
+      for (size_t i = 0; i < ndim; ++i) {
+        this->symmetries.push_back(i);
+      }
+    }
+
+    ~CP_GN() = default;
+
+    /// Sets the stopping criteria of the PCG solve of the damped normal equations
+    /// \param[in] max_iter Maximum number of PCG iterations per Gauss-Newton step. Default = 15.
+    /// \param[in] tol PCG stops when the residual is reduced by \c tol. Default = 1e-6.
+    void set_cg(size_t max_iter, double tol = 1e-6) {
+      cg_max_iter = max_iter;
+      cg_tol = tol;
+    }
+
+    /// \brief Computes decomposition of the order-N tensor \c tensor
+    /// with rank = \c RankStep * \c panels *  max_dim(reference_tensor) + max_dim(reference_tensor)
+    /// Initial guess for factor matrices start at rank = max_dim(reference_tensor)
+    /// and builds rank \c panel times by \c RankStep * max_dim(reference_tensor) increments.
+    /// The first panel is built from random numbers, SVD initial guesses are not used.
+
+    /// \param[in, out] converge_list Tests to see if ALS is converged, holds the value of fit.
+    /// should be as many tests as there are panels
+    /// \param[in] RankStep CP_GN increment of the panel
+    /// \param[in] panels number of times the rank will be built
+    /// \param[in]
+    /// max_als Max number of Gauss-Newton iterations allowed default = 20
+    /// \param[in] fast_pI Not used, the preconditioner is always solved with spd_solve.
+    /// \param[in]
+    /// calculate_epsilon Should the 2-norm error be calculated \f$ ||T_{\rm exact} -
+    /// T_{\rm approx}|| = \epsilon. \f$ Default = false.
+    /// \param[in] direct Not used.
+    /// \returns 2-norm
+    /// error between exact and approximate tensor, -1 if calculate_epsilon =
+    /// false && ConvClass != FitCheck.
+    double compute_PALS(std::vector <ConvClass> &converge_list, double RankStep = 0.5, size_t panels = 4,
+                        int max_als = 20, bool fast_pI = false, bool calculate_epsilon = false,
+                        bool direct = true) override {
+      if (RankStep <= 0) BTAS_EXCEPTION("Panel step size cannot be less than or equal to zero");
+      if (converge_list.size() < panels) BTAS_EXCEPTION(
+              "Too few convergence tests.  Must provide a list of panels convergence tests");
+      double epsilon = -1.0;
+      ind_t max_dim = tensor_ref.extent(0);
+      for (size_t i = 1; i < ndim; ++i) {
+        ind_t dim = tensor_ref.extent(i);
+        max_dim = (dim > max_dim ? dim : max_dim);
+      }
+
+      ind_t rank = max_dim;
+      for (size_t count = 0; count < panels; ++count) {
+        auto converge_test = converge_list[count];
+        build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+        rank += RankStep * max_dim;
+      }
+      return epsilon;
+    }
+
+  protected:
+    const Tensor &tensor_ref;   // Tensor to be decomposed
+    ord_t size;                 // Total number of elements
+    size_t cg_max_iter = 15;    // Maximum PCG iterations per Gauss-Newton step
+    double cg_tol = 1e-6;       // Relative residual reduction of the PCG solve
+    double norm_ref = -1.0;     // Frobenius norm of tensor_ref, computed once
+
+    /// Grows the factor matrices to rank \c rank then optimizes them with
+    /// damped Gauss-Newton. New columns are filled with random numbers.
+
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if the optimization is converged, holds the value of fit.
+    /// \param[in] direct Not used.
+    /// \param[in] max_als Max number of Gauss-Newton iterations.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated \f$ ||T_{\rm exact} - T_{\rm approx}|| = \epsilon \f$ .
+    /// \param[in] step Not used, the factors are grown directly to \c rank.
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    /// \param[in] SVD_initial_guess Must be false
+    /// \param[in] SVD_rank Not used
+    /// \param[in] fast_pI Not used.
+    void build(ind_t rank, ConvClass &converge_test, bool /*direct*/, ind_t max_als, bool calculate_epsilon,
+               ind_t /*step*/, double &epsilon,
+               bool SVD_initial_guess, ind_t /*SVD_rank*/, bool &/*fast_pI*/) override {
+      if (SVD_initial_guess) BTAS_EXCEPTION("CP_GN does not support the SVD initial guess");
+      ind_t rank_old = A.empty() ? 0 : A[0].extent(1);
+      if (rank_old >= rank && !A.empty()) {
+        GN(rank_old, converge_test, max_als, calculate_epsilon, epsilon);
+        return;
+      }
+
+      std::mt19937 generator(random_seed_accessor());
+      std::vector<Tensor> factors;
+      for (size_t i = 0; i < ndim; ++i) {
+        ind_t row_extent = tensor_ref.extent(i), zero = 0;
+        Tensor a(row_extent, rank);
+        this->fill_random(a, i, generator);
+        // Keep the columns already optimized
+        if (rank_old > 0) {
+          auto lower_old = {zero, zero}, upper_old = {row_extent, rank_old};
+          auto old_view = make_view(a.range().slice(lower_old, upper_old), a.storage());
+          auto A_itr = A[i].begin();
+          for (auto iter = old_view.begin(); iter != old_view.end(); ++iter, ++A_itr) {
+            *(iter) = *(A_itr);
+          }
+        }
+        factors.push_back(a);
+      }
+      if (rank_old > 0) {
+        for (ind_t i = 0; i < factors[0].extent(0); ++i)
+          for (ind_t r = 0; r < rank_old; ++r) factors[0](i, r) *= A[ndim](r);
+      }
+      // Weights of the old columns were absorbed into the first factor
+      A = factors;
+      Tensor lambda(rank);
+      lambda.fill(1.0);
+      A.push_back(lambda);
+
+      GN(rank, converge_test, max_als, calculate_epsilon, epsilon);
+    }
+
+    /// Create a rank \c rank initial guess using
+    /// random numbers from a uniform distribution. Factors seeded by
+    /// set_factor_matrices() are used instead, grown to \c rank with random columns.
+
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if the optimization is converged, holds the value of fit.
+    /// \param[in] direct Not used.
+    /// \param[in] max_als Max number of Gauss-Newton iterations.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated \f$ ||T_{\rm exact} - T_{\rm approx}|| = \epsilon \f$ .
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    /// \param[in] fast_pI Not used.
+    /// \throws Exception if the seeded factor matrices have a rank larger than \c rank
+    void build_random(ind_t rank, ConvClass &converge_test, bool direct, ind_t max_als,
+                      bool calculate_epsilon, double &epsilon,
+                      bool &fast_pI) override {
+      if (this->factors_set) {
+        if (A[0].extent(1) > rank) BTAS_EXCEPTION("CP_GN: the seeded factor matrices have a rank larger than rank");
+        this->factors_set = false;
+      } else {
+        A.clear();
+      }
+      build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+    }
+
+    /// Computes the MTTKRP \f$ T_{(n)} (\odot_{k \neq n} A_k) \f$ of the current factors
+    /// directly on the row-major reference tensor, viewed as \f$ T(L, I_n, R) \f$ where
+    /// L (R) are the modes left (right) of \c n: one GEMM with the Khatri-Rao product of
+    /// the right modes, then a weighted sum with the Khatri-Rao product of the left modes.
+    /// \param[in] n The mode left out of the Khatri-Rao product
+    /// \returns The MTTKRP of mode \c n
+    Tensor mttkrp(size_t n) {
+      ind_t rank = A[0].extent(1), dim_n = tensor_ref.extent(n);
+      // Khatri-Rao products with the last mode running fastest, matching row-major storage
+      auto krp = [&](size_t first, size_t last) {
+        Tensor K(1, rank), temp;
+        K.fill(1.0);
+        for (size_t k = first; k < last; ++k) {
+          khatri_rao_product(K, A[k], temp);
+          K = temp;
+        }
+        return K;
+      };
+      Tensor left = krp(0, n), right = krp(n + 1, ndim);
+      ord_t L = left.extent(0), R = right.extent(0);
+
+      // The reference tensor is const, contract its storage as a (L * I_n, R) matrix
+      Tensor Y(L * dim_n, rank);
+      gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, L * dim_n, rank, R, 1.0, tensor_ref.data(), R,
+           right.data(), rank, 0.0, Y.data(), rank);
+
+      Tensor M(dim_n, rank);
+      M.fill(0.0);
+      for (ord_t l = 0; l < L; ++l) {
+        const auto *left_ptr = left.data() + l * rank;
+        for (ind_t i = 0; i < dim_n; ++i) {
+          const auto *y_ptr = Y.data() + (l * dim_n + i) * rank;
+          auto *m_ptr = M.data() + i * rank;
+          for (ind_t r = 0; r < rank; ++r) *(m_ptr + r) += *(left_ptr + r) * *(y_ptr + r);
+        }
+      }
+      return M;
+    }
+
+    /// Computes \f$ \frac{1}{2} \|T - \hat{T}\|^2 \f$ from the Gram matrices and the
+    /// MTTKRP of the last mode. The weights of the factors must be one.
+    /// \param[in] factors The factor matrices
+    /// \param[in] grams The Gram matrices of \c factors
+    /// \param[in] M_last The MTTKRP of the last mode
+    double loss(const std::vector<Tensor> &factors, const std::vector<Tensor> &grams, const Tensor &M_last) {
+      ind_t rank = factors[0].extent(1);
+      auto rank2 = rank * (ord_t) rank;
+      Tensor V(rank, rank);
+      V.fill(1.0);
+      for (size_t k = 0; k < ndim; ++k) {
+        const auto *gram_ptr = grams[k].data();
+        for (ord_t j = 0; j < rank2; ++j) *(V.data() + j) *= *(gram_ptr + j);
+      }
+      double norm_model = 0.0;
+      for (auto &v : V) norm_model += v;
+      double iprod = dot(M_last, factors[ndim - 1]);
+      return 0.5 * std::abs(norm_ref * norm_ref + norm_model - 2.0 * iprod);
+    }
+
+    /// Hadamard product of the Gram matrices of every mode except \c n and \c m
+    /// (pass \c m = \c n to skip a single mode).
+    Tensor gram_hadamard(const std::vector<Tensor> &grams, size_t n, size_t m) {
+      ind_t rank = grams[0].extent(0);
+      auto rank2 = rank * (ord_t) rank;
+      Tensor G(rank, rank);
+      G.fill(1.0);
+      for (size_t k = 0; k < ndim; ++k) {
+        if (k == n || k == m) continue;
+        const auto *gram_ptr = grams[k].data();
+        for (ord_t j = 0; j < rank2; ++j) *(G.data() + j) *= *(gram_ptr + j);
+      }
+      return G;
+    }
+
+    /// Computes \f$ Y = (J^T J + \mu I) X \f$ without forming the Jacobian,
+    /// \f$ Y_n = X_n \Gamma_n + \sum_{m \neq n} A_n [ (X_m^T A_m) \circledast \Gamma_{nm} ] + \mu X_n \f$
+    /// \param[in] X The direction, one block per factor matrix
+    /// \param[in] Gamma Hadamard products of the Grams, \c Gamma[n * ndim + m] = \f$ \Gamma_{nm} \f$
+    /// \param[in] mu The damping parameter
+    /// \returns The product \f$ (J^T J + \mu I) X \f$
+    std::vector<Tensor> apply_JtJ(const std::vector<Tensor> &X, const std::vector<Tensor> &Gamma, double mu) {
+      ind_t rank = A[0].extent(1);
+      auto rank2 = rank * (ord_t) rank;
+      std::vector<Tensor> W(ndim), Y(ndim);
+      for (size_t m = 0; m < ndim; ++m) {
+        W[m] = Tensor(rank, rank);
+        gemm(CblasTrans, CblasNoTrans, 1.0, X[m], A[m], 0.0, W[m]);
+      }
+      for (size_t n = 0; n < ndim; ++n) {
+        Tensor Z(rank, rank);
+        Z.fill(0.0);
+        for (size_t m = 0; m < ndim; ++m) {
+          if (m == n) continue;
+          const auto *w_ptr = W[m].data();
+          const auto *g_ptr = Gamma[n * ndim + m].data();
+          auto *z_ptr = Z.data();
+          for (ord_t j = 0; j < rank2; ++j) *(z_ptr + j) += *(w_ptr + j) * *(g_ptr + j);
+        }
+        Y[n] = X[n];
+        gemm(CblasNoTrans, CblasNoTrans, 1.0, X[n], Gamma[n * ndim + n], mu, Y[n]);
+        gemm(CblasNoTrans, CblasNoTrans, 1.0, A[n], Z, 1.0, Y[n]);
+      }
+      return Y;
+    }
+
+    /// Inner product of two sets of factor sized blocks
+    double block_dot(const std::vector<Tensor> &X, const std::vector<Tensor> &Y) {
+      double d = 0.0;
+      for (size_t n = 0; n < ndim; ++n) d += dot(X[n], Y[n]);
+      return d;
+    }
+
+    /// Performs damped Gauss-Newton iterations to minimize the loss function for a single rank
+    /// \param[in] rank The rank of the CP decomposition.
+    /// \param[in, out] converge_test Test to see if the optimization is converged, holds the value of fit.
+    /// \param[in] max_als Max number of Gauss-Newton iterations.
+    /// \param[in] calculate_epsilon Should the 2-norm
+    /// error be calculated ||T_exact - T_approx|| = epsilon.
+    /// \param[in, out] epsilon The 2-norm
+    /// error between the exact and approximated reference tensor
+    void GN(ind_t rank, ConvClass &converge_test, int max_als, bool calculate_epsilon, double &epsilon) {
+      if (norm_ref < 0) norm_ref = std::sqrt(dot(tensor_ref, tensor_ref));
+
+      // The optimization works with unit weights, absorb them into the first factor
+      for (ind_t i = 0; i < A[0].extent(0); ++i)
+        for (ind_t r = 0; r < rank; ++r) A[0](i, r) *= A[ndim](r);
+      A[ndim].fill(1.0);
+
+      this->init_gram();
+      std::vector<Tensor> M(ndim);
+      M[ndim - 1] = mttkrp(ndim - 1);
+      double f = loss(A, AtA, M[ndim - 1]);
+
+      // Nielsen's initial damping, tau * max diag(J^T J)
+      double mu = 0.0, nu = 2.0;
+      for (size_t n = 0; n < ndim; ++n) {
+        auto G = gram_hadamard(AtA, n, n);
+        for (ind_t r = 0; r < rank; ++r) mu = std::max(mu, (double) G(r, r));
+      }
+      mu *= 1e-3;
+
+      size_t count = 0;
+      bool is_converged = false, new_point = true;
+      std::vector<Tensor> g(ndim), Gamma(ndim * ndim), Pinv(ndim);
+      while (count < max_als && !is_converged) {
+        count++;
+        this->num_ALS++;
+        // Every factor changes at once, a step is reported as a sweep without mode records
+        auto sweep_start = this->observe_sweep_begin(count, rank);
+        this->mode_stats = CPPhaseStats();
+
+        // Gradient g_n = A_n Gamma_n - M_n, only changes when a step was accepted
+        if (new_point) {
+          for (size_t n = 0; n < ndim; ++n)
+            for (size_t m = 0; m < ndim; ++m)
+              Gamma[n * ndim + m] = gram_hadamard(AtA, n, m);
+          for (size_t n = 0; n < ndim; ++n) {
+            if (n != ndim - 1) M[n] = mttkrp(n);
+            g[n] = M[n];
+            gemm(CblasNoTrans, CblasNoTrans, 1.0, A[n], Gamma[n * ndim + n], -1.0, g[n]);
+          }
+        }
+
+        // Block Jacobi preconditioner (Gamma_n + mu I)^{-1}
+        for (size_t n = 0; n < ndim; ++n) {
+          Tensor P = Gamma[n * ndim + n];
+          for (ind_t r = 0; r < rank; ++r) P(r, r) += mu;
+          Pinv[n] = Tensor(rank, rank);
+          Pinv[n].fill(0.0);
+          for (ind_t r = 0; r < rank; ++r) Pinv[n](r, r) = 1.0;
+          spd_solve(P, Pinv[n], this->solve_counter);
+        }
+
+        // PCG on (J^T J + mu I) p = -g
+        std::vector<Tensor> p(ndim), res(ndim), z(ndim), d(ndim);
+        for (size_t n = 0; n < ndim; ++n) {
+          p[n] = Tensor(A[n].range());
+          p[n].fill(0.0);
+          res[n] = g[n];
+          scal(-1.0, res[n]);
+          z[n] = Tensor(A[n].range());
+          gemm(CblasNoTrans, CblasNoTrans, 1.0, res[n], Pinv[n], 0.0, z[n]);
+          d[n] = z[n];
+        }
+        double rz = block_dot(res, z);
+        double res0 = std::sqrt(block_dot(res, res));
+        for (size_t it = 0; it < cg_max_iter; ++it) {
+          auto q = apply_JtJ(d, Gamma, mu);
+          double alpha = rz / block_dot(d, q);
+          for (size_t n = 0; n < ndim; ++n) {
+            axpy(alpha, d[n], p[n]);
+            axpy(-alpha, q[n], res[n]);
+          }
+          if (std::sqrt(block_dot(res, res)) <= cg_tol * res0) break;
+          for (size_t n = 0; n < ndim; ++n)
+            gemm(CblasNoTrans, CblasNoTrans, 1.0, res[n], Pinv[n], 0.0, z[n]);
+          double rz_new = block_dot(res, z);
+          double beta = rz_new / rz;
+          rz = rz_new;
+          for (size_t n = 0; n < ndim; ++n) {
+            scal(beta, d[n]);
+            d[n] += z[n];
+          }
+        }
+
+        // Predicted reduction of the Gauss-Newton model, -g^T p - 1/2 p^T J^T J p
+        auto Jp = apply_JtJ(p, Gamma, 0.0);
+        double predicted = -block_dot(g, p) - 0.5 * block_dot(p, Jp);
+
+        // Trial step, its loss needs the Grams and one MTTKRP
+        auto A_old = A;
+        auto AtA_old = AtA;
+        for (size_t n = 0; n < ndim; ++n) {
+          A[n] += p[n];
+          this->update_gram(n);
+        }
+        auto M_new = mttkrp(ndim - 1);
+        double f_new = loss(A, AtA, M_new);
+        double rho = (predicted > 0) ? (f - f_new) / predicted : -1.0;
+
+        auto converge_start = this->phase_start();
+        if (rho > 0) {
+          f = f_new;
+          M[ndim - 1] = M_new;
+          mu *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+          nu = 2.0;
+          new_point = true;
+          detail::set_MtKRP(converge_test, M_new);
+          is_converged = converge_test(A, AtA);
+        } else {
+          A = A_old;
+          AtA = AtA_old;
+          mu *= nu;
+          nu *= 2.0;
+          new_point = false;
+        }
+        this->sweep_record.stats += this->mode_stats;
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
+      }
+
+      // Move the column norms of the factors into the weights
+      Tensor lambda(rank);
+      lambda.fill(1.0);
+      for (size_t n = 0; n < ndim; ++n) {
+        this->normCol(A[n]);
+        for (ind_t r = 0; r < rank; ++r) lambda(r) *= A[ndim](r);
+      }
+      A[ndim] = lambda;
+
+      if (calculate_epsilon) {
+        if (typeid(converge_test) == typeid(btas::FitCheck<Tensor>)) {
+          detail::get_fit(converge_test, epsilon);
+          epsilon = 1 - epsilon;
+        } else {
+          epsilon = std::sqrt(2.0 * f);
+        }
+      }
+    }
+  };
+
+} //namespace btas
+
+#endif //BTAS_GENERIC_CP_GN_H
@@ -0,0 +1,171 @@
+#ifndef BTAS_GENERIC_CP_OBSERVER_H
+#define BTAS_GENERIC_CP_OBSERVER_H
+
+#include <btas/generic/linear_algebra.h>
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace btas {
+
+  /// Phases of an ALS factor matrix update reported to a CPObserver
+  enum class CPPhase : size_t {
+    mttkrp = 0,   // Contraction of the reference tensor with the other factors
+    gram,         // Refreshing the cached Gram matrix of the updated factor
+    solve,        // Solving the normal equations
+    normalize,    // Normalizing the columns of the updated factor
+    converge,     // Convergence test, once per sweep
+  };
+
+  constexpr size_t cp_num_phases = 5;
+
+  /// \returns the lower case name of \c phase, used as column and key names by CPRecorder
+  inline const char *cp_phase_name(CPPhase phase) {
+    static const char *names[cp_num_phases] = {"mttkrp", "gram", "solve", "normalize", "converge"};
+    return names[static_cast<size_t>(phase)];
+  }
+
+  /// Wall time in seconds and estimated floating point operations of each CPPhase
+  struct CPPhaseStats {
+    std::array<double, cp_num_phases> seconds{};
+    std::array<double, cp_num_phases> flops{};
+
+    double total_seconds() const {
+      double s = 0.0;
+      for (auto t : seconds) s += t;
+      return s;
+    }
+
+    double total_flops() const {
+      double f = 0.0;
+      for (auto t : flops) f += t;
+      return f;
+    }
+
+    CPPhaseStats &operator+=(const CPPhaseStats &other) {
+      for (size_t i = 0; i < cp_num_phases; ++i) {
+        seconds[i] += other.seconds[i];
+        flops[i] += other.flops[i];
+      }
+      return *this;
+    }
+  };
+
+  /// Statistics of the update of a single factor matrix
+  struct CPModeRecord {
+    size_t sweep = 0;            // ALS sweep of the current rank, starting at 1
+    size_t mode = 0;             // Factor matrix which was updated
+    size_t rank = 0;             // Column dimension of the factor matrices
+    CPPhaseStats stats;          // The converge phase is always zero
+    const char *solver = "";     // "cholesky", "ldlt", "eigen", "fast_pinv" or "svd"
+  };
+
+  /// Statistics of a complete ALS sweep
+  struct CPSweepRecord {
+    size_t sweep = 0;            // ALS sweep of the current rank, starting at 1
+    size_t rank = 0;             // Column dimension of the factor matrices
+    CPPhaseStats stats;          // Sum of the mode updates plus the convergence test
+    double wall_seconds = 0.0;   // Wall time of the sweep, includes work outside the phases (e.g. line search)
+    double fit = -1.0;           // Fit after the sweep, -1 if the convergence test does not compute it
+    SPDSolveCounter solves;      // Linear solver paths taken during the sweep
+  };
+
+  /**
+    \brief Receives per mode and per sweep statistics from the ALS loop of a CP solver.
+    Attach with CP::set_observer. Timings are only taken while an observer
+    is attached. The FLOP counts are leading order estimates, not measurements.
+  **/
+  class CPObserver {
+  public:
+    virtual ~CPObserver() = default;
+
+    /// Called after a factor matrix was updated, CPModeRecord::mode names it
+    virtual void mode_updated(const CPModeRecord &) {}
+
+    /// Called after the convergence test of every sweep
+    virtual void sweep_finished(const CPSweepRecord &) {}
+  };
+
+  /**
+    \brief CPObserver which stores every record and writes them as CSV or JSON
+  **/
+  class CPRecorder : public CPObserver {
+  public:
+    void mode_updated(const CPModeRecord &record) override { modes_.push_back(record); }
+
+    void sweep_finished(const CPSweepRecord &record) override { sweeps_.push_back(record); }
+
+    const std::vector<CPModeRecord> &modes() const { return modes_; }
+
+    const std::vector<CPSweepRecord> &sweeps() const { return sweeps_; }
+
+    void clear() {
+      modes_.clear();
+      sweeps_.clear();
+    }
+
+    /// Writes one row per mode update and per sweep, \c kind is "mode" or "sweep".
+    /// Sweep rows leave \c mode and \c solver empty, mode rows leave \c fit empty.
+    void write_csv(std::ostream &os) const {
+      os << "kind,sweep,mode,rank";
+      for (size_t p = 0; p < cp_num_phases; ++p) os << ',' << cp_phase_name(CPPhase(p)) << "_seconds";
+      for (size_t p = 0; p < cp_num_phases; ++p) os << ',' << cp_phase_name(CPPhase(p)) << "_flops";
+      os << ",wall_seconds,fit,solver\n";
+      for (auto &m : modes_) {
+        os << "mode," << m.sweep << ',' << m.mode << ',' << m.rank;
+        write_stats_csv(os, m.stats);
+        os << ',' << m.stats.total_seconds() << ",," << m.solver << '\n';
+      }
+      for (auto &s : sweeps_) {
+        os << "sweep," << s.sweep << ",," << s.rank;
+        write_stats_csv(os, s.stats);
+        os << ',' << s.wall_seconds << ',' << s.fit << ",\n";
+      }
+    }
+
+    /// Writes an object with the arrays \c modes and \c sweeps
+    void write_json(std::ostream &os) const {
+      os << "{\"modes\":[";
+      for (size_t i = 0; i < modes_.size(); ++i) {
+        auto &m = modes_[i];
+        os << (i ? "," : "") << "{\"sweep\":" << m.sweep << ",\"mode\":" << m.mode << ",\"rank\":" << m.rank;
+        write_stats_json(os, m.stats);
+        os << ",\"solver\":\"" << m.solver << "\"}";
+      }
+      os << "],\"sweeps\":[";
+      for (size_t i = 0; i < sweeps_.size(); ++i) {
+        auto &s = sweeps_[i];
+        os << (i ? "," : "") << "{\"sweep\":" << s.sweep << ",\"rank\":" << s.rank;
+        write_stats_json(os, s.stats);
+        os << ",\"wall_seconds\":" << s.wall_seconds << ",\"fit\":" << s.fit << ",\"solves\":{\"cholesky\":"
+           << s.solves.cholesky << ",\"ldlt\":" << s.solves.ldlt << ",\"eigen\":" << s.solves.eigen
+           << ",\"svd\":" << s.solves.svd << ",\"fast_pinv\":" << s.solves.fast_pinv << "}}";
+      }
+      os << "]}\n";
+    }
+
+  private:
+    std::vector<CPModeRecord> modes_;
+    std::vector<CPSweepRecord> sweeps_;
+
+    static void write_stats_csv(std::ostream &os, const CPPhaseStats &stats) {
+      for (auto t : stats.seconds) os << ',' << t;
+      for (auto f : stats.flops) os << ',' << f;
+    }
+
+    static void write_stats_json(std::ostream &os, const CPPhaseStats &stats) {
+      os << ",\"seconds\":{";
+      for (size_t p = 0; p < cp_num_phases; ++p)
+        os << (p ? "," : "") << '"' << cp_phase_name(CPPhase(p)) << "\":" << stats.seconds[p];
+      os << "},\"flops\":{";
+      for (size_t p = 0; p < cp_num_phases; ++p)
+        os << (p ? "," : "") << '"' << cp_phase_name(CPPhase(p)) << "\":" << stats.flops[p];
+      os << '}';
+    }
+  };
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_CP_OBSERVER_H
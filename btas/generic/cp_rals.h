@@ -35,8 +35,9 @@ namespace btas{
     ranks. Also provides Tucker and randomized Tucker-like compressions coupled
     with CP-RALS decomposition. Does not support strided ranges.
 
-   \warning this code takes a non-const reference \c tensor_ref but does
-   not modify the values. This is a result of API (reshape needs non-const tensor)
+   \note \c tensor_ref is held by const reference and is never modified,
+   the compression methods decompose a separate core tensor. Several solvers
+   may therefore share one reference tensor concurrently.
    
     Synopsis:
     \code
@@ -97,6 +98,7 @@ namespace btas{
         {
 public:
     using CP<Tensor,ConvClass>::A;
+    using CP<Tensor,ConvClass>::AtA;
     using CP<Tensor,ConvClass>::ndim;
     using CP<Tensor,ConvClass>::normCol;
     using CP<Tensor,ConvClass>::generate_KRP;
@@ -110,7 +112,7 @@ public:
     /// that stores the reference tensor.
     /// Reference tensor has no symmetries.
     /// \param[in] tensor the reference tensor to be decomposed.
-    CP_RALS(Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
+    CP_RALS(const Tensor& tensor): CP<Tensor,ConvClass>(tensor.rank()), tensor_ref(tensor),
             size(tensor.size()){
       for (size_t i = 0; i < ndim; ++i) {
         symmetries.push_back(i);
@@ -126,7 +128,7 @@ public:
     /// symmetries of {0,1,1,3}
     /// \param[in] tensor the reference tensor to be decomposed.
     /// \param[in] symms the symmetries of the reference tensor.
-    CP_RALS(Tensor &tensor, std::vector<size_t> &symms) : CP<Tensor, ConvClass>(tensor.rank()),
+    CP_RALS(const Tensor &tensor, std::vector<size_t> &symms) : CP<Tensor, ConvClass>(tensor.rank()),
                                                           tensor_ref(tensor), size(tensor.size()){
       symmetries = symms;
       if (symmetries.size() > ndim) BTAS_EXCEPTION("Too many symmetries provided")
@@ -265,13 +267,15 @@ public:
                                    bool fast_pI = false) {
       // Tensor compression
       std::vector<Tensor> transforms;
-      tucker_compression(tensor_ref, tcutSVD, transforms);
-      size = tensor_ref.size();
-      double epsilon = -1.0;
-
-      // CP decomposition
-      epsilon = this->compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      Tensor core;
+      tucker_compression(tensor_ref, tcutSVD, transforms, core);
 
+      // CP decomposition of the core, the reference tensor is left untouched
+      CP_RALS<Tensor, ConvClass> core_solver(core, symmetries);
+      auto epsilon = core_solver.compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      A = core_solver.A;
+      this->solve_counter += core_solver.solve_counter;
+      this->num_ALS += core_solver.get_num_ALS();
 
       // scale factor matrices
       for (size_t i = 0; i < ndim; i++) {
@@ -324,12 +328,16 @@ public:
                           ind_t rank = 0, bool direct = true, bool calculate_epsilon = false,
                           double max_als = 1e5, bool fast_pI = false) {
       std::vector <Tensor> transforms;
-      randomized_decomposition(tensor_ref, transforms, desired_compression_rank, oversampl, powerit);
-      size = tensor_ref.size();
-      double epsilon = -1.0;
+      Tensor core;
+      randomized_decomposition(tensor_ref, core, transforms, desired_compression_rank, oversampl, powerit,
+                               std::max<size_t>(1, this->random_threads), this->sketch);
 
-      // CP decomposition
-      epsilon = this->compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      // CP decomposition of the core, the reference tensor is left untouched
+      CP_RALS<Tensor, ConvClass> core_solver(core, symmetries);
+      auto epsilon = core_solver.compute_rank_random(rank, converge_test, max_als, fast_pI, calculate_epsilon, direct);
+      A = core_solver.A;
+      this->solve_counter += core_solver.solve_counter;
+      this->num_ALS += core_solver.get_num_ALS();
 
       // scale factor matrices
       for (size_t i = 0; i < ndim; i++) {
@@ -342,8 +350,10 @@ public:
     }
 
   protected:
+    bool supports_checkpoints() const override { return true; }
+
     ord_t size;                   // number of elements in tensor_ref
-    Tensor &tensor_ref;        // Tensor to be decomposed
+    const Tensor &tensor_ref;  // Tensor to be decomposed
     RALSHelper <Tensor> helper;  // Helper object to compute regularized steps
 
     /// Creates an initial guess by computing the SVD of each mode
@@ -405,10 +415,10 @@ public:
           auto tmp = symmetries[i];
           if (tmp != i) continue;
           ind_t R = tensor_ref.extent(i);
-          Tensor S(R, R), lambda(R);
+          Tensor S, lambda(R);
 
           // Contract refrence tensor to make it square matrix of mode i
-          gemm(CblasNoTrans, CblasTrans, 1.0, flatten(tensor_ref, i), flatten(tensor_ref, i), 0.0, S);
+          mode_gram(tensor_ref, i, S);
 
           // Find the Singular vectors of the matrix using eigenvalue decomposition
           eigenvalue_decomp(S, lambda);
@@ -524,8 +534,7 @@ public:
         helper = RALSHelper<Tensor>(A);
         ALS(rank_new, converge_test, direct, max_als, calculate_epsilon, epsilon, fast_pI);
       }
-      auto factors_set = false;
-      if(factors_set && ! opt_in_for_loop){
+      if(this->factors_set && ! opt_in_for_loop){
         helper = RALSHelper<Tensor>(A);
         ALS(rank, converge_test, direct, max_als, calculate_epsilon, epsilon, fast_pI);
       }
@@ -553,8 +562,12 @@ public:
     void build_random(ind_t rank, ConvClass &converge_test, bool direct, ind_t max_als,
                       bool calculate_epsilon, double &epsilon,
                       bool &fast_pI) override {
+      // Continue from seeded factors rather than a random guess
+      if (this->factors_set) {
+        build(rank, converge_test, direct, max_als, calculate_epsilon, 1, epsilon, false, 0, fast_pI);
+        return;
+      }
       std::mt19937 generator(random_seed_accessor());
-      std::uniform_real_distribution<> distribution(-1.0, 1.0);
       for (size_t i = 0; i < this->ndim; ++i) {
         // If this mode is symmetric to a previous mode, set it equal to
         // previous mode, else make a random matrix.
@@ -563,9 +576,7 @@ public:
           A.push_back(A[tmp]);
         } else {
           Tensor a(tensor_ref.extent(i), rank);
-          for (auto iter = a.begin(); iter != a.end(); ++iter) {
-            *(iter) = distribution(generator);
-          }
+          this->fill_random(a, i, generator);
           this->A.push_back(a);
           this->normCol(i);
         }
@@ -597,7 +608,7 @@ public:
 
     void ALS(ind_t rank, ConvClass &converge_test, bool dir, ind_t max_als, bool calculate_epsilon,
              double &epsilon, bool &fast_pI) {
-      size_t count = 0;
+      size_t count = this->resumed_sweeps(rank, converge_test);
 
       double s = 0.0;
       const auto s0 = 1.0;
@@ -609,24 +620,33 @@ public:
       // intermediate
       bool is_converged = false;
       bool matlab = fast_pI;
+      // Gram matrices of the factors are cached and only recomputed when a factor changes
+      this->init_gram();
       while(count < max_als && !is_converged){
         count++;
         this->num_ALS++;
+        auto sweep_start = this->observe_sweep_begin(count, rank);
         for (size_t i = 0; i < ndim; i++) {
           auto tmp = symmetries[i];
           if (tmp != i) {
             A[i] = A[tmp];
+            AtA[i] = AtA[tmp];
             lambda[i] = lambda[tmp];
           } else {
+            auto mode_start = this->observe_mode_begin();
             if (dir) {
               direct(i, rank, fast_pI, matlab, lambda[i], s, converge_test);
             } else {
               update_w_KRP(i, rank, fast_pI, matlab, lambda[i], s, converge_test);
             }
+            this->observe_mode_end(i, mode_start, this->dense_mttkrp_flops(rank));
             lambda[i] = (lambda[i] * (s * s) / (s0 * s0)) * alpha + (1 - alpha) * lambda[i];
           }
         }
-        is_converged = converge_test(A);
+        auto converge_start = this->phase_start();
+        is_converged = converge_test(A, AtA);
+        this->observe_sweep_end(sweep_start, converge_start, converge_test);
+        this->checkpoint_sweep(count, converge_test);
       }
 
       // Checks loss function if required
@@ -635,7 +655,7 @@ public:
           detail::get_fit(converge_test, epsilon);
           epsilon = 1 - epsilon;
         } else{
-          epsilon = this->norm(this->reconstruct() - tensor_ref);
+          epsilon = cp_residual_norm(tensor_ref, A);
         }
       }
     }
@@ -653,47 +673,9 @@ public:
     /// \param[in, out] converge_test Test to see if ALS is converged, holds the value of fit. test to see if the ALS is converged
     void update_w_KRP(size_t n, ind_t rank, bool &fast_pI, bool &matlab,
                       double lambda, double &s, ConvClass &converge_test) {
-      Tensor temp(A[n].extent(0), rank);
-      Tensor an(A[n].range());
-
-#ifdef BTAS_HAS_INTEL_MKL
-
-      // Computes the Khatri-Rao product intermediate
-      auto KhatriRao = generate_KRP(n, rank, true);
-
-      // moves mode n of the reference tensor to the front to simplify contraction
-      swap_to_first(tensor_ref, n);
-      std::vector<ind_t> tref_indices, KRP_dims, An_indices;
-
-      // resize the Khatri-Rao product to the proper dimensions
-      for (size_t i = 1; i < ndim; i++) {
-        KRP_dims.push_back(tensor_ref.extent(i));
-      }
-      KRP_dims.push_back(rank);
-      KhatriRao.resize(KRP_dims);
-      KRP_dims.clear();
-
-      // build contraction indices to contract over correct modes
-      An_indices.push_back(0);
-      An_indices.push_back(ndim);
-      tref_indices.push_back(0);
-      for (size_t i = 1; i < ndim; i++) {
-        tref_indices.push_back(i);
-        KRP_dims.push_back(i);
-      }
-      KRP_dims.push_back(ndim);
-
-      contract(1.0, tensor_ref, tref_indices, KhatriRao, KRP_dims, 0.0, temp, An_indices);
-
-      // move the nth mode of the reference tensor back where it belongs
-      swap_to_first(tensor_ref, n, true);
-
-#else  // BTAS_HAS_CBLAS
-
-      // without MKL program cannot perform the swapping algorithm, must compute
-      // flattened intermediate
-      gemm(CblasNoTrans, CblasNoTrans, 1.0, flatten(tensor_ref, n), generate_KRP(n, rank, true), 0.0, temp);
-#endif
+      // The MTTKRP reads the reference tensor in place, with the Khatri-Rao
+      // products of the modes left and right of n, see detail::mttkrp_matricized
+      Tensor temp = detail::mttkrp_matricized(tensor_ref, A, n);
       {
         auto LamA = A[n];
         scal(lambda, LamA);
@@ -716,6 +698,7 @@ public:
 
       // Replace the old factor matrix with the new optimized result
       A[n] = temp;
+      this->update_gram(n);
     }
 
     /// Computes an optimized factor matrix holding all others constant.
@@ -757,21 +740,17 @@ public:
         dimensions.push_back(tensor_ref.extent(i));
       }
 
-      // Modifying the dimension of tensor_ref so store the range here to resize
-      Range R = tensor_ref.range();
       Tensor an(A[n].range());
 
-      // Resize the tensor which will store the product of tensor_ref and the first factor matrix
-      Tensor temp = Tensor(size / tensor_ref.extent(contract_dim), rank);
-      tensor_ref.resize(Range{
-              Range1{last_dim ? tensor_ref.extent(contract_dim) : size / tensor_ref.extent(contract_dim)},
-              Range1{last_dim ? size / tensor_ref.extent(contract_dim) : tensor_ref.extent(contract_dim)}});
-
-      // contract tensor ref and the first factor matrix
-      gemm((last_dim ? CblasTrans : CblasNoTrans), CblasNoTrans, 1.0, tensor_ref, A[contract_dim], 0.0, temp);
+      // Contract tensor ref, viewed as a matrix, and the first factor matrix.
+      // The MTTKRP of a complex tensor contracts with the conjugate factors,
+      // they are conjugated as they are read and A is not modified.
+      Tensor temp = Tensor(size / tensor_ref.extent(contract_dim), rank), conj_buffer;
+      detail::gemm_matricized(last_dim ? CblasTrans : CblasNoTrans, tensor_ref,
+                              last_dim ? tensor_ref.extent(contract_dim) : size / tensor_ref.extent(contract_dim),
+                              last_dim ? size / tensor_ref.extent(contract_dim) : tensor_ref.extent(contract_dim),
+                              detail::conjugate_factor(A[contract_dim], conj_buffer), temp);
 
-      // Resize tensor_ref
-      tensor_ref.resize(R);
       // Remove the dimension which was just contracted out
       LH_size /= tensor_ref.extent(contract_dim);
 
@@ -811,7 +790,7 @@ public:
               const auto *temp_ptr = temp.data() + i_times_idx2_rank + j_times_rank;
               const auto *A_ptr = a.data() + j_times_rank;
               for (ind_t r = 0; r < rank; r++) {
-                *(contract_ptr + r) += *(temp_ptr + r) * *(A_ptr + r);
+                *(contract_ptr + r) += *(temp_ptr + r) * impl::conj(*(A_ptr + r));
               }
             }
             i_times_idx2_rank += j_times_rank;
@@ -832,7 +811,7 @@ public:
               ord_t k_times_rank = 0;
               for (ind_t k = 0; k < offset_dim; k++, k_times_rank += rank) {
                 for (ind_t r = 0; r < rank; r++) {
-                  *(contract_ptr + k * rank + r) += *(temp_ptr + k_times_rank + r) * *(A_ptr + r);
+                  *(contract_ptr + k * rank + r) += *(temp_ptr + k_times_rank + r) * impl::conj(*(A_ptr + r));
                 }
               }
             }
@@ -865,7 +844,7 @@ public:
             const auto *temp_ptr = temp.data() + i_times_idx2_rank + j_times_rank;
             auto *contract_ptr = contract_tensor.data() + j_times_rank;
             for (ind_t r = 0; r < rank; r++) {
-              *(contract_ptr + r) += *(A_ptr + r) * *(temp_ptr + r);
+              *(contract_ptr + r) += impl::conj(*(A_ptr + r)) * *(temp_ptr + r);
             }
           }
           i_times_idx2_rank += j_times_rank;
@@ -893,6 +872,7 @@ public:
       s = helper(n, temp);
 
       A[n] = temp;
+      this->update_gram(n);
     }
 
   };
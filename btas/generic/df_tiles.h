@@ -0,0 +1,139 @@
+#ifndef BTAS_GENERIC_DF_TILES_H
+#define BTAS_GENERIC_DF_TILES_H
+
+#include <btas/error.h>
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace btas {
+
+  /// Supplies a density fitting tensor \f$ B(X, I_1, \dots, I_n) \f$ in tiles
+  /// of consecutive indices of its connecting mode \f$ X \f$. A tile of rows
+  /// [first, last) is the row-major block \f$ B(first:last, \dots) \f$.
+  /// The tensor is either materialized, and the tiles point into its storage,
+  /// or produced on demand by a generator, e.g. from integrals, and the most
+  /// recently used tiles are kept in a cache of bounded size.
+  /// \note A generated source is not thread safe, give every solver its own
+  /// copy or share only materialized sources.
+  template <typename Tensor>
+  class DFTileSource {
+  public:
+    using value_type = typename Tensor::value_type;
+    /// Called as \c generator(first, last, tile) to write the rows [first, last)
+    /// of the connecting mode to \c tile, \c (last - first) * size() / extent(0) elements
+    using generator_type = std::function<void(size_t, size_t, value_type *)>;
+
+    DFTileSource() = default;
+
+    /// \param[in] T The materialized tensor, it must outlive the source
+    /// \param[in] tile_rows Rows of the connecting mode per tile. Default = 0, a single tile
+    explicit DFTileSource(const Tensor &T, size_t tile_rows = 0) : dense_(&T) {
+      for (size_t i = 0; i < T.rank(); ++i) extents_.push_back(T.extent(i));
+      set_tile_rows(tile_rows);
+    }
+
+    /// \param[in] extents The dimensions of the tensor, the connecting mode first
+    /// \param[in] generator Computes the tiles
+    /// \param[in] tile_rows Rows of the connecting mode per tile
+    /// \param[in] cache_tiles Number of tiles kept in the cache. Default = 1.
+    DFTileSource(std::vector<size_t> extents, generator_type generator, size_t tile_rows, size_t cache_tiles = 1)
+        : extents_(std::move(extents)), generator_(std::move(generator)),
+          cache_tiles_(std::max<size_t>(1, cache_tiles)) {
+      if (extents_.size() < 2) BTAS_EXCEPTION("A DF tensor has a connecting mode and at least one other mode");
+      if (!generator_) BTAS_EXCEPTION("The tile generator is empty");
+      set_tile_rows(tile_rows);
+    }
+
+    /// \returns true if the tensor is materialized
+    bool materialized() const { return dense_ != nullptr; }
+    /// \returns the materialized tensor, throws if it is generated
+    const Tensor &tensor() const {
+      if (!dense_) BTAS_EXCEPTION("The DF tensor is not materialized");
+      return *dense_;
+    }
+
+    size_t rank() const { return extents_.size(); }
+    size_t extent(size_t i) const { return extents_[i]; }
+    size_t size() const {
+      return std::accumulate(extents_.begin(), extents_.end(), size_t(1), std::multiplies<size_t>());
+    }
+    size_t tile_rows() const { return tile_rows_; }
+    size_t ntiles() const { return (extents_[0] + tile_rows_ - 1) / tile_rows_; }
+
+    /// \returns the number of generated tiles which were found in the cache and the number which were computed
+    std::pair<size_t, size_t> cache_stats() const { return {hits_, misses_}; }
+
+    /// \param[in] t The index of the tile
+    /// \returns the elements of tile \c t, valid until \c cache_tiles other tiles have been requested
+    const value_type *tile(size_t t) {
+      size_t first = t * tile_rows_;
+      if (dense_) return dense_->data() + first * (size() / extents_[0]);
+
+      auto found = cache_.find(t);
+      if (found != cache_.end()) {
+        ++hits_;
+        lru_.remove(t);
+        lru_.push_front(t);
+        return found->second.data();
+      }
+      ++misses_;
+      // Reuse the buffer of the least recently used tile once the cache is full
+      std::vector<value_type> buffer;
+      if (cache_.size() == cache_tiles_) {
+        auto evict = cache_.find(lru_.back());
+        buffer.swap(evict->second);
+        cache_.erase(evict);
+        lru_.pop_back();
+      }
+      size_t last = std::min(extents_[0], first + tile_rows_);
+      buffer.resize((last - first) * (size() / extents_[0]));
+      generator_(first, last, buffer.data());
+      lru_.push_front(t);
+      auto &entry = cache_[t];
+      entry.swap(buffer);
+      return entry.data();
+    }
+
+    /// Calls \c f(first, rows, data) once for every tile. The tiles in the
+    /// cache are visited first, so repeated sweeps over a tensor larger than
+    /// the cache still reuse it, the other tiles follow in order.
+    template <typename F>
+    void for_each_tile(F f) {
+      order_.assign(lru_.begin(), lru_.end());
+      visited_.assign(ntiles(), false);
+      for (auto t : order_) visited_[t] = true;
+      for (size_t t = 0; t < ntiles(); ++t)
+        if (!visited_[t]) order_.push_back(t);
+      for (auto t : order_) {
+        size_t first = t * tile_rows_;
+        f(first, std::min(tile_rows_, extents_[0] - first), tile(t));
+      }
+    }
+
+  private:
+    const Tensor *dense_ = nullptr;
+    std::vector<size_t> extents_;
+    generator_type generator_;
+    size_t tile_rows_ = 0;
+    size_t cache_tiles_ = 1;
+    std::list<size_t> lru_;  // tiles in the cache, most recently used first
+    std::unordered_map<size_t, std::vector<value_type>> cache_;
+    size_t hits_ = 0, misses_ = 0;
+    std::vector<size_t> order_;
+    std::vector<bool> visited_;
+
+    void set_tile_rows(size_t tile_rows) {
+      tile_rows_ = (tile_rows == 0 || tile_rows > extents_[0]) ? extents_[0] : tile_rows;
+      if (tile_rows_ == 0) BTAS_EXCEPTION("The connecting mode of the DF tensor is empty");
+    }
+  };
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_DF_TILES_H
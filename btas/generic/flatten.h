@@ -1,17 +1,151 @@
 #ifndef BTAS_FLATTEN_H
 #define BTAS_FLATTEN_H
 
+#include <btas/generic/task_pool.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 namespace btas {
 
+namespace detail {
+
+/// Copies the elements of an order-N tensor between two strided layouts,
+/// \f$ dst(\sum_m i_m d_m) = src(\sum_m i_m s_m) \f$. The loops over the mode
+/// with unit source stride and the mode with unit destination stride are
+/// tiled so both sides are read and written in cache sized blocks, if they
+/// are the same mode the elements are copied in contiguous runs. The remaining
+/// modes are walked with an odometer, which is split over \c nthreads workers.
+
+/// \param[in] src The elements to copy
+/// \param[in] src_strides The stride of each mode in \c src
+/// \param[out] dst Storage for the permuted elements
+/// \param[in] dst_strides The stride of each mode in \c dst
+/// \param[in] dims The extent of each mode
+/// \param[in] nthreads Number of threads. Default = 1.
+template <typename T, typename ord_t>
+void strided_copy(const T *src, const std::vector<ord_t> &src_strides, T *dst, const std::vector<ord_t> &dst_strides,
+                  const std::vector<ord_t> &dims, size_t nthreads = 1) {
+  size_t ndim = dims.size();
+  ord_t size = std::accumulate(dims.begin(), dims.end(), ord_t(1), std::multiplies<ord_t>());
+  if (size == 0) return;
+
+  // The fastest mode of the source and of the destination
+  size_t a = ndim, b = ndim;
+  for (size_t m = 0; m < ndim; ++m) {
+    if (dims[m] == 1) continue;
+    if (a == ndim || src_strides[m] < src_strides[a]) a = m;
+    if (b == ndim || dst_strides[m] < dst_strides[b]) b = m;
+  }
+  if (a == ndim) {
+    *dst = *src;
+    return;
+  }
+
+  // Modes walked by the odometer
+  std::vector<size_t> outer;
+  ord_t outer_size = 1;
+  for (size_t m = 0; m < ndim; ++m) {
+    if (m == a || m == b || dims[m] == 1) continue;
+    outer.push_back(m);
+    outer_size *= dims[m];
+  }
+
+  const ord_t block = 32;
+  ord_t na = dims[a], nb = (a == b) ? 1 : dims[b];
+  ord_t sa = src_strides[a], da = dst_strides[a];
+  ord_t sb = (a == b) ? 0 : src_strides[b], db = (a == b) ? 0 : dst_strides[b];
+
+  // Copies the (a, b) planes of the odometer positions [first, last)
+  auto task = [&](size_t t, size_t) {
+    ord_t chunk = (outer_size + nthreads - 1) / nthreads;
+    ord_t first = t * chunk, last = std::min(outer_size, first + chunk);
+    if (first >= last) return;
+    std::vector<ord_t> idx(outer.size());
+    ord_t src_off = 0, dst_off = 0, rem = first;
+    for (size_t k = outer.size(); k > 0; --k) {
+      auto m = outer[k - 1];
+      idx[k - 1] = rem % dims[m];
+      rem /= dims[m];
+      src_off += idx[k - 1] * src_strides[m];
+      dst_off += idx[k - 1] * dst_strides[m];
+    }
+    for (ord_t pos = first; pos < last; ++pos) {
+      const T *s = src + src_off;
+      T *d = dst + dst_off;
+      if (a == b && sa == 1 && da == 1) {
+        std::copy(s, s + na, d);
+      } else {
+        for (ord_t ib0 = 0; ib0 < nb; ib0 += block) {
+          ord_t ib1 = std::min(nb, ib0 + block);
+          for (ord_t ia0 = 0; ia0 < na; ia0 += block) {
+            ord_t ia1 = std::min(na, ia0 + block);
+            for (ord_t ib = ib0; ib < ib1; ++ib) {
+              const T *s_row = s + ib * sb;
+              T *d_row = d + ib * db;
+              for (ord_t ia = ia0; ia < ia1; ++ia) d_row[ia * da] = s_row[ia * sa];
+            }
+          }
+        }
+      }
+      // Advance the odometer
+      for (size_t k = outer.size(); k > 0; --k) {
+        auto m = outer[k - 1];
+        src_off += src_strides[m];
+        dst_off += dst_strides[m];
+        if (++idx[k - 1] < dims[m]) break;
+        src_off -= dims[m] * src_strides[m];
+        dst_off -= dims[m] * dst_strides[m];
+        idx[k - 1] = 0;
+      }
+    }
+  };
+
+  nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, outer_size));
+  if (nthreads == 1) {
+    task(0, 0);
+  } else {
+    std::vector<size_t> order(nthreads);
+    std::iota(order.begin(), order.end(), 0);
+    run_tasks(order, nthreads, task);
+  }
+}
+
+/// The strides of an order-N row-major tensor with extents \c dims and of
+/// its mode-\c mode matricization, following Kolda and Bader: the row is
+/// \f$ i_{mode} \f$ and the column index runs over the other modes with the
+/// first mode fastest.
+template <typename ord_t>
+void matricization_strides(const std::vector<ord_t> &dims, size_t mode, std::vector<ord_t> &tensor_strides,
+                           std::vector<ord_t> &matrix_strides) {
+  size_t ndim = dims.size();
+  tensor_strides.assign(ndim, 1);
+  matrix_strides.assign(ndim, 1);
+  for (size_t m = ndim - 1; m > 0; --m) tensor_strides[m - 1] = tensor_strides[m] * dims[m];
+  ord_t J = 1;
+  for (size_t m = 0; m < ndim; ++m) {
+    if (m == mode) continue;
+    matrix_strides[m] = J;
+    J *= dims[m];
+  }
+  matrix_strides[mode] = J;
+}
+
+} // namespace detail
+
 /// methods to produce to matricize an order-N tensor along the n-th fiber
+/// following the formula for flattening layed out by Kolda and Bader
+/// <a href=http://epubs.siam.org/doi/pdf/10.1137/07070111X> See reference. </a>
 /// \param[in] A The order-N tensor one wishes to flatten.
 /// \param[in] mode The mode of \c A to be flattened, i.e.
 /// \f[ A(I_1, I_2, I_3, ..., I_{mode}, ..., I_N) -> A(I_{mode}, J)\f]
 /// where \f$J = I_1 * I_2 * ...I_{mode-1} * I_{mode+1} * ... * I_N.\f$
+/// \param[in] nthreads Number of threads of the copy. Default = 1.
 /// \return Matrix with dimension \f$(I_{mode}, J)\f$
 
 template<typename Tensor>
-Tensor flatten(const Tensor &A, size_t mode) {
+Tensor flatten(const Tensor &A, size_t mode, size_t nthreads = 1) {
   using ord_t = typename range_traits<typename Tensor::range_type>::ordinal_type;
 
   if (mode >= A.rank()) BTAS_EXCEPTION("Cannot flatten along mode outside of A.rank()");
@@ -19,76 +153,37 @@ Tensor flatten(const Tensor &A, size_t mode) {
   // make X the correct size
   Tensor X(A.extent(mode), A.range().area() / A.extent(mode));
 
-  ord_t indexi = 0, indexj = 0;
-  size_t ndim = A.rank();
-  // J is the new step size found by removing the mode of interest
-  std::vector<ord_t> J(ndim, 1);
-  for (size_t i = 0; i < ndim; ++i)
-    if (i != mode)
-      for (size_t m = 0; m < i; ++m)
-        if (m != mode)
-          J[i] *= A.extent(m);
-
-  auto tensor_itr = A.begin();
-
-  // Fill X with the correct values
-  fill(A, 0, X, mode, indexi, indexj, J, tensor_itr);
+  std::vector<ord_t> dims, tensor_strides, matrix_strides;
+  for (size_t i = 0; i < A.rank(); ++i) dims.push_back(A.extent(i));
+  detail::matricization_strides(dims, mode, tensor_strides, matrix_strides);
+  detail::strided_copy(A.data(), tensor_strides, X.data(), matrix_strides, dims, nthreads);
 
   // return the flattened matrix
   return X;
 }
 
-/// following the formula for flattening layed out by Kolda and Bader
-/// <a href=http://epubs.siam.org/doi/pdf/10.1137/07070111X> See reference. </a>
-/// Recursive method utilized by flatten.\n **Important** if you want to flatten a tensor
-/// call flatten, not fill.
-
-/// \param[in] A  The reference tensor to be flattened
-/// \param[in] depth The recursion depth. Should not exceed the A.rank()
-/// \param[in, out] X In: An empty matrix to be filled with correct
-/// elements of \c A flattened on the \c mode fiber. Should be size \f$ (I_{mode}, J)\f$
-/// Out: The flattened A matrix along the \c mode fiber \param[in]
-/// mode The mode which A is to be flattened. \param[in] indexi The row index of
-/// matrix X \param[in] indexj The column index of matrix X \param[in] J The
-/// step size for the row dimension of X \param[in] tensor_itr An iterator of \c A.
-/// The value of the iterator is placed in the correct position of X using
-/// recursive calls of fill().
-
-  template<typename Tensor, typename iterator, typename ord_t>
-  void fill(const Tensor &A, size_t depth, Tensor &X, size_t mode,
-            ord_t indexi, ord_t indexj, const std::vector<ord_t> &J, iterator &tensor_itr) {
-    using ind_t = typename Tensor::range_type::index_type::value_type;
-    size_t ndim = A.rank();
-    if (depth < ndim) {
-
-      // Creates a for loop based on the number of modes A has
-      for (ind_t i = 0; i < A.extent(depth); ++i) {
-
-        // use the for loop to find the column dimension index
-        if (depth != mode) {
-          indexj += i * J[depth]; // column matrix index
-        }
+/// Inverse of flatten(), folds the mode-\c mode matricization \c X back into
+/// an order-N tensor.
+/// \param[in] X Matrix with dimension \f$(I_{mode}, J)\f$ as produced by flatten()
+/// \param[in] mode The mode of the tensor which indexes the rows of \c X
+/// \param[in] range The range of the order-N tensor
+/// \param[in] nthreads Number of threads of the copy. Default = 1.
+/// \return The order-N tensor with range \c range
 
-          // if this depth is the mode being flattened use the for loop to find the
-          // row dimension
-        else {
-          indexi = i; // row matrix index
-      }
+template<typename Tensor>
+Tensor fold(const Tensor &X, size_t mode, const typename Tensor::range_type &range, size_t nthreads = 1) {
+  using ord_t = typename range_traits<typename Tensor::range_type>::ordinal_type;
 
-      fill(A, depth + 1, X, mode, indexi, indexj, J, tensor_itr);
+  Tensor A(range);
+  if (mode >= A.rank()) BTAS_EXCEPTION("Cannot fold along mode outside of range.rank()");
+  if (X.rank() != 2 || X.extent(0) != A.extent(mode) || X.size() != A.size())
+    BTAS_EXCEPTION("The matrix does not match the mode of the range");
 
-      // remove the indexing from earlier in this loop.
-      if (depth != mode)
-        indexj -= i * J[depth];
-    }
-  }
-  
-  // When depth steps out of the number of dimensions, set X to be the correct
-  // value from the iterator then increment the iterator.
-  else {
-    X(indexi, indexj) = *tensor_itr;
-    tensor_itr++;
-  }
+  std::vector<ord_t> dims, tensor_strides, matrix_strides;
+  for (size_t i = 0; i < A.rank(); ++i) dims.push_back(A.extent(i));
+  detail::matricization_strides(dims, mode, tensor_strides, matrix_strides);
+  detail::strided_copy(X.data(), matrix_strides, A.data(), tensor_strides, dims, nthreads);
+  return A;
 }
 
 } // namespace btas
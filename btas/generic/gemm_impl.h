@@ -475,8 +475,10 @@ void gemm (
    static_assert(std::is_same<typename __traits_C::iterator_category, std::random_access_iterator_tag>::value,
                  "iterator C must be a random access iterator");
 
-   typename __traits_A::pointer A = &(*itrA);
-   typename __traits_B::pointer B = &(*itrB);
+   // A and B are read only, as const pointers they select the BLAS overloads
+   // of gemm_impl also when the iterators are mutable
+   const value_type* A = &(*itrA);
+   const value_type* B = &(*itrB);
    typename __traits_C::pointer C = &(*itrC);
    gemm_impl<std::is_convertible<_T, value_type>::value>::call(order, transA, transB, Msize, Nsize, Ksize, alpha, A, LDA, B, LDB, beta, C, LDC);
 
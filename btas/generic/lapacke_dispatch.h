@@ -0,0 +1,208 @@
+#ifndef BTAS_GENERIC_LAPACKE_DISPATCH_H
+#define BTAS_GENERIC_LAPACKE_DISPATCH_H
+
+#include <btas/types.h>
+
+#include <complex>
+
+#ifdef BTAS_HAS_INTEL_MKL
+#include <mkl_trans.h>
+#endif
+
+namespace btas {
+  namespace detail {
+
+#ifdef BTAS_HAS_LAPACKE
+    // Overloads of the LAPACKE drivers used by the decompositions which
+    // select the single, double or complex routine from the pointer type,
+    // in the manner of gesvd_impl. For complex matrices the symmetric
+    // drivers (syev, syevd, sytrf, sytrs) map to their Hermitian
+    // counterparts (heev, heevd, hetrf, hetrs) and orgqr to ungqr; the
+    // eigenvalues of heev/heevd are real.
+
+    inline lapack_int getrf(int layout, lapack_int m, lapack_int n, float *a, lapack_int lda, lapack_int *ipiv) {
+      return LAPACKE_sgetrf(layout, m, n, a, lda, ipiv);
+    }
+    inline lapack_int getrf(int layout, lapack_int m, lapack_int n, double *a, lapack_int lda, lapack_int *ipiv) {
+      return LAPACKE_dgetrf(layout, m, n, a, lda, ipiv);
+    }
+
+    inline lapack_int getrf(int layout, lapack_int m, lapack_int n, std::complex<float> *a, lapack_int lda,
+                            lapack_int *ipiv) {
+      return LAPACKE_cgetrf(layout, m, n, to_lapack_cptr(a), lda, ipiv);
+    }
+    inline lapack_int getrf(int layout, lapack_int m, lapack_int n, std::complex<double> *a, lapack_int lda,
+                            lapack_int *ipiv) {
+      return LAPACKE_zgetrf(layout, m, n, to_lapack_zptr(a), lda, ipiv);
+    }
+
+    inline lapack_int getri(int layout, lapack_int n, float *a, lapack_int lda, const lapack_int *ipiv) {
+      return LAPACKE_sgetri(layout, n, a, lda, ipiv);
+    }
+    inline lapack_int getri(int layout, lapack_int n, double *a, lapack_int lda, const lapack_int *ipiv) {
+      return LAPACKE_dgetri(layout, n, a, lda, ipiv);
+    }
+
+    inline lapack_int getri(int layout, lapack_int n, std::complex<float> *a, lapack_int lda,
+                            const lapack_int *ipiv) {
+      return LAPACKE_cgetri(layout, n, to_lapack_cptr(a), lda, ipiv);
+    }
+    inline lapack_int getri(int layout, lapack_int n, std::complex<double> *a, lapack_int lda,
+                            const lapack_int *ipiv) {
+      return LAPACKE_zgetri(layout, n, to_lapack_zptr(a), lda, ipiv);
+    }
+
+    inline lapack_int geqrf(int layout, lapack_int m, lapack_int n, float *a, lapack_int lda, float *tau) {
+      return LAPACKE_sgeqrf(layout, m, n, a, lda, tau);
+    }
+    inline lapack_int geqrf(int layout, lapack_int m, lapack_int n, double *a, lapack_int lda, double *tau) {
+      return LAPACKE_dgeqrf(layout, m, n, a, lda, tau);
+    }
+
+    inline lapack_int geqrf(int layout, lapack_int m, lapack_int n, std::complex<float> *a, lapack_int lda,
+                            std::complex<float> *tau) {
+      return LAPACKE_cgeqrf(layout, m, n, to_lapack_cptr(a), lda, to_lapack_cptr(tau));
+    }
+    inline lapack_int geqrf(int layout, lapack_int m, lapack_int n, std::complex<double> *a, lapack_int lda,
+                            std::complex<double> *tau) {
+      return LAPACKE_zgeqrf(layout, m, n, to_lapack_zptr(a), lda, to_lapack_zptr(tau));
+    }
+
+    inline lapack_int orgqr(int layout, lapack_int m, lapack_int n, lapack_int k, float *a, lapack_int lda,
+                            const float *tau) {
+      return LAPACKE_sorgqr(layout, m, n, k, a, lda, tau);
+    }
+    inline lapack_int orgqr(int layout, lapack_int m, lapack_int n, lapack_int k, double *a, lapack_int lda,
+                            const double *tau) {
+      return LAPACKE_dorgqr(layout, m, n, k, a, lda, tau);
+    }
+
+    inline lapack_int orgqr(int layout, lapack_int m, lapack_int n, lapack_int k, std::complex<float> *a,
+                            lapack_int lda, const std::complex<float> *tau) {
+      return LAPACKE_cungqr(layout, m, n, k, to_lapack_cptr(a), lda, to_lapack_cptr(tau));
+    }
+    inline lapack_int orgqr(int layout, lapack_int m, lapack_int n, lapack_int k, std::complex<double> *a,
+                            lapack_int lda, const std::complex<double> *tau) {
+      return LAPACKE_zungqr(layout, m, n, k, to_lapack_zptr(a), lda, to_lapack_zptr(tau));
+    }
+
+    inline lapack_int syev(int layout, char jobz, char uplo, lapack_int n, float *a, lapack_int lda, float *w) {
+      return LAPACKE_ssyev(layout, jobz, uplo, n, a, lda, w);
+    }
+    inline lapack_int syev(int layout, char jobz, char uplo, lapack_int n, double *a, lapack_int lda, double *w) {
+      return LAPACKE_dsyev(layout, jobz, uplo, n, a, lda, w);
+    }
+
+    inline lapack_int syev(int layout, char jobz, char uplo, lapack_int n, std::complex<float> *a, lapack_int lda,
+                           float *w) {
+      return LAPACKE_cheev(layout, jobz, uplo, n, to_lapack_cptr(a), lda, w);
+    }
+    inline lapack_int syev(int layout, char jobz, char uplo, lapack_int n, std::complex<double> *a, lapack_int lda,
+                           double *w) {
+      return LAPACKE_zheev(layout, jobz, uplo, n, to_lapack_zptr(a), lda, w);
+    }
+
+    inline lapack_int syevd(int layout, char jobz, char uplo, lapack_int n, float *a, lapack_int lda, float *w) {
+      return LAPACKE_ssyevd(layout, jobz, uplo, n, a, lda, w);
+    }
+    inline lapack_int syevd(int layout, char jobz, char uplo, lapack_int n, double *a, lapack_int lda, double *w) {
+      return LAPACKE_dsyevd(layout, jobz, uplo, n, a, lda, w);
+    }
+
+    inline lapack_int syevd(int layout, char jobz, char uplo, lapack_int n, std::complex<float> *a, lapack_int lda,
+                            float *w) {
+      return LAPACKE_cheevd(layout, jobz, uplo, n, to_lapack_cptr(a), lda, w);
+    }
+    inline lapack_int syevd(int layout, char jobz, char uplo, lapack_int n, std::complex<double> *a, lapack_int lda,
+                            double *w) {
+      return LAPACKE_zheevd(layout, jobz, uplo, n, to_lapack_zptr(a), lda, w);
+    }
+
+    inline lapack_int potrf(int layout, char uplo, lapack_int n, float *a, lapack_int lda) {
+      return LAPACKE_spotrf(layout, uplo, n, a, lda);
+    }
+    inline lapack_int potrf(int layout, char uplo, lapack_int n, double *a, lapack_int lda) {
+      return LAPACKE_dpotrf(layout, uplo, n, a, lda);
+    }
+
+    inline lapack_int potrf(int layout, char uplo, lapack_int n, std::complex<float> *a, lapack_int lda) {
+      return LAPACKE_cpotrf(layout, uplo, n, to_lapack_cptr(a), lda);
+    }
+    inline lapack_int potrf(int layout, char uplo, lapack_int n, std::complex<double> *a, lapack_int lda) {
+      return LAPACKE_zpotrf(layout, uplo, n, to_lapack_zptr(a), lda);
+    }
+
+    inline lapack_int potrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const float *a, lapack_int lda,
+                            float *b, lapack_int ldb) {
+      return LAPACKE_spotrs(layout, uplo, n, nrhs, a, lda, b, ldb);
+    }
+    inline lapack_int potrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const double *a, lapack_int lda,
+                            double *b, lapack_int ldb) {
+      return LAPACKE_dpotrs(layout, uplo, n, nrhs, a, lda, b, ldb);
+    }
+
+    inline lapack_int potrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const std::complex<float> *a,
+                            lapack_int lda, std::complex<float> *b, lapack_int ldb) {
+      return LAPACKE_cpotrs(layout, uplo, n, nrhs, to_lapack_cptr(a), lda, to_lapack_cptr(b), ldb);
+    }
+    inline lapack_int potrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const std::complex<double> *a,
+                            lapack_int lda, std::complex<double> *b, lapack_int ldb) {
+      return LAPACKE_zpotrs(layout, uplo, n, nrhs, to_lapack_zptr(a), lda, to_lapack_zptr(b), ldb);
+    }
+
+    inline lapack_int sytrf(int layout, char uplo, lapack_int n, float *a, lapack_int lda, lapack_int *ipiv) {
+      return LAPACKE_ssytrf(layout, uplo, n, a, lda, ipiv);
+    }
+    inline lapack_int sytrf(int layout, char uplo, lapack_int n, double *a, lapack_int lda, lapack_int *ipiv) {
+      return LAPACKE_dsytrf(layout, uplo, n, a, lda, ipiv);
+    }
+
+    inline lapack_int sytrf(int layout, char uplo, lapack_int n, std::complex<float> *a, lapack_int lda,
+                            lapack_int *ipiv) {
+      return LAPACKE_chetrf(layout, uplo, n, to_lapack_cptr(a), lda, ipiv);
+    }
+    inline lapack_int sytrf(int layout, char uplo, lapack_int n, std::complex<double> *a, lapack_int lda,
+                            lapack_int *ipiv) {
+      return LAPACKE_zhetrf(layout, uplo, n, to_lapack_zptr(a), lda, ipiv);
+    }
+
+    inline lapack_int sytrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const float *a, lapack_int lda,
+                            const lapack_int *ipiv, float *b, lapack_int ldb) {
+      return LAPACKE_ssytrs(layout, uplo, n, nrhs, a, lda, ipiv, b, ldb);
+    }
+    inline lapack_int sytrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const double *a, lapack_int lda,
+                            const lapack_int *ipiv, double *b, lapack_int ldb) {
+      return LAPACKE_dsytrs(layout, uplo, n, nrhs, a, lda, ipiv, b, ldb);
+    }
+    inline lapack_int sytrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const std::complex<float> *a,
+                            lapack_int lda, const lapack_int *ipiv, std::complex<float> *b, lapack_int ldb) {
+      return LAPACKE_chetrs(layout, uplo, n, nrhs, to_lapack_cptr(a), lda, ipiv, to_lapack_cptr(b), ldb);
+    }
+    inline lapack_int sytrs(int layout, char uplo, lapack_int n, lapack_int nrhs, const std::complex<double> *a,
+                            lapack_int lda, const lapack_int *ipiv, std::complex<double> *b, lapack_int ldb) {
+      return LAPACKE_zhetrs(layout, uplo, n, nrhs, to_lapack_zptr(a), lda, ipiv, to_lapack_zptr(b), ldb);
+    }
+#endif  // BTAS_HAS_LAPACKE
+
+#ifdef BTAS_HAS_INTEL_MKL
+    // In-place transposition of a row-major rows x cols matrix
+    inline void imatcopy_transpose(size_t rows, size_t cols, float *a) {
+      mkl_simatcopy('R', 'T', rows, cols, 1.0f, a, cols, rows);
+    }
+    inline void imatcopy_transpose(size_t rows, size_t cols, double *a) {
+      mkl_dimatcopy('R', 'T', rows, cols, 1.0, a, cols, rows);
+    }
+    inline void imatcopy_transpose(size_t rows, size_t cols, std::complex<float> *a) {
+      MKL_Complex8 one = {1.0f, 0.0f};
+      mkl_cimatcopy('R', 'T', rows, cols, one, reinterpret_cast<MKL_Complex8 *>(a), cols, rows);
+    }
+    inline void imatcopy_transpose(size_t rows, size_t cols, std::complex<double> *a) {
+      MKL_Complex16 one = {1.0, 0.0};
+      mkl_zimatcopy('R', 'T', rows, cols, one, reinterpret_cast<MKL_Complex16 *>(a), cols, rows);
+    }
+#endif  // BTAS_HAS_INTEL_MKL
+
+  }  // namespace detail
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_LAPACKE_DISPATCH_H
@@ -5,6 +5,13 @@
 #ifndef BTAS_LINEAR_ALGEBRA_H
 #define BTAS_LINEAR_ALGEBRA_H
 #include <btas/error.h>
+#include <btas/generic/lapacke_dispatch.h>
+#include <btas/generic/numeric_type.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 
 namespace btas{
 /// Computes L of the LU decomposition of tensor \c A
@@ -32,13 +39,13 @@ namespace btas{
     // LAPACKE LU decomposition gives back dense L and U to be
     // restored into lower and upper triangular form, and a pivoting
     // matrix for L
-    auto info = LAPACKE_dgetrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
+    auto info = detail::getrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
                                A.data(), A.extent(1), piv.data());
 
     // This means there was a problem with the LU that must be dealt with,
     // The decomposition cannot be continued.
     if (info < 0) {
-      BTAS_EXCEPTION("LU_decomp: LAPACKE_dgetrf received an invalid input parameter");
+      BTAS_EXCEPTION("LU_decomp: getrf received an invalid input parameter");
     }
 
     // This means that part of the LU is singular which may cause a problem in
@@ -116,12 +123,12 @@ namespace btas{
 
     // LAPACKE doesn't directly calculate Q. Must first call this function to
     // generate precursors to Q
-    auto info = LAPACKE_dgeqrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
+    auto info = detail::geqrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
                                A.data(), A.extent(1), B.data());
 
     if (info == 0) {
       // This function generates Q.
-      info = LAPACKE_dorgqr(LAPACK_ROW_MAJOR, Qm, Qn, Qn, A.data(), A.extent(1),
+      info = detail::orgqr(LAPACK_ROW_MAJOR, Qm, Qn, Qn, A.data(), A.extent(1),
                             B.data());
 
       // If there was some problem generating Q, i.e. it is singular, the
@@ -158,13 +165,13 @@ namespace btas{
     // LAPACKE LU decomposition gives back dense L and U to be
     // restored into lower and upper triangular form, and a pivoting
     // matrix for L
-    auto info = LAPACKE_dgetrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
+    auto info = detail::getrf(LAPACK_ROW_MAJOR, A.extent(0), A.extent(1),
                                A.data(), A.extent(1), piv.data());
     if(info != 0){
       A = Tensor();
       return false;
     }
-    info = LAPACKE_dgetri(CblasRowMajor, A.extent(0), A.data(), A.extent(0), piv.data());
+    info = detail::getri(CblasRowMajor, A.extent(0), A.data(), A.extent(0), piv.data());
     if(info != 0){
       A = Tensor();
       return false;
@@ -196,44 +203,205 @@ namespace btas{
       BTAS_EXCEPTION("Volume of lambda must be greater than or equal to the largest mode of A");
     }
 
-    auto info = LAPACKE_dsyev(LAPACK_COL_MAJOR, 'V', 'U', smallest_mode_A,
-                              A.data(), smallest_mode_A, lambda.data());
+    // the eigenvalues are real, also for a complex Hermitian A
+    std::vector<typename impl::real_type<typename Tensor::value_type>::type> w(smallest_mode_A);
+    auto info = detail::syev(LAPACK_COL_MAJOR, 'V', 'U', smallest_mode_A,
+                              A.data(), smallest_mode_A, w.data());
     if (info) BTAS_EXCEPTION("Error in computing the SVD initial guess");
+    std::copy(w.begin(), w.end(), lambda.begin());
 #endif // BTAS_HAS_LAPACKE
   }
 
-  /// Solving Ax = B using a Cholesky decomposition
-  /// \param[in, out] A In: The right-hand side of the linear equation
-  /// to be inverted using Cholesky. Out:
-  /// the factors L and U from the factorization A = P*L*U;
-  /// the unit diagonal elements of L are not stored.
-  /// \param[in, out] B In: The left-hand side of the linear equation
-  /// out: The solution x = A^{-1}B
-  /// \return bool true if inversion was successful false if failed.
+namespace detail {
+  // true if the smallest magnitude in pivots is above tol times the largest
+  inline bool pivots_resolved(const std::vector<double> & pivots, double tol) {
+    double max_p = 0.0, min_p = std::numeric_limits<double>::max();
+    for (auto p : pivots) {
+      max_p = std::max(max_p, p);
+      min_p = std::min(min_p, p);
+    }
+    return min_p > tol * max_p;
+  }
+
+  // Default relative tolerance of the symmetric solvers, 500 machine epsilons
+  // of the real type of the matrix (about 1e-13 in double precision)
+  template <typename Tensor>
+  double default_solve_tol() {
+    using real_type = typename impl::real_type<typename Tensor::value_type>::type;
+    return 500.0 * std::numeric_limits<real_type>::epsilon();
+  }
+}  // namespace detail
+
+  /// Solving \f$ A X^T = B^T \f$ using a Cholesky decomposition
+  /// \param[in, out] A In: The symmetric positive definite matrix
+  /// of the linear equation. Out: the Cholesky factor U of A = U^T U
+  /// (only the upper triangle is referenced).
+  /// \param[in, out] B In: The right-hand side of the linear equation
+  /// stored as \f$ B^T \f$ out: The solution \f$ X = B A^{-1} \f$.
+  /// \param[in] tol The factorization is rejected if a pivot \f$ U_{ii}^2 \f$
+  /// is below \c tol times the largest one. Default = 0, only a failed
+  /// factorization is rejected.
+  /// \return bool true if \c A was positive definite and the solve
+  /// was successful, false if failed. On failure \c B is not modified.
 template <typename Tensor>
-bool cholesky_inverse(Tensor & A, Tensor & B) {
+bool cholesky_inverse(Tensor & A, Tensor & B, double tol = 0.0) {
 #ifndef BTAS_HAS_LAPACKE
     BTAS_EXCEPTION("Cholesky inverse function requires LAPACKE");
 #else //BTAS_HAS_LAPACKE
     using ind_t = typename Tensor::range_type::index_type::value_type;
-    // This method computes the inverse quickly for a square matrix
-    // based on MATLAB's implementation of A / B operator.
+    ind_t rank = B.extent(1);
+    ind_t LDB = B.extent(0);
+
+    // A is symmetric so the row-major B is the column-major B^T
+    auto info = detail::potrf(LAPACK_COL_MAJOR, 'U', rank, A.data(), rank);
+    if (info != 0) return false;
+    std::vector<double> pivots(rank);
+    for (ind_t i = 0; i < rank; ++i) pivots[i] = std::norm(A.data()[i * (rank + 1)]);
+    if (!detail::pivots_resolved(pivots, tol)) return false;
+    info = detail::potrs(LAPACK_COL_MAJOR, 'U', rank, LDB, A.data(), rank, B.data(), rank);
+    return (info == 0);
+#endif //BTAS_HAS_LAPACKE
+}
+
+  /// Solving \f$ A X^T = B^T \f$ for a symmetric (possibly indefinite)
+  /// \c A using the Bunch-Kaufman \f$ LDL^T \f$ decomposition
+  /// \param[in, out] A In: The symmetric matrix of the linear equation.
+  /// Out: the block diagonal D and the multipliers of the factorization.
+  /// \param[in, out] B In: The right-hand side of the linear equation
+  /// stored as \f$ B^T \f$ out: The solution \f$ X = B A^{-1} \f$.
+  /// \param[in] tol The factorization is rejected if an eigenvalue of a
+  /// pivot block of D is below \c tol times the largest in magnitude.
+  /// Default = 0, only an exactly singular D is rejected.
+  /// \return bool true if \c A was nonsingular and the solve was successful,
+  /// false if failed. On failure \c B is not modified.
+template <typename Tensor>
+bool ldlt_inverse(Tensor & A, Tensor & B, double tol = 0.0) {
+#ifndef BTAS_HAS_LAPACKE
+    BTAS_EXCEPTION("LDLT inverse function requires LAPACKE");
+#else //BTAS_HAS_LAPACKE
+    using ind_t = typename Tensor::range_type::index_type::value_type;
     ind_t rank = B.extent(1);
     ind_t LDB = B.extent(0);
 
     btas::Tensor<lapack_int, DEFAULT::range, varray <lapack_int> > piv(rank);
     piv.fill(0);
-    auto info = LAPACKE_dgesv(CblasColMajor, rank, LDB, A.data(), rank, piv.data(), B.data(), rank);
-    if (info == 0) {
-      return true;
-    } else {
-      // If inverse fails resort to the pseudoinverse
-      std::cout << "Matlab square inverse failed revert to fast inverse" << std::endl;
-      return false;
+    auto info = detail::sytrf(LAPACK_COL_MAJOR, 'U', rank, A.data(), rank, piv.data());
+    if (info != 0) return false;
+
+    // D has 1x1 blocks and, where piv is negative, 2x2 blocks whose
+    // eigenvalues are taken as the pivots
+    std::vector<double> pivots;
+    auto d = [&](ind_t i, ind_t j) { return A.data()[i + j * rank]; };
+    for (ind_t i = 0; i < rank; ++i) {
+      if (piv(i) > 0 || i + 1 == rank) {
+        pivots.push_back(std::abs(d(i, i)));
+      } else {
+        double a = std::real(d(i, i)), c = std::real(d(i + 1, i + 1));
+        double mean = 0.5 * (a + c), radius = std::sqrt(0.25 * (a - c) * (a - c) + std::norm(d(i, i + 1)));
+        pivots.push_back(std::abs(mean + radius));
+        pivots.push_back(std::abs(mean - radius));
+        ++i;
+      }
     }
+    if (!detail::pivots_resolved(pivots, tol)) return false;
+    info = detail::sytrs(LAPACK_COL_MAJOR, 'U', rank, LDB, A.data(), rank, piv.data(), B.data(), rank);
+    return (info == 0);
 #endif //BTAS_HAS_LAPACKE
 }
 
+  /// Solving \f$ A X^T = B^T \f$ for a symmetric \c A with the pseudo-inverse
+  /// built from the eigenvalue decomposition of \c A (divide and conquer).
+  /// Eigenvalues with magnitude below \c tol times the largest magnitude are
+  /// treated as zero.
+  /// \param[in, out] A In: The symmetric matrix of the linear equation.
+  /// Out: The eigenvectors of \c A.
+  /// \param[in, out] B In: The right-hand side of the linear equation
+  /// stored as \f$ B^T \f$ out: The solution \f$ X = B A^{\dagger} \f$.
+  /// \param[in] tol Relative threshold for discarding small eigenvalues.
+  /// Default = -1, 500 machine epsilons of the real type of \c A.
+template <typename Tensor>
+void eigen_pseudoinverse(Tensor & A, Tensor & B, double tol = -1.0) {
+#ifndef BTAS_HAS_LAPACKE
+    BTAS_EXCEPTION("Eigenvalue pseudo-inverse function requires LAPACKE");
+#else //BTAS_HAS_LAPACKE
+    if (tol < 0) tol = detail::default_solve_tol<Tensor>();
+    using ind_t = typename Tensor::range_type::index_type::value_type;
+    ind_t rank = B.extent(1);
+    ind_t LDB = B.extent(0);
+
+    using value_type = typename Tensor::value_type;
+    std::vector<typename impl::real_type<value_type>::type> w(rank);
+    auto info = detail::syevd(LAPACK_COL_MAJOR, 'V', 'U', rank, A.data(), rank, w.data());
+    if (info != 0) BTAS_EXCEPTION("eigen_pseudoinverse: syevd failed to converge");
+
+    // Stored column-major, so row i of the row-major A is the i-th eigenvector
+    double max_w = 0.0;
+    for (ind_t i = 0; i < rank; ++i) max_w = std::max(max_w, (double) std::abs(w[i]));
+    double cutoff = tol * max_w;
+
+    // X = B conj(Q) diag(w)^{\dagger} Q^T
+    Tensor BQ(LDB, rank);
+    gemm(CblasNoTrans, impl::adjoint_trans<value_type>(), 1.0, B, A, 0.0, BQ);
+    for (ind_t i = 0; i < rank; ++i) {
+      auto inv = (std::abs(w[i]) > cutoff ? 1.0 / w[i] : 0.0);
+      auto *ptr = BQ.data() + i;
+      for (ind_t j = 0; j < LDB; ++j, ptr += rank) *ptr *= inv;
+    }
+    gemm(CblasNoTrans, CblasNoTrans, 1.0, BQ, A, 0.0, B);
+#endif //BTAS_HAS_LAPACKE
+}
+
+  /// Tallies which factorization \c spd_solve used to solve each system
+  struct SPDSolveCounter {
+    size_t cholesky = 0;      // Solved with potrf/potrs
+    size_t ldlt = 0;          // Cholesky failed, solved with sytrf/sytrs
+    size_t eigen = 0;         // Both failed, solved with the syevd pseudo-inverse
+    size_t svd = 0;           // Solved with the SVD pseudo-inverse (not through spd_solve)
+    size_t fast_pinv = 0;     // Solved with the Cholesky based fast pseudo-inverse (not through spd_solve)
+
+    void reset() { cholesky = ldlt = eigen = svd = fast_pinv = 0; }
+
+    SPDSolveCounter & operator+=(const SPDSolveCounter & other) {
+      cholesky += other.cholesky; ldlt += other.ldlt; eigen += other.eigen; svd += other.svd;
+      fast_pinv += other.fast_pinv;
+      return *this;
+    }
+  };
+
+  /// Solving \f$ A X^T = B^T \f$ for the symmetric positive semi-definite
+  /// normal equations of the ALS problem. First tries a Cholesky decomposition,
+  /// if \c A is not numerically positive definite falls back to a Bunch-Kaufman
+  /// \f$ LDL^T \f$ decomposition and, if \c A is numerically singular, to the
+  /// pseudo-inverse computed from the eigenvalue decomposition of \c A. A
+  /// factorization counts as singular when its smallest pivot is below \c tol
+  /// times its largest, so an ill-conditioned \c A reaches the pseudo-inverse
+  /// rather than an inaccurate triangular solve.
+  /// \param[in] A The symmetric matrix of the linear equation, unchanged on return.
+  /// \param[in, out] B In: The right-hand side of the linear equation
+  /// stored as \f$ B^T \f$ out: The solution \f$ X = B A^{-1} \f$.
+  /// \param[in, out] counter Incremented for the path which solved the equation.
+  /// \param[in] tol Relative threshold for the pivots of the factorizations
+  /// and for discarding small eigenvalues in the pseudo-inverse.
+  /// Default = -1, 500 machine epsilons of the real type of \c A.
+template <typename Tensor>
+void spd_solve(const Tensor & A, Tensor & B, SPDSolveCounter & counter, double tol = -1.0) {
+  if (tol < 0) tol = detail::default_solve_tol<Tensor>();
+  // The factorizations overwrite their input so work on a copy of A
+  Tensor V = A;
+  if (cholesky_inverse(V, B, tol)) {
+    ++counter.cholesky;
+    return;
+  }
+  V = A;
+  if (ldlt_inverse(V, B, tol)) {
+    ++counter.ldlt;
+    return;
+  }
+  V = A;
+  eigen_pseudoinverse(V, B, tol);
+  ++counter.eigen;
+}
+
 /// SVD referencing code from
 /// http://www.netlib.org/lapack/explore-html/de/ddd/lapacke_8h_af31b3cb47f7cc3b9f6541303a2968c9f.html
 /// Fast pseudo-inverse algorithm described in
@@ -252,38 +420,41 @@ Tensor pseudoInverse(Tensor & A, bool & fast_pI) {
       BTAS_EXCEPTION("PseudoInverse can only be computed on a matrix");
     }
 
+    using value_type = typename Tensor::value_type;
+    const auto adjoint = impl::adjoint_trans<value_type>();
     ind_t row = A.extent(0), col = A.extent(1);
     auto rank = (row < col ? row : col);
 
     if (fast_pI) {
       Tensor temp(col, col), inv(col, row);
-      // compute V^{\dag} = (A^T A) ^{-1} A^T
-      gemm(CblasTrans, CblasNoTrans, 1.0, A, A, 0.0, temp);
+      // compute V^{\dag} = (A^H A) ^{-1} A^H
+      gemm(adjoint, CblasNoTrans, 1.0, A, A, 0.0, temp);
       fast_pI = Inverse_Matrix(temp);
       if (fast_pI) {
-        gemm(CblasNoTrans, CblasTrans, 1.0, temp, A, 0.0, inv);
+        gemm(CblasNoTrans, adjoint, 1.0, temp, A, 0.0, inv);
         return inv;
       } else {
         std::cout << "Fast pseudo-inverse failed reverting to normal pseudo-inverse" << std::endl;
       }
     }
-    Tensor s(Range{Range1{rank}});
+    // the singular values are real, also for a complex A
+    btas::Tensor<typename impl::real_type<value_type>::type> sv(Range{Range1{rank}});
     Tensor U(Range{Range1{row}, Range1{row}});
     Tensor Vt(Range{Range1{col}, Range1{col}});
 
-    gesvd('A', 'A', A, s, U, Vt);
+    gesvd('A', 'A', A, sv, U, Vt);
 
     // Inverse the Singular values with threshold 1e-13 = 0
     double lr_thresh = 1e-13;
     Tensor s_inv(Range{Range1{row}, Range1{col}});
     s_inv.fill(0.0);
     for (ind_t i = 0; i < rank; ++i) {
-      if (s(i) > lr_thresh)
-        s_inv(i, i) = 1 / s(i);
+      if (sv(i) > lr_thresh)
+        s_inv(i, i) = 1 / sv(i);
       else
-        s_inv(i, i) = s(i);
+        s_inv(i, i) = sv(i);
     }
-    s.resize(Range{Range1{row}, Range1{col}});
+    Tensor s(Range{Range1{row}, Range1{col}});
 
     // Compute the matrix A^-1 from the inverted singular values and the U and
     // V^T provided by the SVD
@@ -0,0 +1,101 @@
+#ifndef BTAS_GENERIC_MODE_GRAM_H
+#define BTAS_GENERIC_MODE_GRAM_H
+
+#include <btas/types.h>
+#include <btas/generic/numeric_type.h>
+
+#include <complex>
+#include <vector>
+
+namespace btas {
+  namespace detail {
+
+    // Upper triangle of C = beta C + A A^H (trans = CblasNoTrans, A is n x k) or
+    // C = beta C + A^H A (trans = CblasConjTrans, A is k x n), row-major.
+    // The generic version backs up the CBLAS overloads.
+    template <typename T>
+    void herk_upper(CBLAS_TRANSPOSE trans, unsigned long n, unsigned long k, const T *a, unsigned long lda,
+                    double beta, T *c, unsigned long ldc) {
+      for (unsigned long i = 0; i < n; ++i) {
+        for (unsigned long j = i; j < n; ++j) {
+          T sum(0);
+          for (unsigned long l = 0; l < k; ++l) {
+            sum += (trans == CblasNoTrans) ? a[i * lda + l] * impl::conj(a[j * lda + l])
+                                           : impl::conj(a[l * lda + i]) * a[l * lda + j];
+          }
+          c[i * ldc + j] = T(beta) * c[i * ldc + j] + sum;
+        }
+      }
+    }
+
+#ifdef BTAS_HAS_CBLAS
+    inline void herk_upper(CBLAS_TRANSPOSE trans, unsigned long n, unsigned long k, const float *a,
+                           unsigned long lda, double beta, float *c, unsigned long ldc) {
+      cblas_ssyrk(CblasRowMajor, CblasUpper, trans == CblasNoTrans ? CblasNoTrans : CblasTrans, n, k, 1.0f, a,
+                  lda, float(beta), c, ldc);
+    }
+    inline void herk_upper(CBLAS_TRANSPOSE trans, unsigned long n, unsigned long k, const double *a,
+                           unsigned long lda, double beta, double *c, unsigned long ldc) {
+      cblas_dsyrk(CblasRowMajor, CblasUpper, trans == CblasNoTrans ? CblasNoTrans : CblasTrans, n, k, 1.0, a,
+                  lda, beta, c, ldc);
+    }
+    inline void herk_upper(CBLAS_TRANSPOSE trans, unsigned long n, unsigned long k, const std::complex<float> *a,
+                           unsigned long lda, double beta, std::complex<float> *c, unsigned long ldc) {
+      cblas_cherk(CblasRowMajor, CblasUpper, trans == CblasNoTrans ? CblasNoTrans : CblasConjTrans, n, k, 1.0f,
+                  to_lapack_cptr(a), lda, float(beta), to_lapack_cptr(c), ldc);
+    }
+    inline void herk_upper(CBLAS_TRANSPOSE trans, unsigned long n, unsigned long k, const std::complex<double> *a,
+                           unsigned long lda, double beta, std::complex<double> *c, unsigned long ldc) {
+      cblas_zherk(CblasRowMajor, CblasUpper, trans == CblasNoTrans ? CblasNoTrans : CblasConjTrans, n, k, 1.0,
+                  to_lapack_zptr(a), lda, beta, to_lapack_zptr(c), ldc);
+    }
+#endif  // BTAS_HAS_CBLAS
+  }  // namespace detail
+
+  /// Computes the Gram matrix of the mode-n matricization of \c X,
+  /// \f$ G = X_{(n)} X_{(n)}^H \f$, without forming \f$ X_{(n)} \f$. The row-major
+  /// \c X is read as the contiguous \f$ I_n \times S \f$ blocks \f$ X_p \f$, one per
+  /// index \f$ p \f$ of the modes before \c mode, and \f$ G = \sum_p X_p X_p^H \f$ is
+  /// accumulated with SYRK (HERK for complex tensors), which only computes one
+  /// triangle. For the last mode the blocks are columns and \f$ G = X^T \bar{X} \f$
+  /// of the \f$ P \times I_n \f$ matrix is taken in a single call.
+
+  /// \param[in] X Order-N tensor with contiguous row-major storage.
+  /// \param[in] mode The mode whose Gram matrix is computed.
+  /// \param[out] G The Hermitian \f$ I_n \times I_n \f$ Gram matrix.
+  template <typename Tensor>
+  void mode_gram(const Tensor &X, size_t mode, Tensor &G) {
+    using ord_t = typename range_traits<typename Tensor::range_type>::ordinal_type;
+    size_t ndim = X.rank();
+    ord_t before = 1, after = 1;
+    for (size_t i = 0; i < mode; ++i) before *= X.extent(i);
+    for (size_t i = mode + 1; i < ndim; ++i) after *= X.extent(i);
+    ord_t dim = X.extent(mode);
+    G = Tensor(dim, dim);
+    G.fill(0.0);
+
+    auto *g = G.data();
+    if (after == 1) {
+      // X^H X is the conjugate of the Gram matrix
+      detail::herk_upper(CblasConjTrans, dim, before, X.data(), dim, 0.0, g, dim);
+      for (ord_t i = 0; i < dim; ++i) {
+        for (ord_t j = i + 1; j < dim; ++j) {
+          g[j * dim + i] = g[i * dim + j];
+          g[i * dim + j] = impl::conj(g[i * dim + j]);
+        }
+      }
+      return;
+    }
+
+    for (ord_t p = 0; p < before; ++p) {
+      detail::herk_upper(CblasNoTrans, dim, after, X.data() + p * dim * after, after, p ? 1.0 : 0.0, g, dim);
+    }
+    // Mirror the upper triangle
+    for (ord_t i = 0; i < dim; ++i) {
+      for (ord_t j = i + 1; j < dim; ++j) g[j * dim + i] = impl::conj(g[i * dim + j]);
+    }
+  }
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_MODE_GRAM_H
@@ -6,6 +6,8 @@
 #include <iterator>
 #include <type_traits>
 
+#include <btas/types.h>
+
 namespace btas {
 
 /// Numeric value functions
@@ -145,6 +147,19 @@ template <> struct NumericType<std::complex<double>>
 namespace impl {
     template<typename T> T conj(const T& t) { return t; }
     template<typename T> std::complex<T> conj(const std::complex<T>& t) { return std::conj(t); }
+
+    template<typename T> struct is_complex : std::false_type { };
+    template<typename T> struct is_complex<std::complex<T>> : std::true_type { };
+
+    /// The real type underlying \c T, \c T itself for real types
+    template<typename T> struct real_type { typedef T type; };
+    template<typename T> struct real_type<std::complex<T>> { typedef T type; };
+
+    /// \return The BLAS op of the adjoint for value type \c T, CblasTrans
+    /// for real types since gemm rejects CblasConjTrans for those
+    template<typename T> constexpr CBLAS_TRANSPOSE adjoint_trans() {
+      return is_complex<T>::value ? CblasConjTrans : CblasTrans;
+    }
 }
 
 }; // namespace btas
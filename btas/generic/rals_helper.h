@@ -6,6 +6,8 @@
 #define BTAS_RALS_HELPER_H
 
 #include <btas/generic/dot_impl.h>
+
+#include <complex>
 namespace btas{
 /**
     \brief A helper function for the RALS solver
@@ -40,10 +42,8 @@ namespace btas{
       auto chg_ptr = change.data();
       auto an_ptr = An.data();
       for (ord_t i = 0; i < size; ++i) {
-        auto val = *(chg_ptr + i);
-        s += val * val;
-        val = *(an_ptr + i);
-        denom += val * val;
+        s += std::norm(*(chg_ptr + i));
+        denom += std::norm(*(an_ptr + i));
       }
       s = std::sqrt(s) / std::sqrt(denom);
       //double s = std::sqrt(btas::dot(change, change));
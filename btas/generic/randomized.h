@@ -6,8 +6,13 @@
 #include <btas/tensor.h>
 #include <btas/generic/linear_algebra.h>
 #include <btas/generic/contract.h>
+#include <btas/generic/counter_rng.h>
+#include <btas/generic/default_random_seed.h>
+#include <btas/generic/tucker.h>
 
-#include <random>
+#include <algorithm>
+#include <array>
+#include <numeric>
 #include <stdlib.h>
 #include <vector>
 
@@ -16,37 +21,276 @@ namespace btas {
 /// \param[in,out] A In: An empty matrix of size column dimension of the nth
 /// mode flattened tensor provided to the randomized compression method by the
 /// desired rank of the randmoized compression method.  Out: A random matrix,
-/// column drawn from a random distribution and orthogonalized
-template <typename Tensor> void generate_random_metric(Tensor &A) {
-    using ind_t = typename Tensor::range_type::index_type::value_type;
-    using value_type = typename Tensor::value_type;
-    for (ind_t i = 0; i < A.extent(1); i++) {
-      std::random_device rd;
-      // uncomment for more randomness
-      // std::mt19937 gen(rd());
-      std::mt19937 gen(1.0); // comment out for more randomness.
-      std::normal_distribution<value_type> distribution(0.0, 10.0);
-      value_type norm = 0.0;
-      for (ind_t j = 0; j < A.extent(0); j++) {
-        auto val = abs(distribution(gen));
-        norm += val * val;
-        A(i, j) = val;
+/// drawn from a standard normal distribution and orthogonalized
+/// \param[in] stream Stream of the counter based generator seeded by
+/// random_seed_accessor(), e.g. the mode of the flattened tensor. Default = 0.
+/// \param[in] nthreads Number of threads drawing the matrix, does not change
+/// the result. Default = 1.
+template <typename Tensor> void generate_random_metric(Tensor &A, uint32_t stream = 0, size_t nthreads = 1) {
+  fill_random_normal(A, 0.0, 1.0, random_seed_accessor(), stream, nthreads);
+  QR_decomp(A);
+}
+
+/// The random matrices \f$ \Omega \f$ of the range finder \f$ Y = X_{(n)} \Omega \f$
+/// of randomized_decomposition(), \f$ J \f$ is the column dimension of
+/// \f$ X_{(n)} \f$ and \f$ r \f$ the sketch rank.
+enum class Sketch {
+  gaussian,     ///< Dense orthogonalized Gaussian matrix, \f$ O(size \cdot r) \f$
+  srht,         ///< Subsampled randomized Hadamard transform, \f$ O(size \log J) \f$
+  sparse_sign,  ///< Sparse sign embedding with 8 nonzeros per row, \f$ O(8 \, size) \f$
+  tensor_sketch ///< CountSketch with a hash built mode by mode (TensorSketch), \f$ O(size) \f$
+};
+
+namespace detail {
+
+  // The products below read the row-major tensor X as before x dim x after
+  // blocks, M = X_(n) is the dim x J matrix with column p * after + q. The
+  // order of the columns differs from flatten() but the range of M and the
+  // sketches do not depend on it, so M is never formed.
+
+  // Y = beta Y + M G, G is J x r
+  template <typename T>
+  void mode_times(const T *x, unsigned long before, unsigned long dim, unsigned long after, const T *g,
+                  unsigned long r, T *y, double beta = 0.0) {
+    if (after == 1) {
+      gemm(CblasRowMajor, CblasTrans, CblasNoTrans, dim, r, before, 1.0, x, dim, g, r, beta, y, r);
+      return;
+    }
+    for (unsigned long p = 0; p < before; ++p) {
+      gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, dim, r, after, 1.0, x + p * dim * after, after,
+           g + p * after * r, r, p ? 1.0 : beta, y, r);
+    }
+  }
+
+  // Z = M^H Y, Y is dim x r
+  template <typename T>
+  void mode_adjoint_times(const T *x, unsigned long before, unsigned long dim, unsigned long after, const T *y,
+                          unsigned long r, T *z) {
+    if (after == 1) {
+      // M^H = conj(X), computed as conj(X conj(Y))
+      std::vector<T> yc(y, y + dim * r);
+      for (auto &v : yc) v = impl::conj(v);
+      gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, before, r, dim, 1.0, x, dim, yc.data(), r, 0.0, z, r);
+      if (impl::is_complex<T>::value) {
+        for (unsigned long i = 0; i < before * r; ++i) z[i] = impl::conj(z[i]);
+      }
+      return;
+    }
+    for (unsigned long p = 0; p < before; ++p) {
+      gemm(CblasRowMajor, impl::adjoint_trans<T>(), CblasNoTrans, after, r, dim, 1.0, x + p * dim * after, after,
+           y, r, 0.0, z + p * after * r, r);
+    }
+  }
+
+  // Chooses s distinct values of [0, r) from the words w with Floyd's algorithm
+  inline void sample_distinct(const uint32_t *w, uint32_t s, uint32_t r, uint32_t *out) {
+    for (uint32_t k = 0, t = r - s; k < s; ++k, ++t) {
+      uint32_t v = w[k] % (t + 1);
+      if (std::find(out, out + k, v) != out + k) v = t;
+      out[k] = v;
+    }
+  }
+
+  // The sparse sketch kernels add M S to Y. M may be the blocks [p0, p0 + before)
+  // of a larger tensor, e.g. a slab of a streamed tensor, x points to block p0.
+
+  // Y += M S for a sparse S with s signs per row
+  template <typename T>
+  void sparse_sign_sketch(const T *x, unsigned long p0, unsigned long before, unsigned long dim,
+                          unsigned long after, uint32_t r, uint32_t stream, size_t nthreads, T *y) {
+    const uint32_t s = std::max<uint32_t>(1, std::min<uint32_t>(8, r / 2));
+    unsigned long J = before * after;
+    std::vector<uint32_t> col(J * s);
+    std::vector<unsigned char> neg(J * s);
+    CounterRNG rng(random_seed_accessor(), stream);
+    parallel_chunks(J, nthreads, [&](size_t first, size_t last) {
+      std::array<uint32_t, 12> w;
+      for (size_t j = first; j < last; ++j) {
+        for (int c = 0; c < 3; ++c) {
+          auto bits = rng(3 * (uint64_t(p0) * after + j) + c);
+          std::copy(bits.begin(), bits.end(), w.begin() + 4 * c);
+        }
+        sample_distinct(w.data(), s, r, col.data() + j * s);
+        for (uint32_t k = 0; k < s; ++k) neg[j * s + k] = (w[8] >> k) & 1;
       }
+    });
+    // The columns are walked in tiles so the tile of S stays in cache for every row
+    const unsigned long tile = 512;
+    parallel_chunks(dim, nthreads, [&](size_t first, size_t last) {
+      for (unsigned long p = 0; p < before; ++p) {
+        for (unsigned long q0 = 0; q0 < after; q0 += tile) {
+          unsigned long q1 = std::min(after, q0 + tile);
+          for (size_t i = first; i < last; ++i) {
+            const T *xi = x + (p * dim + i) * after;
+            T *yi = y + i * r;
+            for (unsigned long q = q0; q < q1; ++q) {
+              unsigned long j = (p * after + q) * s;
+              for (uint32_t k = 0; k < s; ++k) {
+                if (neg[j + k]) yi[col[j + k]] -= xi[q];
+                else yi[col[j + k]] += xi[q];
+              }
+            }
+          }
+        }
+      }
+    });
+  }
 
-      norm = sqrt(norm);
-      for (ind_t j = 0; j < A.extent(0); j++) {
-        A(j, i) /= norm;
+  // Y += M S for the CountSketch S whose column hash and sign are sums and
+  // products of independent per mode hashes. dims are the extents of the
+  // whole tensor, dim the rows of M.
+  template <typename T>
+  void tensor_sketch(const T *x, const std::vector<unsigned long> &dims, size_t mode, unsigned long p0,
+                     unsigned long before, unsigned long dim, uint32_t r, uint32_t stream, size_t nthreads, T *y) {
+    CounterRNG rng(random_seed_accessor(), stream);
+    // Hash and sign of every index of the other modes
+    std::vector<std::vector<uint32_t>> h(dims.size());
+    std::vector<std::vector<unsigned char>> neg(dims.size());
+    uint64_t offset = 0;
+    for (size_t m = 0; m < dims.size(); ++m) {
+      if (m == mode) continue;
+      for (unsigned long i = 0; i < dims[m]; ++i) {
+        auto bits = rng(offset + i);
+        h[m].push_back(bits[0] % r);
+        neg[m].push_back(bits[1] & 1);
+      }
+      offset += dims[m];
+    }
+    // Combined hash of the multi-indices of the modes in [lo, hi) numbered from first
+    auto combine = [&](size_t lo, size_t hi, unsigned long first, unsigned long count, std::vector<uint32_t> &hc,
+                       std::vector<unsigned char> &nc) {
+      hc.assign(count, 0);
+      nc.assign(count, 0);
+      for (unsigned long a = 0; a < count; ++a) {
+        unsigned long rem = first + a;
+        uint64_t sum = 0;
+        for (size_t m = hi; m > lo; --m) {
+          auto i = rem % dims[m - 1];
+          rem /= dims[m - 1];
+          sum += h[m - 1][i];
+          nc[a] ^= neg[m - 1][i];
+        }
+        hc[a] = uint32_t(sum % r);
       }
+    };
+    unsigned long after = 1;
+    for (size_t m = mode + 1; m < dims.size(); ++m) after *= dims[m];
+    std::vector<uint32_t> hp, hq;
+    std::vector<unsigned char> np, nq;
+    combine(0, mode, p0, before, hp, np);
+    combine(mode + 1, dims.size(), 0, after, hq, nq);
 
-      distribution.reset();
+    parallel_chunks(dim, nthreads, [&](size_t first, size_t last) {
+      for (unsigned long p = 0; p < before; ++p) {
+        for (size_t i = first; i < last; ++i) {
+          const T *xi = x + (p * dim + i) * after;
+          T *yi = y + i * r;
+          for (unsigned long q = 0; q < after; ++q) {
+            uint32_t c = hp[p] + hq[q];
+            if (c >= r) c -= r;
+            if (np[p] ^ nq[q]) yi[c] -= xi[q];
+            else yi[c] += xi[q];
+          }
+        }
+      }
+    });
+  }
+
+  // In place fast Walsh-Hadamard transform of a power of two length
+  template <typename T>
+  void fwht(T *a, unsigned long n) {
+    for (unsigned long h = 1; h < n; h *= 2) {
+      for (unsigned long i = 0; i < n; i += 2 * h) {
+        for (unsigned long j = i; j < i + h; ++j) {
+          T u = a[j], v = a[j + h];
+          a[j] = u + v;
+          a[j + h] = u - v;
+        }
+      }
     }
-  QR_decomp(A);
+  }
+
+  // Y = M D H P, the rows of M with random signs D are zero padded to the
+  // power of two N >= J, Hadamard transformed and r of the N columns P are kept
+  template <typename T>
+  void srht_sketch(const T *x, unsigned long before, unsigned long dim, unsigned long after, uint32_t r,
+                   uint32_t stream, size_t nthreads, T *y) {
+    unsigned long J = before * after, N = 1;
+    while (N < J) N *= 2;
+    if (r > N) BTAS_EXCEPTION("The SRHT sketch rank exceeds the column dimension of the flattened tensor");
+    CounterRNG rng(random_seed_accessor(), stream);
+    std::vector<unsigned char> neg(J);
+    parallel_chunks(J, nthreads, [&](size_t first, size_t last) {
+      for (size_t j = first; j < last; ++j) neg[j] = rng(j)[0] & 1;
+    });
+    std::vector<uint32_t> w(r), keep(r);
+    for (uint32_t k = 0; k < r; ++k) w[k] = rng(N + k)[0];
+    sample_distinct(w.data(), r, uint32_t(N), keep.data());
+
+    parallel_chunks(dim, nthreads, [&](size_t first, size_t last) {
+      std::vector<T> buf(N);
+      for (size_t i = first; i < last; ++i) {
+        for (unsigned long p = 0; p < before; ++p) {
+          const T *xi = x + (p * dim + i) * after;
+          for (unsigned long q = 0; q < after; ++q) {
+            unsigned long j = p * after + q;
+            buf[j] = neg[j] ? -xi[q] : xi[q];
+          }
+        }
+        std::fill(buf.begin() + J, buf.end(), T(0));
+        fwht(buf.data(), N);
+        for (uint32_t k = 0; k < r; ++k) y[i * r + k] = buf[keep[k]];
+      }
+    });
+  }
+}  // namespace detail
+
+/// Computes the sketch \f$ Y = X_{(n)} \Omega \f$ of the mode-n matricization
+/// of \c A without forming \f$ X_{(n)} \f$. The random matrix is drawn from the
+/// counter based generator seeded by random_seed_accessor() with the stream
+/// \c mode, only the range of \c Y is meaningful.
+/// \param[in] A Order-N tensor with contiguous row-major storage
+/// \param[in] mode The mode of the matricization
+/// \param[in] rank The number of columns of \f$ \Omega \f$
+/// \param[in] sketch The type of \f$ \Omega \f$
+/// \param[out] Y The \f$ I_n \times rank \f$ sketch
+/// \param[in] nthreads Number of threads, does not change the result. Default = 1.
+template <typename Tensor>
+void sketch_mode(const Tensor &A, size_t mode, unsigned long rank, Sketch sketch, Tensor &Y, size_t nthreads = 1) {
+  using value_type = typename Tensor::value_type;
+  std::vector<unsigned long> dims;
+  unsigned long before = 1, after = 1;
+  for (size_t i = 0; i < A.rank(); ++i) {
+    dims.push_back(A.extent(i));
+    if (i < mode) before *= A.extent(i);
+    if (i > mode) after *= A.extent(i);
+  }
+  unsigned long dim = dims[mode];
+  Y = Tensor(dim, rank);
+  Y.fill(value_type(0));
+  switch (sketch) {
+    case Sketch::gaussian: {
+      Tensor G(before * after, rank);
+      generate_random_metric(G, mode, nthreads);
+      detail::mode_times(A.data(), before, dim, after, G.data(), rank, Y.data());
+      break;
+    }
+    case Sketch::srht:
+      detail::srht_sketch(A.data(), before, dim, after, rank, mode, nthreads, Y.data());
+      break;
+    case Sketch::sparse_sign:
+      detail::sparse_sign_sketch(A.data(), 0, before, dim, after, rank, mode, nthreads, Y.data());
+      break;
+    case Sketch::tensor_sketch:
+      detail::tensor_sketch(A.data(), dims, mode, 0, before, dim, rank, mode, nthreads, Y.data());
+      break;
+  }
 }
 
 /// Calculates the randomized compression of tensor \c A.
 /// <a href=https://arxiv.org/pdf/1703.09074.pdf> See reference </a>
-/// \param[in, out] A In: An order-N tensor to be randomly decomposed.
-/// Out: The core tensor of random decomposition \param[in, out] transforms
+/// \param[in] A An order-N tensor to be randomly decomposed, it is not modified.
+/// \param[out] core The core tensor of random decomposition \param[in, out] transforms
 /// In: An empty vector.  Out: The randomized decomposition factor matrices.
 /// \param[in] des_rank The rank of each mode of \c A after randomized
 /// decomposition. \param[in] oversampl Oversampling added to \c
@@ -54,49 +298,42 @@ template <typename Tensor> void generate_random_metric(Tensor &A) {
 /// Default = suggested = 10. \param[in] powerit Number of power iterations, as
 /// specified in the literature, to scale the spectrum of each mode. Default =
 /// suggested = 2.
+/// \param[in] nthreads Number of threads drawing the random matrices. Default = 1.
+/// \param[in] sketch The random matrix projected onto each mode. Default = Sketch::gaussian.
   template<typename Tensor>
-  void randomized_decomposition(Tensor &A, std::vector<Tensor> &transforms,
+  void randomized_decomposition(const Tensor &A, Tensor &core, std::vector<Tensor> &transforms,
                                 long des_rank, size_t oversampl = 10,
-                                size_t powerit = 2) {
+                                size_t powerit = 2, size_t nthreads = 1, Sketch sketch = Sketch::gaussian) {
     using ind_t = typename Tensor::range_type::index_type::value_type;
 
     // Add the oversampling to the desired rank
     size_t ndim = A.rank();
     ind_t rank = des_rank + oversampl;
-    std::vector<size_t> A_modes;
-    for (size_t i = 0; i < ndim; ++i) {
-      A_modes.push_back(i);
-    }
-    std::vector<size_t> final_modes(A_modes);
-
     // Walk through all the modes of A
     for (size_t n = 0; n < ndim; n++) {
-      // Flatten A
-      auto An = flatten(A, n);
-
-      // Make and fill the random matrix Gamma
-      Tensor G(An.extent(1), rank);
-      generate_random_metric(G);
+      unsigned long before = 1, after = 1, dim = A.extent(n);
+      for (size_t i = 0; i < n; ++i) before *= A.extent(i);
+      for (size_t i = n + 1; i < ndim; ++i) after *= A.extent(i);
 
-      // Project The random matrix onto the flatten reference tensor
-      Tensor Y(An.extent(0), rank);
-      gemm(CblasNoTrans, CblasNoTrans, 1.0, An, G, 0.0, Y);
+      // Project the random matrix Gamma onto the flattened reference tensor
+      Tensor Y;
+      sketch_mode(A, n, rank, sketch, Y, nthreads);
 
     // Start power iteration
       for (size_t j = 0; j < powerit; j++) {
         // Find L of an LU decomposition of the projected flattened tensor
         LU_decomp(Y);
-        Tensor Z(An.extent(1), Y.extent(1));
+        Tensor Z(before * after, Y.extent(1));
 
         // Find the L of an LU decomposition of the L above (called Y) projected
         // onto the flattened reference tensor
-        gemm(CblasTrans, CblasNoTrans, 1.0, An, Y, 0.0, Z);
+        detail::mode_adjoint_times(A.data(), before, dim, after, Y.data(), Y.extent(1), Z.data());
         LU_decomp(Z);
 
         // Project the second L from above (called Z) onto the flattened reference
       // tensor and start power iteration over again.
-      Y.resize(Range{Range1{An.extent(0)}, Range1{Z.extent(1)}});
-      gemm(CblasNoTrans, CblasNoTrans, 1.0, An, Z, 0.0, Y);
+      Y.resize(Range{Range1{dim}, Range1{Z.extent(1)}});
+      detail::mode_times(A.data(), before, dim, after, Z.data(), Z.extent(1), Y.data());
     }
 
     // Compute the QR from Y above.  If the QR is non-singular push it into
@@ -112,29 +349,213 @@ template <typename Tensor> void generate_random_metric(Tensor &A) {
 
     transforms.push_back(Y);
   }
-    std::vector<size_t> contract_modes;
-  contract_modes.push_back(0); contract_modes.push_back(ndim);
+
+    // The first contraction reads A, the rest reduce the partial core
     for (size_t n = 0; n < ndim; n++) {
-#ifdef BTAS_HAS_INTEL_MKL
-      core_contract(A, transforms[n], n);
-#else
-      std::vector<ind_t> final_dims;
-      for (size_t j = 0; j < ndim; ++j) {
-        if (j == n) {
-          final_dims.push_back(transforms[n].extent(1));
-        } else {
-          final_dims.push_back(A.extent(j));
+      detail::tucker_contract((n == 0) ? A : core, transforms[n], n, core);
+    }
+}
+
+/// Calculates the randomized compression of tensor \c A in place.
+/// \param[in, out] A In: An order-N tensor to be randomly decomposed.
+/// Out: The core tensor of random decomposition \param[in, out] transforms
+/// In: An empty vector.  Out: The randomized decomposition factor matrices.
+/// \param[in] des_rank The rank of each mode of \c A after randomized
+/// decomposition. \param[in] oversampl Oversampling added to \c
+/// desired_compression_rank. \param[in] powerit Number of power iterations.
+/// \param[in] nthreads Number of threads drawing the random matrices.
+/// \param[in] sketch The random matrix projected onto each mode.
+  template<typename Tensor>
+  void randomized_decomposition(Tensor &A, std::vector<Tensor> &transforms,
+                                long des_rank, size_t oversampl = 10,
+                                size_t powerit = 2, size_t nthreads = 1, Sketch sketch = Sketch::gaussian) {
+    Tensor core;
+    randomized_decomposition(static_cast<const Tensor &>(A), core, transforms, des_rank, oversampl, powerit,
+                             nthreads, sketch);
+    A = core;
+  }
+
+/// Single pass randomized Tucker compression of Sun, Huang, Tropp and Udell
+/// <a href=https://doi.org/10.1137/19M1257718> See reference </a>.
+/// The tensor is streamed in slabs of its first mode, every slab updates the
+/// factor sketches \f$ G_n = X_{(n)} \Omega_n \f$ and the core sketch
+/// \f$ Z = X \times_1 \Phi_1 \cdots \times_N \Phi_N \f$, so the tensor is read
+/// once and never has to be held in memory. The slabs can arrive in any
+/// order. finalize() recovers the factors \f$ Q_n \f$ from the QR of
+/// \f$ G_n \f$ and the core \f$ Z \times_n (\Phi_n Q_n)^\dagger \f$ from the
+/// sketches only. The random matrices are drawn from CounterRNG, a slab only
+/// generates the rows of \f$ \Omega_n \f$ it touches.
+template <typename Tensor>
+class StreamingTucker {
+ public:
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  using value_type = typename Tensor::value_type;
+
+  /// \param[in] range The range of the streamed tensor, order >= 2
+  /// \param[in] rank The Tucker rank of every mode, at most the dimension of the mode
+  /// \param[in] core_rank Rows of the core sketch matrices \f$ \Phi_n \f$,
+  /// at most the dimension of the mode. Default = 0, i.e. 2 \c rank + 1.
+  /// \param[in] sketch The factor sketches \f$ \Omega_n \f$, Sketch::srht needs
+  /// whole rows of \f$ X_{(n)} \f$ and cannot be streamed. Default = Sketch::gaussian.
+  /// \param[in] nthreads Number of threads. Default = 1.
+  template <typename Range>
+  StreamingTucker(const Range &range, ind_t rank, ind_t core_rank = 0, Sketch sketch = Sketch::gaussian,
+                  size_t nthreads = 1)
+      : sketch_(sketch), nthreads_(nthreads) {
+    if (range.rank() < 2) BTAS_EXCEPTION("StreamingTucker needs a tensor of order 2 or more");
+    if (sketch == Sketch::srht) BTAS_EXCEPTION("The SRHT sketch needs whole rows and cannot be streamed");
+    std::vector<ind_t> core_dims;
+    for (size_t n = 0; n < range.rank(); ++n) {
+      unsigned long dim = range.extent(n);
+      dims_.push_back(dim);
+      ranks_.push_back(std::min<unsigned long>(rank, dim));
+      core_ranks_.push_back(std::min<unsigned long>(core_rank ? core_rank : 2 * ranks_[n] + 1, dim));
+      if (core_ranks_[n] < ranks_[n]) BTAS_EXCEPTION("The core sketch rank must be at least the Tucker rank");
+      core_dims.push_back(core_ranks_[n]);
+
+      Tensor G(dim, ranks_[n]);
+      G.fill(value_type(0));
+      sketches_.push_back(G);
+      Tensor phi(dim, core_ranks_[n]);
+      fill_random_normal(phi, 0.0, 1.0, random_seed_accessor(), uint32_t(range.rank() + n), nthreads);
+      phi_.push_back(phi);
+    }
+    core_sketch_ = Tensor(btas::Range(core_dims));
+    core_sketch_.fill(value_type(0));
+    if (sketch_ == Sketch::gaussian) draw_omega(0, 0, std::accumulate(dims_.begin() + 1, dims_.end(), 1ul,
+                                                                        std::multiplies<unsigned long>()), omega0_);
+  }
+
+  /// Adds a slab of the tensor to the sketches.
+  /// \param[in] slab The rows [first, first + rows) of the first mode, row-major
+  /// \param[in] rows The number of rows of the first mode in the slab
+  /// \param[in] first The first row of the slab
+  void update(const value_type *slab, ind_t rows, ind_t first) {
+    size_t ndim = dims_.size();
+    if (first + rows > dims_[0]) BTAS_EXCEPTION("The slab is outside of the first mode");
+    if (rows == 0) return;
+
+    // Factor sketches, the slab is the blocks [p0, p0 + before) of every mode n > 0
+    for (size_t n = 0; n < ndim; ++n) {
+      unsigned long inner = 1, after = 1;
+      for (size_t m = 1; m < n; ++m) inner *= dims_[m];
+      for (size_t m = n + 1; m < ndim; ++m) after *= dims_[m];
+      unsigned long p0 = n ? first * inner : 0, before = n ? rows * inner : 1, dim = n ? dims_[n] : rows;
+      value_type *y = sketches_[n].data() + (n ? 0 : first * ranks_[0]);
+      switch (sketch_) {
+        case Sketch::gaussian: {
+          Tensor omega;
+          if (n > 0) draw_omega(n, uint64_t(p0) * after, before * after, omega);
+          detail::mode_times(slab, before, dim, after, n ? omega.data() : omega0_.data(), ranks_[n], y, 1.0);
+          break;
         }
+        case Sketch::sparse_sign:
+          detail::sparse_sign_sketch(slab, p0, before, dim, after, ranks_[n], n, nthreads_, y);
+          break;
+        case Sketch::tensor_sketch:
+          detail::tensor_sketch(slab, dims_, n, p0, before, dim, ranks_[n], n, nthreads_, y);
+          break;
+        default:
+          break;
       }
-    contract_modes[0] = n;
-    final_modes[n] = ndim;
-    btas::Range final_range(final_dims);
-    Tensor final(final_range);
-    contract(1.0, A, A_modes, transforms[n], contract_modes, 0.0, final, final_modes);
-    final_modes[n] = n;
-    A = final;
-#endif //BTAS_HAS_INTEL_MKL
+    }
+
+    // Core sketch, the last mode is contracted with a single GEMM, the
+    // others but the first with ttm and the first with the rows of Phi_1
+    // that belong to the slab
+    std::vector<ind_t> tdims(dims_.begin(), dims_.end());
+    tdims[0] = rows;
+    tdims.back() = core_ranks_.back();
+    Tensor T{btas::Range(tdims)};
+    unsigned long last = dims_.back();
+    gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, T.size() / core_ranks_.back(), core_ranks_.back(), last, 1.0,
+         slab, last, phi_.back().data(), core_ranks_.back(), 0.0, T.data(), core_ranks_.back());
+    for (size_t m = ndim - 2; m > 0; --m) {
+      Tensor U;
+      detail::ttm(T, phi_[m], m, U, nthreads_);
+      T = U;
+    }
+    unsigned long rest = T.size() / rows;
+    gemm(CblasRowMajor, CblasTrans, CblasNoTrans, core_ranks_[0], rest, rows, 1.0,
+         phi_[0].data() + first * core_ranks_[0], core_ranks_[0], T.data(), rest, 1.0, core_sketch_.data(), rest);
+  }
+
+  /// Adds a slab of the tensor to the sketches.
+  /// \param[in] slab Tensor holding the rows [first, first + slab.extent(0)) of the first mode
+  /// \param[in] first The first row of the slab
+  void update(const Tensor &slab, ind_t first) { update(slab.data(), slab.extent(0), first); }
+
+  /// Recovers the Tucker decomposition from the sketches, once every slab was added.
+  /// \param[out] core The core tensor
+  /// \param[out] transforms The orthonormal factor matrices, \f$ I_n \times R_n \f$
+  void finalize(Tensor &core, std::vector<Tensor> &transforms) const {
+    const auto adjoint = impl::adjoint_trans<value_type>();
+    transforms.clear();
+    core = core_sketch_;
+    for (size_t n = 0; n < dims_.size(); ++n) {
+      unsigned long k = ranks_[n], s = core_ranks_[n];
+      Tensor Q = sketches_[n];
+      if (!QR_decomp(Q)) BTAS_EXCEPTION("QR of the factor sketch failed");
+
+      // (Phi_n Q_n)^+ = R^-1 Qb^H from the QR of Phi_n Q_n
+      Tensor B(s, k), R(k, k), pinv(k, s), U(s, k);
+      gemm(CblasTrans, CblasNoTrans, 1.0, phi_[n], Q, 0.0, B);
+      Tensor Qb = B;
+      if (!QR_decomp(Qb)) BTAS_EXCEPTION("QR of the core sketch failed");
+      gemm(adjoint, CblasNoTrans, 1.0, Qb, B, 0.0, R);
+      if (!Inverse_Matrix(R)) BTAS_EXCEPTION("The core sketch is rank deficient");
+      gemm(CblasNoTrans, adjoint, 1.0, R, Qb, 0.0, pinv);
+      for (unsigned long i = 0; i < s; ++i)
+        for (unsigned long j = 0; j < k; ++j) U(i, j) = pinv(j, i);
+
+      Tensor W;
+      detail::ttm(core, U, n, W, nthreads_);
+      core = W;
+      transforms.push_back(Q);
+    }
+  }
+
+ private:
+  // Rows [first, first + rows) of Omega_n
+  void draw_omega(size_t n, uint64_t first, unsigned long rows, Tensor &omega) const {
+    unsigned long k = ranks_[n];
+    omega = Tensor(rows, k);
+    CounterRNG rng(random_seed_accessor(), n);
+    value_type *data = omega.data();
+    detail::parallel_chunks(rows * k, nthreads_, [&](size_t lo, size_t hi) {
+      for (size_t i = lo; i < hi; ++i) data[i] = detail::random_element<value_type>::make(rng.normal(first * k + i));
+    });
+  }
+
+  Sketch sketch_;
+  size_t nthreads_;
+  std::vector<unsigned long> dims_, ranks_, core_ranks_;
+  std::vector<Tensor> sketches_;  // G_n = X_(n) Omega_n
+  std::vector<Tensor> phi_;       // Phi_n^T, I_n x s_n
+  Tensor core_sketch_;            // Z
+  Tensor omega0_;                 // Omega_1, shared by every slab
+};
+
+/// Computes the single pass randomized Tucker compression of \c A with
+/// StreamingTucker, feeding it slabs of the first mode.
+/// \param[in] A Order-N tensor, N >= 2, it is not modified
+/// \param[in] rank The Tucker rank of every mode
+/// \param[out] core The core tensor
+/// \param[out] transforms The orthonormal factor matrices
+/// \param[in] slab_rows Rows of the first mode per slab. Default = 0, i.e. slabs of about \f$ 2^{20} \f$ elements.
+/// \param[in] sketch The factor sketches. Default = Sketch::gaussian.
+/// \param[in] nthreads Number of threads. Default = 1.
+template <typename Tensor>
+void streaming_tucker(const Tensor &A, typename Tensor::range_type::index_type::value_type rank, Tensor &core,
+                      std::vector<Tensor> &transforms, size_t slab_rows = 0, Sketch sketch = Sketch::gaussian,
+                      size_t nthreads = 1) {
+  StreamingTucker<Tensor> stream(A.range(), rank, 0, sketch, nthreads);
+  size_t rows = A.extent(0), row_size = A.size() / rows;
+  if (slab_rows == 0) slab_rows = std::max<size_t>(1, (size_t(1) << 20) / row_size);
+  for (size_t first = 0; first < rows; first += slab_rows) {
+    stream.update(A.data() + first * row_size, std::min(slab_rows, rows - first), first);
   }
+  stream.finalize(core, transforms);
 }
 } // namespace btas
 
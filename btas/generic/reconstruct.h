@@ -5,47 +5,152 @@
 #ifndef BTAS_GENERIC_RECONSTRUCT_H
 #define BTAS_GENERIC_RECONSTRUCT_H
 
+#include <btas/generic/gemm_impl.h>
 #include <btas/generic/scal_impl.h>
+#include <btas/generic/task_pool.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
 
 namespace btas {
+  namespace detail {
+    template <typename Tensor>
+    void check_reconstruct_order(const std::vector<Tensor> &A, const std::vector<size_t> &dims_order) {
+      if (A.size() - 1 != dims_order.size()) {
+        BTAS_EXCEPTION("A.size() - 1 != dims_order.size(), please verify that you have correctly assigned the "
+                       "order of dimension reconstruction");
+      }
+    }
+
+    // Computes rows [first, first + rows) of the CP model matricized as
+    // (all modes but the last of dims_order) x (last mode) into out, with
+    // leading dimension equal to the last mode. krp is a workspace of
+    // rows * R elements which receives the weighted rows of the Khatri-Rao
+    // product. The products of the leading modes are kept per level so a
+    // new row only recomputes the levels whose index changed.
+    template <typename Tensor>
+    void reconstruct_rows(const std::vector<Tensor> &A, const std::vector<size_t> &dims_order, size_t first,
+                          size_t rows, typename Tensor::value_type *krp, typename Tensor::value_type *out) {
+      using value_type = typename Tensor::value_type;
+      size_t nlead = dims_order.size() - 1;
+      size_t rank = A[0].extent(1);
+      const auto &last = A[dims_order[nlead]];
+      const value_type *lambda = A[A.size() - 1].data();
+
+      std::vector<size_t> idx(nlead);
+      for (size_t k = nlead, p = first; k > 0; --k) {
+        size_t extent = A[dims_order[k - 1]].extent(0);
+        idx[k - 1] = p % extent;
+        p /= extent;
+      }
+      std::vector<value_type> prefix(nlead * rank);
+      size_t changed = 0;
+      for (size_t row = 0; row < rows; ++row) {
+        for (size_t k = changed; k < nlead; ++k) {
+          const value_type *prev = k ? prefix.data() + (k - 1) * rank : lambda;
+          const value_type *a = A[dims_order[k]].data() + idx[k] * rank;
+          value_type *z = prefix.data() + k * rank;
+          for (size_t r = 0; r < rank; ++r) z[r] = prev[r] * a[r];
+        }
+        const value_type *z = nlead ? prefix.data() + (nlead - 1) * rank : lambda;
+        std::copy(z, z + rank, krp + row * rank);
+
+        size_t k = nlead;
+        while (k > 0) {
+          --k;
+          if (++idx[k] < A[dims_order[k]].extent(0)) break;
+          idx[k] = 0;
+        }
+        changed = k;
+      }
+
+      size_t cols = last.extent(0);
+      gemm(CblasRowMajor, CblasNoTrans, CblasTrans, rows, cols, rank, 1.0, krp, rank, last.data(), rank, 0.0, out,
+           cols);
+    }
+  }  // namespace detail
+
+  /// Reconstructs a CP model slab by slab without forming the full tensor.
+  /// The tensor, with its modes in the order \c dims_order, is split into
+  /// blocks of consecutive rows of its matricization (all modes but the last)
+  /// x (last mode), and every block is passed to \c f once it is computed.
+  /// The workspace of a block, its Khatri-Rao rows and its elements, is bounded
+  /// by \c block_elements. The factor matrices are not modified.
+  /// \param[in] A The factor matrices followed by the weights of the model
+  /// \param[in] dims_order The order of the modes in the reconstructed tensor
+  /// \param[in] f Called as \c f(first, count, data) with the elements
+  /// [first, first + count) of the row-major tensor. With \c nthreads > 1 it is
+  /// called concurrently for disjoint ranges and the order of the blocks is unspecified.
+  /// \param[in] block_elements Number of elements of the workspace of one block. Default = 2^20.
+  /// \param[in] nthreads Number of threads, blocks are distributed over them. Default = 1, 0 = all cores
+  template <typename Tensor, typename F>
+  void reconstruct_blocked(const std::vector<Tensor> &A, const std::vector<size_t> &dims_order, F f,
+                           size_t block_elements = size_t(1) << 20, size_t nthreads = 1) {
+    using value_type = typename Tensor::value_type;
+    detail::check_reconstruct_order(A, dims_order);
+    size_t rank = A[0].extent(1), cols = A[dims_order.back()].extent(0);
+    size_t rows = 1;
+    for (size_t k = 0; k + 1 < dims_order.size(); ++k) rows *= A[dims_order[k]].extent(0);
+
+    size_t block = std::max<size_t>(1, block_elements / (rank + cols));
+    size_t nblocks = (rows + block - 1) / block;
+    nthreads = detail::num_workers(nthreads, nblocks);
+    std::vector<std::vector<value_type>> krp(nthreads, std::vector<value_type>(block * rank)),
+        out(nthreads, std::vector<value_type>(block * cols));
+    auto task = [&](size_t b, size_t worker) {
+      size_t first = b * block, count = std::min(block, rows - first);
+      detail::reconstruct_rows(A, dims_order, first, count, krp[worker].data(), out[worker].data());
+      f(first * cols, count * cols, static_cast<const value_type *>(out[worker].data()));
+    };
+    std::vector<size_t> order(nblocks);
+    std::iota(order.begin(), order.end(), 0);
+    if (nthreads == 1) {
+      for (auto b : order) task(b, 0);
+    } else {
+      detail::run_tasks(order, nthreads, task);
+    }
+  }
+
+  /// Reconstructs the dense tensor of a CP model. The Khatri-Rao product is
+  /// formed in blocks of rows which are multiplied directly into the result,
+  /// so the workspace is bounded by \c block_elements instead of R times the
+  /// size of the result, and the factor matrices are not modified.
+  /// \param[in] A The factor matrices followed by the weights of the model
+  /// \param[in] dims_order The order of the modes in the reconstructed tensor
+  /// \param[in] nthreads Number of threads, blocks are distributed over them. Default = 1, 0 = all cores
+  /// \param[in] block_elements Number of elements of the Khatri-Rao workspace of one block. Default = 2^20.
+  /// \return The reconstructed tensor
   template<typename Tensor>
-  Tensor reconstruct(std::vector<Tensor> &A, std::vector<size_t> dims_order) {
-    using ind_t = typename Tensor::range_type::index_type::value_type;
+  Tensor reconstruct(const std::vector<Tensor> &A, const std::vector<size_t> &dims_order, size_t nthreads = 1,
+                     size_t block_elements = size_t(1) << 20) {
+    using value_type = typename Tensor::value_type;
     using ord_t = typename range_traits<typename Tensor::range_type>::ordinal_type;
+    detail::check_reconstruct_order(A, dims_order);
 
-    if (A.size() - 1 != dims_order.size()) {
-      BTAS_EXCEPTION("A.size() - 1 != dims_order.size(), please verify that you have correctly assigned the "
-                     "order of dimension reconstruction");
-    }
     std::vector<ord_t> dimensions;
     size_t ndim = A.size() - 1;
     for (size_t i = 0; i < ndim; i++) {
       dimensions.push_back(A[dims_order[i]].extent(0));
     }
-    ind_t rank = A[0].extent(1);
-    for (ind_t i = 0; i < rank; i++) {
-      scal(A[dims_order[0]].extent(0), A[ndim](i), std::begin(A[dims_order[0]]) + i, rank);
-    }
-
-    // Make the Khatri-Rao product of all the factor matrices execpt the last dimension
-    Tensor KRP = A[dims_order[0]];
-    Tensor hold = A[dims_order[0]];
-    for (size_t i = 1; i < A.size() - 2; i++) {
-      khatri_rao_product(KRP, A[dims_order[i]], hold);
-      KRP = hold;
-    }
-
-    // contract the rank dimension of the Khatri-Rao product with the rank dimension of
-    // the last factor matrix. hold is now the reconstructed tensor
-    hold = Tensor(KRP.extent(0), A[dims_order[ndim - 1]].extent(0));
-    gemm(CblasNoTrans, CblasTrans, 1.0, KRP, A[dims_order[ndim - 1]], 0.0, hold);
-
-    // resize the reconstructed tensor to the correct dimensions
-    hold.resize(dimensions);
+    Tensor hold{btas::Range(dimensions)};
+    size_t rank = A[0].extent(1), cols = dimensions.back();
+    size_t rows = hold.size() / cols;
 
-    // remove the scaling applied to the first factor matrix
-    for (ind_t i = 0; i < rank; i++) {
-      scal(A[dims_order[0]].extent(0), 1 / A[ndim](i), std::begin(A[dims_order[0]]) + i, rank);
+    size_t block = std::max<size_t>(1, block_elements / rank);
+    size_t nblocks = (rows + block - 1) / block;
+    nthreads = detail::num_workers(nthreads, nblocks);
+    std::vector<std::vector<value_type>> krp(nthreads, std::vector<value_type>(block * rank));
+    auto task = [&](size_t b, size_t worker) {
+      size_t first = b * block, count = std::min(block, rows - first);
+      detail::reconstruct_rows(A, dims_order, first, count, krp[worker].data(), hold.data() + first * cols);
+    };
+    std::vector<size_t> order(nblocks);
+    std::iota(order.begin(), order.end(), 0);
+    if (nthreads == 1) {
+      for (auto b : order) task(b, 0);
+    } else {
+      detail::run_tasks(order, nthreads, task);
     }
     return hold;
   }
@@ -5,9 +5,8 @@
 
 #include <vector>
 
-#include <mkl_trans.h>
-
 #include <btas/error.h>
+#include <btas/generic/lapacke_dispatch.h>
 #include <btas/range_traits.h>
 
 //***IMPORTANT***//
@@ -76,8 +75,7 @@ void swap_to_first(Tensor &A, size_t mode, bool is_in_front = false,
     rows = (is_in_front) ? A.extent(0) : size / A.extent(mode);
     cols = (is_in_front) ? size / A.extent(0) : A.extent(mode);
 
-    double *data_ptr = A.data();
-    mkl_dimatcopy('R', 'T', rows, cols, 1.0, data_ptr, cols, rows);
+    detail::imatcopy_transpose(rows, cols, A.data());
   }
 
     // All other dimension not so easy all indices up to mode of interest row
@@ -91,9 +89,9 @@ void swap_to_first(Tensor &A, size_t mode, bool is_in_front = false,
     for (size_t i = 0; i <= mode; i++)
       rows *= A.extent(i);
     cols = size / rows;
-    double *data_ptr = A.data();
+    auto *data_ptr = A.data();
 
-    mkl_dimatcopy('R', 'T', rows, cols, 1.0, data_ptr, cols, rows);
+    detail::imatcopy_transpose(rows, cols, data_ptr);
 
     step = rows;
     ind_t in_rows = (is_in_front) ? A.extent(0) : rows / A.extent(mode);
@@ -101,11 +99,10 @@ void swap_to_first(Tensor &A, size_t mode, bool is_in_front = false,
 
     for (ind_t i = 0; i < cols; i++) {
       data_ptr = A.data() + i * step;
-      mkl_dimatcopy('R', 'T', in_rows, in_cols, 1.0, data_ptr, in_cols,
-                    in_rows);
+      detail::imatcopy_transpose(in_rows, in_cols, data_ptr);
     }
     data_ptr = A.data();
-    mkl_dimatcopy('R', 'T', cols, rows, 1.0, data_ptr, rows, cols);
+    detail::imatcopy_transpose(cols, rows, data_ptr);
   }
   A.resize(aug_dims);
 }
@@ -150,8 +147,7 @@ void swap_to_first(Tensor &A, size_t mode, bool is_in_front = false,
     }
 
     // Permutes the rows and columns
-    double *data_ptr = A.data();
-  mkl_dimatcopy('R', 'T', rows, cols, 1.0, data_ptr, cols, rows);
+  detail::imatcopy_transpose(rows, cols, A.data());
 
   // resized to the new correct order.
   A.resize(aug_dims);
@@ -0,0 +1,114 @@
+#ifndef BTAS_GENERIC_TASK_POOL_H
+#define BTAS_GENERIC_TASK_POOL_H
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifdef BTAS_HAS_INTEL_MKL
+#include <mkl_service.h>
+#elif defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace btas{
+
+  namespace detail{
+
+    // Restricts BLAS calls made from the calling thread to a single thread,
+    // the work is parallel over tasks instead. With MKL this is thread local,
+    // OpenMP BLAS libraries follow the thread's nthreads-var. Pthread-only
+    // builds of OpenBLAS should be run with OPENBLAS_NUM_THREADS=1.
+    inline void pin_blas_threads(){
+#ifdef BTAS_HAS_INTEL_MKL
+      mkl_set_num_threads_local(1);
+#elif defined(_OPENMP)
+      omp_set_num_threads(1);
+#endif
+    }
+
+    // A fixed set of tasks distributed over per-worker queues. Workers pop
+    // from the front of their own queue and steal from the back of the others
+    // when it runs dry. Tasks never spawn new tasks so a worker is done once
+    // every queue is empty.
+    class WorkStealingQueues {
+    public:
+      explicit WorkStealingQueues(size_t nqueues) : queues_(nqueues), locks_(nqueues) {}
+
+      void push(size_t queue, size_t task) { queues_[queue].push_back(task); }
+
+      bool pop(size_t queue, size_t &task) {
+        {
+          std::lock_guard<std::mutex> lock(locks_[queue]);
+          if (!queues_[queue].empty()) {
+            task = queues_[queue].front();
+            queues_[queue].pop_front();
+            return true;
+          }
+        }
+        auto n = queues_.size();
+        for (size_t i = 1; i < n; ++i) {
+          auto victim = (queue + i) % n;
+          std::lock_guard<std::mutex> lock(locks_[victim]);
+          if (!queues_[victim].empty()) {
+            task = queues_[victim].back();
+            queues_[victim].pop_back();
+            return true;
+          }
+        }
+        return false;
+      }
+
+    private:
+      std::vector<std::deque<size_t>> queues_;
+      std::vector<std::mutex> locks_;
+    };
+
+    // Runs f(task, worker) for every task in order on nthreads workers
+    // pinned to single threaded BLAS, the calling thread only waits.
+    template <typename F>
+    void run_tasks(const std::vector<size_t> &order, size_t nthreads, F f) {
+      WorkStealingQueues queues(nthreads);
+      for (size_t i = 0; i < order.size(); ++i) queues.push(i % nthreads, order[i]);
+
+      auto worker = [&](size_t id) {
+        pin_blas_threads();
+        size_t t;
+        while (queues.pop(id, t)) f(t, id);
+      };
+      std::vector<std::thread> pool;
+      for (size_t id = 0; id < nthreads; ++id) pool.emplace_back(worker, id);
+      for (auto &th : pool) th.join();
+    }
+
+    inline size_t num_workers(size_t nthreads, size_t ntasks) {
+      if (nthreads == 0) nthreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+      return std::max<size_t>(1, std::min(nthreads, ntasks));
+    }
+
+    // Runs f(first, last) over nthreads equal chunks of [0, size), 0 threads
+    // uses every core.
+    template <typename F>
+    void parallel_chunks(size_t size, size_t nthreads, F f) {
+      nthreads = num_workers(nthreads, size);
+      size_t chunk = (size + nthreads - 1) / nthreads;
+      auto task = [&](size_t t, size_t) {
+        size_t first = t * chunk, last = std::min(size, first + chunk);
+        if (first < last) f(first, last);
+      };
+      if (nthreads == 1) {
+        task(0, 0);
+        return;
+      }
+      std::vector<size_t> order(nthreads);
+      std::iota(order.begin(), order.end(), 0);
+      run_tasks(order, nthreads, task);
+    }
+  }  // namespace detail
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_TASK_POOL_H
@@ -0,0 +1,263 @@
+#ifndef BTAS_GENERIC_TENSOR_TRAIN_H
+#define BTAS_GENERIC_TENSOR_TRAIN_H
+
+#include <btas/error.h>
+#include <btas/tensor.h>
+#include <btas/generic/dot_impl.h>
+#include <btas/generic/gemm_impl.h>
+#include <btas/generic/gesvd_impl.h>
+#include <btas/generic/linear_algebra.h>
+#include <btas/generic/numeric_type.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace btas {
+
+namespace detail {
+
+/// Truncated SVD \f$ M \approx U \Sigma V^H \f$ of a matrix. The smallest
+/// rank is kept for which the discarded singular values satisfy
+/// \f$ \sum_{i \geq r} \sigma_i^2 \leq \delta^2 \f$, at least 1 and at most \c max_rank.
+/// \param[in, out] M In: The matrix. Out: destroyed by gesvd.
+/// \param[in] delta2 The squared truncation threshold \f$ \delta^2 \f$
+/// \param[in] max_rank Largest rank kept, 0 = no limit
+/// \param[out] U The \f$ m \times r \f$ left singular vectors
+/// \param[out] S The \f$ r \f$ singular values
+/// \param[out] Vt The \f$ r \times n \f$ right singular vectors
+/// \return The squared norm of the discarded singular values
+template <typename Tensor, typename RealTensor>
+double tt_truncated_svd(Tensor &M, double delta2, size_t max_rank, Tensor &U, RealTensor &S, Tensor &Vt) {
+#ifndef BTAS_HAS_LAPACKE
+  BTAS_EXCEPTION("Computing the tensor-train SVD requires LAPACKE");
+#else   // BTAS_HAS_LAPACKE
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  ind_t m = M.extent(0), n = M.extent(1), k = std::min(m, n);
+  RealTensor sv(Range{Range1{k}});
+  Tensor u(Range{Range1{m}, Range1{k}}), vt(Range{Range1{k}, Range1{n}});
+  gesvd('S', 'S', M, sv, u, vt);
+
+  // Walk back from the smallest singular value while the tail fits in delta^2
+  ind_t r = k;
+  double tail = 0.0;
+  while (r > 1 && tail + sv(r - 1) * sv(r - 1) <= delta2) {
+    tail += sv(r - 1) * sv(r - 1);
+    --r;
+  }
+  if (max_rank > 0 && r > ind_t(max_rank)) {
+    for (ind_t i = max_rank; i < r; ++i) tail += sv(i) * sv(i);
+    r = max_rank;
+  }
+
+  S = RealTensor(Range{Range1{r}});
+  for (ind_t i = 0; i < r; ++i) S(i) = sv(i);
+  U = Tensor(Range{Range1{m}, Range1{r}});
+  for (ind_t i = 0; i < m; ++i) std::copy(u.data() + i * k, u.data() + i * k + r, U.data() + i * r);
+  Vt = Tensor(Range{Range1{r}, Range1{n}});
+  std::copy(vt.data(), vt.data() + r * n, Vt.data());
+  return tail;
+#endif  // BTAS_HAS_LAPACKE
+}
+
+}  // namespace detail
+
+/// Computes the tensor-train (TT) decomposition of an order-N tensor with
+/// the TT-SVD algorithm of Oseledets,
+/// \f$ A(i_1, \dots, i_N) = G_1(i_1) G_2(i_2) \cdots G_N(i_N) \f$.
+/// <a href=https://doi.org/10.1137/090752286> See reference. </a>
+/// The remainder is reshaped with \c resize after each truncated SVD, so
+/// the memory is bounded by the largest unfolding of \c A.
+/// \param[in] A Order-N tensor to be decomposed, it is not modified.
+/// \param[in] epsilon Relative accuracy, \f$ \|A - A_{TT}\| \leq \epsilon \|A\| \f$
+/// if \c max_rank does not truncate further.
+/// \param[out] cores The \f$ N \f$ cores \f$ G_n \f$ of size \f$ r_{n-1} \times I_n \times r_n \f$,
+/// \f$ r_0 = r_N = 1 \f$.
+/// \param[in] max_rank Largest TT rank, 0 = no limit. Default = 0.
+/// \return The relative error \f$ \|A - A_{TT}\| / \|A\| \f$.
+template <typename Tensor>
+double tt_svd(const Tensor &A, double epsilon, std::vector<Tensor> &cores, size_t max_rank = 0) {
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  using real_tensor = btas::Tensor<typename impl::real_type<typename Tensor::value_type>::type>;
+  size_t ndim = A.rank();
+  double norm2 = std::abs(dot(A, A));
+  double delta2 = epsilon * epsilon * norm2 / std::max<size_t>(1, ndim - 1);
+
+  cores.clear();
+  Tensor C = A;
+  ind_t r = 1, rest = A.size();
+  double discarded = 0.0;
+  for (size_t n = 0; n + 1 < ndim; ++n) {
+    ind_t dim = A.extent(n);
+    rest /= dim;
+    C.resize(Range{Range1{r * dim}, Range1{rest}});
+    Tensor U, Vt;
+    real_tensor S;
+    discarded += detail::tt_truncated_svd(C, delta2, max_rank, U, S, Vt);
+
+    ind_t rank = S.extent(0);
+    U.resize(Range{Range1{r}, Range1{dim}, Range1{rank}});
+    cores.push_back(U);
+    // The remainder S V^H
+    for (ind_t i = 0; i < rank; ++i) {
+      auto *row = Vt.data() + i * rest;
+      for (ind_t j = 0; j < rest; ++j) row[j] *= S(i);
+    }
+    C = Vt;
+    r = rank;
+  }
+  C.resize(Range{Range1{r}, Range1{A.extent(ndim - 1)}, Range1{1}});
+  cores.push_back(C);
+  return norm2 > 0 ? std::sqrt(discarded / norm2) : 0.0;
+}
+
+/// Rounds a tensor train to lower TT ranks. The cores are left
+/// orthogonalized with QR from the first to the last, then truncated with
+/// SVDs from the last to the first.
+/// <a href=https://doi.org/10.1137/090752286> See reference. </a>
+/// \param[in, out] cores In: The cores of a tensor train. Out: The rounded cores.
+/// \param[in] epsilon Relative accuracy of the rounding.
+/// \param[in] max_rank Largest TT rank, 0 = no limit. Default = 0.
+/// \return The relative error of the rounding.
+template <typename Tensor>
+double tt_round(std::vector<Tensor> &cores, double epsilon, size_t max_rank = 0) {
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  using value_type = typename Tensor::value_type;
+  using real_tensor = btas::Tensor<typename impl::real_type<value_type>::type>;
+  const auto adjoint = impl::adjoint_trans<value_type>();
+  size_t ndim = cores.size();
+  if (ndim == 0) return 0.0;
+
+  // Left orthogonalization, G_n = Q R and R is moved into G_{n+1}
+  for (size_t n = 0; n + 1 < ndim; ++n) {
+    auto &G = cores[n];
+    ind_t r0 = G.extent(0), dim = G.extent(1), r1 = G.extent(2);
+    G.resize(Range{Range1{r0 * dim}, Range1{r1}});
+    Tensor R;
+    if (r0 * dim >= r1) {
+      Tensor Q = G;
+      if (!QR_decomp(Q)) BTAS_EXCEPTION("QR of a tensor-train core failed");
+      R = Tensor(Range{Range1{r1}, Range1{r1}});
+      gemm(adjoint, CblasNoTrans, 1.0, Q, G, 0.0, R);
+      G = Q;
+    } else {
+      // Fewer rows than columns, the rank drops to the number of rows
+      Tensor U;
+      real_tensor S;
+      detail::tt_truncated_svd(G, 0.0, 0, U, S, R);
+      for (ind_t i = 0; i < R.extent(0); ++i)
+        for (ind_t j = 0; j < r1; ++j) R(i, j) *= S(i);
+      G = U;
+    }
+    ind_t rank = R.extent(0);
+    G.resize(Range{Range1{r0}, Range1{dim}, Range1{rank}});
+
+    auto &H = cores[n + 1];
+    ind_t dim1 = H.extent(1), r2 = H.extent(2);
+    H.resize(Range{Range1{r1}, Range1{dim1 * r2}});
+    Tensor RH(Range{Range1{rank}, Range1{dim1 * r2}});
+    gemm(CblasNoTrans, CblasNoTrans, 1.0, R, H, 0.0, RH);
+    RH.resize(Range{Range1{rank}, Range1{dim1}, Range1{r2}});
+    H = RH;
+  }
+
+  // The norm is in the last core, truncate from right to left
+  double norm2 = std::abs(dot(cores.back(), cores.back()));
+  double delta2 = epsilon * epsilon * norm2 / std::max<size_t>(1, ndim - 1);
+  double discarded = 0.0;
+  for (size_t n = ndim - 1; n > 0; --n) {
+    auto &G = cores[n];
+    ind_t r0 = G.extent(0), dim = G.extent(1), r1 = G.extent(2);
+    G.resize(Range{Range1{r0}, Range1{dim * r1}});
+    Tensor U, Vt;
+    real_tensor S;
+    discarded += detail::tt_truncated_svd(G, delta2, max_rank, U, S, Vt);
+    ind_t rank = S.extent(0);
+    Vt.resize(Range{Range1{rank}, Range1{dim}, Range1{r1}});
+    G = Vt;
+
+    // G_{n-1} U S
+    for (ind_t i = 0; i < r0; ++i)
+      for (ind_t j = 0; j < rank; ++j) U(i, j) *= S(j);
+    auto &H = cores[n - 1];
+    ind_t r2 = H.extent(0), dim1 = H.extent(1);
+    H.resize(Range{Range1{r2 * dim1}, Range1{r0}});
+    Tensor HU(Range{Range1{r2 * dim1}, Range1{rank}});
+    gemm(CblasNoTrans, CblasNoTrans, 1.0, H, U, 0.0, HU);
+    HU.resize(Range{Range1{r2}, Range1{dim1}, Range1{rank}});
+    H = HU;
+  }
+  return norm2 > 0 ? std::sqrt(discarded / norm2) : 0.0;
+}
+
+/// Computes the inner product \f$ \langle X, Y \rangle = \sum \bar{X} Y \f$ of
+/// two tensor trains without forming either tensor, by contracting the
+/// cores from left to right.
+/// \param[in] X The cores of the first tensor train
+/// \param[in] Y The cores of the second tensor train
+/// \return The inner product
+template <typename Tensor>
+typename Tensor::value_type tt_dot(const std::vector<Tensor> &X, const std::vector<Tensor> &Y) {
+  using value_type = typename Tensor::value_type;
+  if (X.size() != Y.size()) BTAS_EXCEPTION("Tensor trains of different order");
+  const auto adjoint = impl::adjoint_trans<value_type>();
+
+  // W(a, b) is the contraction of the cores to the left, a indexes X and b Y
+  std::vector<value_type> W(1, value_type(1)), Z, Wn;
+  for (size_t n = 0; n < X.size(); ++n) {
+    unsigned long rx = X[n].extent(0), ry = Y[n].extent(0), dim = X[n].extent(1);
+    unsigned long rx1 = X[n].extent(2), ry1 = Y[n].extent(2);
+    if (Y[n].extent(1) != dim) BTAS_EXCEPTION("Tensor trains of different dimensions");
+    // Z(a, i b') = W(a, b) Y(b, i b')
+    Z.resize(rx * dim * ry1);
+    gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, rx, dim * ry1, ry, 1.0, W.data(), ry, Y[n].data(), dim * ry1,
+         0.0, Z.data(), dim * ry1);
+    // W'(a', b') = X(a i, a')^H Z(a i, b')
+    Wn.resize(rx1 * ry1);
+    gemm(CblasRowMajor, adjoint, CblasNoTrans, rx1, ry1, rx * dim, 1.0, X[n].data(), rx1, Z.data(), ry1, 0.0,
+         Wn.data(), ry1);
+    W.swap(Wn);
+  }
+  return W[0];
+}
+
+/// \param[in] X The cores of a tensor train
+/// \return The Frobenius norm of the tensor train
+template <typename Tensor>
+double tt_norm(const std::vector<Tensor> &X) {
+  return std::sqrt(std::abs(tt_dot(X, X)));
+}
+
+/// Reconstructs the full tensor from its tensor-train cores.
+/// \param[in] cores The cores \f$ G_n \f$ of size \f$ r_{n-1} \times I_n \times r_n \f$, \f$ r_0 = r_N = 1 \f$
+/// \return The tensor of range \f$ I_1 \times \dots \times I_N \f$
+/// \throws Exception if the ranks of neighbouring cores differ or the boundary ranks are not 1
+template <typename Tensor>
+Tensor tt_reconstruct(const std::vector<Tensor> &cores) {
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  if (cores.empty()) BTAS_EXCEPTION("Tensor train has no cores");
+  if (cores.front().extent(0) != 1 || cores.back().extent(2) != 1)
+    BTAS_EXCEPTION("The boundary ranks of the tensor train must be 1");
+  std::vector<ind_t> dims;
+  Tensor R = cores[0];
+  ind_t rows = R.extent(0) * R.extent(1);
+  dims.push_back(R.extent(1));
+  for (size_t n = 1; n < cores.size(); ++n) {
+    ind_t r = cores[n].extent(0), dim = cores[n].extent(1), r1 = cores[n].extent(2);
+    if (R.size() != rows * r) BTAS_EXCEPTION("Tensor-train ranks do not match");
+    // (P x r) (r x I r') = (P I x r')
+    Tensor next(Range{Range1{rows}, Range1{dim * r1}});
+    gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, rows, dim * r1, r, 1.0, R.data(), r, cores[n].data(),
+         dim * r1, 0.0, next.data(), dim * r1);
+    R = next;
+    rows *= dim;
+    dims.push_back(dim);
+  }
+  R.resize(Range(dims));
+  return R;
+}
+
+}  // namespace btas
+
+#endif  // BTAS_GENERIC_TENSOR_TRAIN_H
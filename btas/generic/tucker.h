@@ -4,101 +4,363 @@
 #include <btas/generic/core_contract.h>
 #include <btas/generic/flatten.h>
 #include <btas/generic/contract.h>
+#include <btas/generic/lapacke_dispatch.h>
+#include <btas/generic/mode_gram.h>
+#include <btas/generic/task_pool.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <numeric>
+#include <utility>
+#include <vector>
 
 namespace btas {
+namespace detail {
+
+/// Computes the truncated left singular vectors of mode \c mode of \c A from the
+/// eigenvalue decomposition of \f$ A_{(n)} A_{(n)}^H \f$. Eigenvectors whose
+/// eigenvalue is below \c threshold are discarded.
+/// \param[in] A Order-N tensor
+/// \param[in] mode The mode whose singular vectors are computed
+/// \param[in] threshold Smallest squared singular value which is kept
+/// \param[in] keep If nonzero the \c keep leading singular vectors are kept
+/// and \c threshold is ignored. Default = 0.
+/// \return The kept singular vectors as the columns of a matrix
+template <typename Tensor>
+Tensor tucker_factor(const Tensor &A, size_t mode, double threshold,
+                     typename Tensor::range_type::index_type::value_type keep = 0) {
+  using ind_t = typename Tensor::range_type::index_type::value_type;
+  using real_type = typename impl::real_type<typename Tensor::value_type>::type;
+  ind_t R = A.extent(mode);
+  Tensor S, lambda;
+  std::vector<real_type> evals(R);
+
+  // Form A_(n) A_(n)^H with SYRK (HERK for complex tensors) to reduce the
+  // dimension of the SVD object to I_n X I_n
+  mode_gram(A, mode, S);
+
+  // Calculate SVD of smaller object, the eigenvalues are real.
+#ifdef BTAS_HAS_LAPACKE
+  auto info = detail::syev(LAPACK_ROW_MAJOR, 'V', 'L', R, S.data(), R,
+                            evals.data());
+  if (info)
+  BTAS_EXCEPTION("Error in computing the tucker SVD");
+#else
+  BTAS_EXCEPTION("Tucker decomposition requires LAPACKE");
+#endif
+
+  // Find the truncation rank based on the threshold.
+  ind_t rank = 0;
+  if (keep > 0) {
+    rank = R - std::min(keep, R);
+  } else {
+    for (auto &eigvals : evals) {
+      if (eigvals < threshold)
+        rank++;
+    }
+  }
+
+  // Truncate the column space of the unitary factor matrix.
+  auto kept_evecs = R - rank;
+  ind_t zero = 0;
+  lambda = Tensor(R, kept_evecs);
+  auto lower_bound = {zero, rank};
+  auto upper_bound = {R, R};
+  auto view =
+      btas::make_view(S.range().slice(lower_bound, upper_bound), S.storage());
+  std::copy(view.begin(), view.end(), lambda.begin());
+  return lambda;
+}
+
+/// Computes the mode product \f$ Y = X \times_n U^T \f$ with BLAS, without
+/// permuting \c X. \c X is read as the row-major matrices \f$ X_p \f$ of size
+/// \f$ I_n \times S \f$, one per index \f$ p \f$ of the modes before \c mode,
+/// and \f$ Y_p = U^T X_p \f$. With \c nthreads > 1 the products are split
+/// over the matrices and, if there are fewer matrices than threads, over
+/// column blocks of the matrices.
+/// \param[in] X Order-N tensor
+/// \param[in] U Matrix of size \f$ I_n \times R \f$
+/// \param[in] mode Mode of \c X to contract with \c U
+/// \param[out] Y \c X with mode \c mode reduced to the columns of \c U
+/// \param[in] nthreads Number of threads. Default = 1.
+template <typename Tensor>
+void ttm(const Tensor &X, const Tensor &U, size_t mode, Tensor &Y, size_t nthreads = 1) {
+  using ord_t = typename range_traits<typename Tensor::range_type>::ordinal_type;
+  auto ndim = X.rank();
+  ord_t before = 1, after = 1;
+  std::vector<size_t> dims;
+  for (size_t i = 0; i < ndim; ++i) {
+    if (i < mode) before *= X.extent(i);
+    if (i > mode) after *= X.extent(i);
+    dims.push_back(i == mode ? U.extent(1) : X.extent(i));
+  }
+  ord_t I = X.extent(mode), R = U.extent(1);
+  Y = Tensor(btas::Range(dims));
+
+  // Each task computes a column block of one Y_p
+  ord_t blocks = (before >= nthreads) ? 1 : std::min<ord_t>(after, (nthreads + before - 1) / before);
+  ord_t width = (after + blocks - 1) / blocks;
+  auto task = [&](size_t t, size_t) {
+    ord_t p = t / blocks, first = (t % blocks) * width;
+    ord_t cols = std::min(width, after - first);
+    gemm(CblasRowMajor, CblasTrans, CblasNoTrans, R, cols, I, 1.0, U.data(), R,
+         X.data() + p * I * after + first, after, 0.0, Y.data() + p * R * after + first, after);
+  };
+  std::vector<size_t> order(before * blocks);
+  std::iota(order.begin(), order.end(), 0);
+  if (nthreads <= 1) {
+    for (auto t : order) task(t, 0);
+  } else {
+    run_tasks(order, num_workers(nthreads, order.size()), task);
+  }
+}
+
+/// ttm() multiplies by the transpose of its factor, the factor which makes it
+/// contract with \f$ U^H \f$ is \c U itself for real tensors and its conjugate
+/// for complex tensors.
+/// \param[in] U Factor matrix
+/// \return \c U or its elementwise conjugate
+template <typename Tensor>
+Tensor tucker_ttm_factor(const Tensor &U) {
+  if (!impl::is_complex<typename Tensor::value_type>::value) return U;
+  Tensor conj_U(U.range());
+  std::transform(U.begin(), U.end(), conj_U.begin(),
+                 [](const typename Tensor::value_type &x) { return impl::conj(x); });
+  return conj_U;
+}
+
+/// Contracts mode \c mode of \c src with the Tucker factor matrix \c lambda,
+/// \f$ core = src \times_n lambda^H \f$, with ttm(), so \c src is neither
+/// permuted nor copied. \c src may be \c core.
+/// \param[in] src Order-N tensor
+/// \param[in] lambda Factor matrix with one column per kept singular vector
+/// \param[in] mode Mode of \c src to contract with \c lambda
+/// \param[out] core \c src with mode \c mode reduced to the columns of \c lambda
+template <typename Tensor>
+void tucker_contract(const Tensor &src, const Tensor &lambda, size_t mode, Tensor &core) {
+  Tensor final;
+  ttm(src, tucker_ttm_factor(lambda), mode, final);
+  core = std::move(final);
+}
+
+} // namespace detail
+
 /// Computes the tucker compression of an order-N tensor A.
 /// <a href=http://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7516088> See
 /// reference. </a>
+/// With \c sequential the sequentially truncated HOSVD (ST-HOSVD) is computed:
+/// each mode is truncated as soon as its factor matrix is known, so the later
+/// modes work on the partially compressed core. The error bound is the same.
+/// <a href=https://doi.org/10.1137/110836067> See reference. </a>
 
-/// \param[in, out] A In: Order-N tensor to be decomposed.  Out: The core
-/// tensor of the Tucker decomposition \param[in] epsilon_svd The threshold
+/// \param[in] A Order-N tensor to be decomposed, it is not modified.
+/// \param[in] epsilon_svd The threshold
 /// truncation value for the Truncated Tucker-SVD decomposition \param[in, out]
 /// transforms In: An empty vector.  Out: The Tucker factor matrices.
+/// \param[out] core The core tensor of the Tucker decomposition.
+/// \param[in] sequential Compute the ST-HOSVD? Default = false.
 
 template <typename Tensor>
-void tucker_compression(Tensor &A, double epsilon_svd,
-                        std::vector<Tensor> &transforms) {
-  using ind_t = typename Tensor::range_type::index_type::value_type;
+void tucker_compression(const Tensor &A, double epsilon_svd,
+                        std::vector<Tensor> &transforms, Tensor &core,
+                        bool sequential = false) {
   auto ndim = A.rank();
 
-  double norm2 = dot(A, A);
+  double norm2 = std::abs(dot(A, A));
   //norm2 *= norm2;
-  std::vector<size_t> A_modes;
-  for (size_t i = 0; i < ndim; ++i) {
-    A_modes.push_back(i);
+  // Determine the threshold epsilon_SVD.
+  auto threshold = epsilon_svd * epsilon_svd * norm2 / ndim;
+
+  if (sequential) {
+    // The first mode reads A, the rest the partially truncated core.
+    for (size_t i = 0; i < ndim; ++i) {
+      const Tensor &src = (i == 0) ? A : core;
+      transforms.push_back(detail::tucker_factor(src, i, threshold));
+      detail::tucker_contract(src, transforms[i], i, core);
+    }
+    return;
   }
 
   for (size_t i = 0; i < ndim; i++) {
-    // Determine the threshold epsilon_SVD.
-    auto flat = flatten(A, i);
-    auto threshold = epsilon_svd * epsilon_svd * norm2 / ndim;
+    // Push the factor matrix back as a transformation.
+    transforms.push_back(detail::tucker_factor(A, i, threshold));
+  }
 
-    ind_t R = flat.extent(0);
-    Tensor S(R, R), lambda(R, 1);
+  // The first contraction reads A, the rest reduce the partial core.
+  for (size_t i = 0; i < ndim; ++i) {
+    detail::tucker_contract((i == 0) ? A : core, transforms[i], i, core);
+  }
+}
 
-    // Contract A_n^T A_n to reduce the dimension of the SVD object to I_n X I_n
-    gemm(CblasNoTrans, CblasTrans, 1.0, flat, flat, 0.0, S);
+/// Computes the tucker compression of an order-N tensor A in place.
 
-    // Calculate SVD of smaller object.
-#ifdef BTAS_HAS_LAPACKE
-    auto info = LAPACKE_dsyev(LAPACK_ROW_MAJOR, 'V', 'L', R, S.data(), R,
-                              lambda.data());
-    if (info)
-    BTAS_EXCEPTION("Error in computing the tucker SVD");
-#else
-    BTAS_EXCEPTION("Tucker decomposition requires LAPACKE");
-#endif
+/// \param[in, out] A In: Order-N tensor to be decomposed.  Out: The core
+/// tensor of the Tucker decomposition \param[in] epsilon_svd The threshold
+/// truncation value for the Truncated Tucker-SVD decomposition \param[in, out]
+/// transforms In: An empty vector.  Out: The Tucker factor matrices.
+/// \param[in] sequential Compute the ST-HOSVD? Default = false.
 
-    // Find the truncation rank based on the threshold.
-    ind_t rank = 0;
-    for (auto &eigvals : lambda) {
-      if (eigvals < threshold)
-        rank++;
+template <typename Tensor>
+void tucker_compression(Tensor &A, double epsilon_svd,
+                        std::vector<Tensor> &transforms, bool sequential = false) {
+  Tensor core;
+  tucker_compression(static_cast<const Tensor &>(A), epsilon_svd, transforms, core, sequential);
+  A = core;
+}
+
+/// Refines a Tucker decomposition of an order-N tensor A with the higher-order
+/// orthogonal iteration (HOOI) at a fixed multilinear rank. Each factor matrix
+/// is replaced by the leading left singular vectors of A contracted with all
+/// other factor matrices, which never increases the truncation error.
+/// <a href=https://doi.org/10.1137/S0895479898346995> See reference. </a>
+/// The mode products are memoized on a binary split of the modes: A is
+/// contracted with the factors of one half once and the result is shared by
+/// every mode of the other half, so A is read twice per sweep instead of once
+/// per mode.
+
+/// \param[in] A Order-N tensor to be decomposed, it is not modified.
+/// \param[in] epsilon_svd If \c transforms is empty, the threshold truncation
+/// value of the ST-HOSVD which provides the initial factors and the multilinear rank.
+/// \param[in, out] transforms In: The initial Tucker factor matrices with
+/// orthonormal columns, or an empty vector. Out: The refined factor matrices.
+/// \param[out] core The core tensor of the Tucker decomposition.
+/// \param[in] max_iter Maximum number of HOOI sweeps. Default = 10.
+/// \param[in] tol The iteration stops when the squared norm of the core changes
+/// by less than \c tol times the squared norm of \c A. Default = 1e-10.
+/// \param[in] nthreads Number of threads of the mode products. Default = 1.
+/// \returns The relative error \f$ \|A - core \times_1 U_1 \cdots \times_N U_N\| / \|A\| \f$
+
+template <typename Tensor>
+double tucker_hooi(const Tensor &A, double epsilon_svd, std::vector<Tensor> &transforms,
+                   Tensor &core, size_t max_iter = 10, double tol = 1e-10, size_t nthreads = 1) {
+  size_t ndim = A.rank();
+  double norm2 = std::abs(dot(A, A));
+  if (transforms.empty()) tucker_compression(A, epsilon_svd, transforms, core, true);
+  if (transforms.size() != ndim) BTAS_EXCEPTION("HOOI requires one factor matrix per mode");
+
+  // The mode products contract with U^H, ttm is given the conjugate factors
+  std::vector<Tensor> ttm_factors;
+  for (const auto &U : transforms) ttm_factors.push_back(detail::tucker_ttm_factor(U));
+
+  // Contracts src with the factors of modes [first, last), skipping mode skip
+  auto chain = [&](const Tensor &src, size_t first, size_t last, size_t skip) {
+    Tensor result, temp;
+    const Tensor *in = &src;
+    for (size_t i = first; i < last; ++i) {
+      if (i == skip) continue;
+      detail::ttm(*in, ttm_factors[i], i, temp, nthreads);
+      std::swap(result, temp);
+      in = &result;
     }
+    if (in == &src) result = src;
+    return result;
+  };
 
-    // Truncate the column space of the unitary factor matrix.
-    auto kept_evecs = R - rank;
-    ind_t zero = 0;
-    lambda = Tensor(R, kept_evecs);
-    auto lower_bound = {zero, rank};
-    auto upper_bound = {R, R};
-    auto view =
-        btas::make_view(S.range().slice(lower_bound, upper_bound), S.storage());
-    std::copy(view.begin(), view.end(), lambda.begin());
+  size_t half = ndim / 2;
+  double core_norm2 = -1.0;
+  for (size_t iter = 0; iter < max_iter; ++iter) {
+    Tensor Y;
+    for (size_t side = 0; side < 2; ++side) {
+      // Modes [first, last) are updated from A contracted with the other half
+      size_t first = side ? half : 0, last = side ? ndim : half;
+      auto partial = side ? chain(A, 0, half, ndim) : chain(A, half, ndim, ndim);
+      for (size_t n = first; n < last; ++n) {
+        Y = chain(partial, first, last, n);
+        transforms[n] = detail::tucker_factor(Y, n, 0.0, transforms[n].extent(1));
+        ttm_factors[n] = detail::tucker_ttm_factor(transforms[n]);
+      }
+    }
+    // Y still holds the product with every factor but the last
+    detail::ttm(Y, ttm_factors[ndim - 1], ndim - 1, core, nthreads);
+    double change = std::abs(std::abs(dot(core, core)) - core_norm2);
+    core_norm2 = std::abs(dot(core, core));
+    if (change < tol * norm2) break;
+  }
+  if (core_norm2 < 0) {
+    core = chain(A, 0, ndim, ndim);
+    core_norm2 = std::abs(dot(core, core));
+  }
+  return std::sqrt(std::max(0.0, norm2 - core_norm2) / norm2);
+}
 
-    // Push the factor matrix back as a transformation.
-    transforms.push_back(lambda);
+/// Reconstructs a Tucker model \f$ core \times_1 U_1 \cdots \times_N U_N \f$
+/// slab by slab without forming the full tensor. A slab is a block of
+/// consecutive indices of the first mode: the block of rows of \f$ U_1 \f$ is
+/// multiplied into the core and the other modes are expanded with detail::ttm(),
+/// so the workspace of a slab is bounded by about \c block_elements.
+/// \param[in] core The core tensor of the Tucker decomposition
+/// \param[in] transforms The factor matrices, \c transforms[n] is \f$ I_n \times R_n \f$
+/// \param[in] f Called as \c f(first, count, data) with the elements
+/// [first, first + count) of the row-major tensor. With \c nthreads > 1 it is
+/// called concurrently for disjoint ranges and the order of the slabs is unspecified.
+/// \param[in] block_elements Number of elements of the workspace of one slab. Default = 2^20.
+/// \param[in] nthreads Number of threads, slabs are distributed over them. Default = 1, 0 = all cores
+template <typename Tensor, typename F>
+void tucker_reconstruct_blocked(const Tensor &core, const std::vector<Tensor> &transforms, F f,
+                                size_t block_elements = size_t(1) << 20, size_t nthreads = 1) {
+  using value_type = typename Tensor::value_type;
+  size_t ndim = core.rank();
+  if (transforms.size() != ndim) BTAS_EXCEPTION("One transform per mode of the core is required");
+  size_t rows = transforms[0].extent(0), ranks = core.size() / core.extent(0), inner = 1, width = 1;
+  std::vector<Tensor> expand(ndim);
+  for (size_t n = 0; n < ndim; ++n) {
+    if (transforms[n].extent(1) != core.extent(n)) BTAS_EXCEPTION("The transforms do not match the core");
+    if (n == 0) continue;
+    inner *= transforms[n].extent(0);
+    width *= std::max(transforms[n].extent(0), transforms[n].extent(1));
+    // ttm multiplies by the transpose of its matrix
+    expand[n] = Tensor(transforms[n].extent(1), transforms[n].extent(0));
+    const auto &U = transforms[n];
+    for (size_t i = 0; i < U.extent(0); ++i)
+      for (size_t r = 0; r < U.extent(1); ++r) expand[n](r, i) = U(i, r);
   }
 
-  for (size_t i = 0; i < ndim; ++i) {
-    auto &lambda = transforms[i];
-    ind_t kept_evecs = lambda.extent(1);
-#ifdef BTAS_HAS_INTEL_MKL
-    // Contract the factor matrix with the reference tensor, A.
-    core_contract(A, lambda, i);
-#else
-    std::vector<size_t> contract_modes;
-    contract_modes.push_back(i);
-    contract_modes.push_back(ndim);
-    std::vector<size_t> final_modes;
-    std::vector<size_t> final_dims;
-    for (size_t j = 0; j < ndim; ++j) {
-      if (j == i) {
-        final_modes.push_back(ndim);
-        final_dims.push_back(kept_evecs);
-      } else {
-        final_modes.push_back(j);
-        final_dims.push_back(A.extent(j));
-      }
+  size_t block = std::max<size_t>(1, block_elements / width);
+  size_t nslabs = (rows + block - 1) / block;
+  nthreads = detail::num_workers(nthreads, nslabs);
+  auto task = [&](size_t b, size_t) {
+    size_t first = b * block, count = std::min(block, rows - first);
+    std::vector<size_t> dims(1, count);
+    for (size_t n = 1; n < ndim; ++n) dims.push_back(core.extent(n));
+    Tensor X{btas::Range(dims)}, Y;
+    const auto &U = transforms[0];
+    gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, count, ranks, U.extent(1), 1.0,
+         U.data() + first * U.extent(1), U.extent(1), core.data(), ranks, 0.0, X.data(), ranks);
+    for (size_t n = 1; n < ndim; ++n) {
+      detail::ttm(X, expand[n], n, Y);
+      std::swap(X, Y);
     }
-    btas::Range final_range(final_dims);
-    Tensor final(final_range);
-    btas::contract(1.0, A, A_modes, lambda, contract_modes, 0.0, final, final_modes);
-    A = final;
-#endif //BTAS_HAS_INTEL_MKL
+    f(first * inner, count * inner, static_cast<const value_type *>(X.data()));
+  };
+  std::vector<size_t> order(nslabs);
+  std::iota(order.begin(), order.end(), 0);
+  if (nthreads == 1) {
+    for (auto b : order) task(b, 0);
+  } else {
+    detail::run_tasks(order, nthreads, task);
   }
 }
+
+/// Reconstructs the dense tensor of a Tucker model, see tucker_reconstruct_blocked().
+/// \param[in] core The core tensor of the Tucker decomposition
+/// \param[in] transforms The factor matrices, \c transforms[n] is \f$ I_n \times R_n \f$
+/// \param[in] nthreads Number of threads. Default = 1, 0 = all cores
+/// \return The reconstructed tensor
+template <typename Tensor>
+Tensor tucker_reconstruct(const Tensor &core, const std::vector<Tensor> &transforms, size_t nthreads = 1) {
+  std::vector<size_t> dims;
+  for (auto &U : transforms) dims.push_back(U.extent(0));
+  Tensor A{btas::Range(dims)};
+  auto *data = A.data();
+  tucker_reconstruct_blocked(
+      core, transforms,
+      [data](size_t first, size_t count, const typename Tensor::value_type *block) {
+        std::copy(block, block + count, data + first);
+      },
+      size_t(1) << 20, nthreads);
+  return A;
+}
+
 } // namespace btas
 #endif // BTAS_TUCKER_DECOMP_H
@@ -1,5 +1,8 @@
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <libgen.h>
 
 #include "test.h"
 
@@ -119,3 +122,51 @@ TEST_CASE("performance") {
   }
 
 }
+
+#ifdef BTAS_HAS_CBLAS
+/// Times \c call and prints the time with the fit it returns
+#define BTAS_PROFILE_CP(name, call)                                          \
+  {                                                                          \
+    TimerPool<> timer;                                                       \
+    timer.start();                                                           \
+    auto fit = (call);                                                       \
+    timer.stop();                                                            \
+    std::cout << name << ": " << std::scientific << timer.read()             \
+              << " seconds, fit = " << std::fixed << fit << std::endl;       \
+  }
+
+TEST_CASE("CP solver performance") {
+  typedef btas::Tensor<double> tensor;
+  using conv_class = btas::FitCheck<tensor>;
+  const std::string dirname = ::dirname(strdup(__FILE__));
+
+  std::vector<tensor> tensors{tensor(5, 2, 9), tensor(6, 3, 3, 7), tensor(2, 6, 1, 9, 3)};
+  std::vector<std::string> files{"/mat3D.txt", "/mat4D.txt", "/mat5D.txt"};
+  for (size_t t = 0; t < tensors.size(); ++t) {
+    std::ifstream in(dirname + files[t]);
+    REQUIRE(in.is_open());
+    for (auto &i : tensors[t]) in >> i;
+  }
+
+  for (auto &T : tensors) {
+    double norm = sqrt(dot(T, T));
+    for (size_t rank : {5, 10}) {
+      std::cout << "order " << T.rank() << ", rank " << rank << std::endl;
+      conv_class conv(1e-6);
+      conv.set_norm(norm);
+      {
+        btas::CP_ALS<tensor, conv_class> A(T);
+        BTAS_PROFILE_CP("  CP_ALS ", A.compute_rank_random(rank, conv, 1e4));
+      }
+      {
+        btas::CP_RALS<tensor, conv_class> A(T);
+        BTAS_PROFILE_CP("  CP_RALS", A.compute_rank_random(rank, conv, 1e4));
+      }
+      {
+        btas::CP_GN<tensor, conv_class> A(T);
+        BTAS_PROFILE_CP("  CP_GN  ", A.compute_rank_random(rank, conv, 1e4));
+      }
+    }
+  }
+}
+#endif // BTAS_HAS_CBLAS
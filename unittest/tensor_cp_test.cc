@@ -3,14 +3,38 @@
 #include <btas/generic/converge_class.h>
 #include "../unittest/test.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
+#include <sstream>
 
 #include <libgen.h>
+#include <unistd.h>
 
 const std::string __dirname = dirname(strdup(__FILE__));
 
+// A tensor of CP rank 2 with extents dims, element i of column k of the factor
+// of mode n is normal variate 100 k + 10 n + i of CounterRNG(5, 0)
+static btas::Tensor<double> rank2_tensor(const std::vector<size_t> &dims) {
+  typedef btas::Tensor<double> tensor;
+  btas::CounterRNG rng(5, 0);
+  std::vector<tensor> A;
+  for (size_t n = 0; n < dims.size(); ++n) {
+    tensor a(dims[n], 2);
+    for (size_t i = 0; i < dims[n]; ++i)
+      for (size_t k = 0; k < 2; ++k) a(i, k) = rng.normal(100 * k + 10 * n + i)[0];
+    A.push_back(a);
+  }
+  tensor lambda(2);
+  lambda.fill(1.0);
+  A.push_back(lambda);
+  std::vector<size_t> order(dims.size());
+  std::iota(order.begin(), order.end(), 0);
+  return btas::reconstruct(A, order);
+}
+
 TEST_CASE("CP")
 {
   typedef btas::Tensor<double> tensor;
@@ -19,6 +43,8 @@ TEST_CASE("CP")
   using btas::CP_ALS;
   using btas::CP_RALS;
   using btas::CP_DF_ALS;
+  using btas::CP_ARLS;
+  using btas::CP_GN;
   using btas::COUPLED_CP_ALS;
 
   //double epsilon = fmax(1e-10, std::numeric_limits<double>::epsilon());
@@ -134,6 +160,26 @@ TEST_CASE("CP")
       double diff = A1.compress_compute_rand(3, conv, 0, 2, 1, true, false, 20, true);
       CHECK((diff - results(7,0)) <= epsilon);
     }
+    SECTION("ALS MODE = 4, Line search"){
+      CP_ALS<tensor, conv_class> A0(D4), A1(D4);
+      conv_class conv0(1e-6), conv_ls(1e-6);
+      conv0.set_norm(norm4);
+      conv_ls.set_norm(norm4);
+      double fit0 = A0.compute_rank_random(10, conv0, 1000);
+      A1.set_line_search(3);
+      double fit = A1.compute_rank_random(10, conv_ls, 1000);
+      auto diff = A1.reconstruct() - D4;
+      CHECK(std::abs(fit - (1 - sqrt(dot(diff, diff)) / norm4)) <= epsilon);
+      CHECK(fit > fit0 - 1e-3);
+      CHECK(A1.get_num_ALS() < A0.get_num_ALS());
+
+      // The loss needs the MTTKRP of the last mode, a symmetric last mode is rejected
+      tensor S(3, 4, 4);
+      S.fill(1.0);
+      std::vector<size_t> symms{0, 1, 1};
+      CP_ALS<tensor, conv_class> A2(S, symms);
+      CHECK_THROWS(A2.set_line_search(3));
+    }
     SECTION("ALS MODE = 5, Finite rank"){
       CP_ALS<tensor, conv_class> A1(D5);
       conv.set_norm(norm5);
@@ -285,6 +331,95 @@ TEST_CASE("CP")
       CHECK((diff - results(29,0)) <= epsilon);
     }
   }
+  // ARLS tests
+  // The sampled solver has no reference values. With enough sampled rows each
+  // least squares update is within (1 + eps) of the exact residual, so the fit
+  // averaged over several seeds must reach 1 - (1 + eps) (1 - fit) of the
+  // rank 5 ALS fit, eps = 0.1. The exact fit reported must match the reconstruction.
+  {
+    auto check_arls = [&](const tensor &D, double normD, btas::ARLSSampling sampling) {
+      CP_ALS<tensor, conv_class> A0(D);
+      conv_class conv_als(1e-3);
+      conv_als.set_norm(normD);
+      A0.compute_rank_random(5, conv_als, 100);
+      auto diff0 = A0.reconstruct() - D;
+      double fit_als = 1 - sqrt(dot(diff0, diff0)) / normD;
+
+      auto seed = btas::random_seed_accessor();
+      size_t nseeds = 5;
+      double mean_fit = 0.0;
+      for (size_t s = 0; s < nseeds; ++s) {
+        btas::random_seed_accessor() = seed + s;
+        CP_ARLS<tensor, conv_class> A1(D);
+        conv_class conv_arls(1e-3);
+        conv_arls.set_norm(normD);
+        A1.set_sampling(sampling);
+        double fit = A1.compute_rank_random(5, conv_arls, 100);
+        auto diff = A1.reconstruct() - D;
+        CHECK(std::abs(fit - (1 - sqrt(dot(diff, diff)) / normD)) <= epsilon);
+        mean_fit += fit / nseeds;
+      }
+      btas::random_seed_accessor() = seed;
+      CHECK(mean_fit >= 1 - 1.1 * (1 - fit_als));
+    };
+    SECTION("ARLS MODE = 3, Uniform sampling"){
+      check_arls(D3, norm3, btas::ARLSSampling::uniform);
+    }
+    SECTION("ARLS MODE = 4, Leverage sampling"){
+      check_arls(D4, norm4, btas::ARLSSampling::leverage);
+    }
+    SECTION("ARLS MODE = 4, Seeded factors"){
+      // Without sweeps the model is the seeded one
+      CP_ALS<tensor, conv_class> A0(D4);
+      conv_class conv_als(1e-3), conv_arls(1e-3);
+      conv_als.set_norm(norm4);
+      conv_arls.set_norm(norm4);
+      A0.compute_rank_random(5, conv_als, 100);
+      CP_ARLS<tensor, conv_class> A1(D4), A2(D4);
+      A1.set_factor_matrices(A0.get_factor_matrices());
+      A1.compute_rank_random(5, conv_arls, 0);
+      auto diff = A1.reconstruct() - A0.reconstruct();
+      CHECK(sqrt(dot(diff, diff)) <= epsilon * norm4);
+      A2.set_factor_matrices(A0.get_factor_matrices());
+      CHECK_THROWS(A2.compute_rank_random(4, conv_arls, 0));
+    }
+  }
+  // Gauss-Newton tests
+  // No reference values, check the fit against the reconstructed tensor
+  {
+    SECTION("GN MODE = 4, Finite rank"){
+      CP_GN<tensor, conv_class> A1(D4);
+      conv_class conv_gn(1e-6);
+      conv_gn.set_norm(norm4);
+      double fit = A1.compute_rank_random(10, conv_gn, 1000);
+      auto diff = A1.reconstruct() - D4;
+      CHECK(std::abs(fit - (1 - sqrt(dot(diff, diff)) / norm4)) <= epsilon);
+      CHECK(fit > 0.72);
+    }
+    SECTION("GN MODE = 5, Finite rank"){
+      CP_GN<tensor, conv_class> A1(D5);
+      conv_class conv_gn(1e-6);
+      conv_gn.set_norm(norm5);
+      double fit = A1.compute_rank_random(5, conv_gn, 1000);
+      auto diff = A1.reconstruct() - D5;
+      CHECK(std::abs(fit - (1 - sqrt(dot(diff, diff)) / norm5)) <= epsilon);
+      CHECK(fit > 0.6);
+    }
+    SECTION("GN MODE = 4, Seeded factors"){
+      CP_ALS<tensor, conv_class> A0(D4);
+      conv_class conv_als(1e-3), conv_gn(1e-6);
+      conv_als.set_norm(norm4);
+      conv_gn.set_norm(norm4);
+      A0.compute_rank_random(5, conv_als, 100);
+      CP_GN<tensor, conv_class> A1(D4), A2(D4);
+      A1.set_factor_matrices(A0.get_factor_matrices());
+      A1.compute_rank_random(5, conv_gn, 0);
+      auto diff = A1.reconstruct() - A0.reconstruct();
+      CHECK(sqrt(dot(diff, diff)) <= epsilon * norm4);
+      A2.set_factor_matrices(A0.get_factor_matrices());
+      CHECK_THROWS(A2.compute_rank_random(4, conv_gn, 0));
+    }
+  }
   // coupled ALS test
   {
     SECTION("COUPLED-ALS MODE = 3, Finite rank"){
@@ -330,5 +465,629 @@ TEST_CASE("CP")
       CHECK((diff - results(35,0)) <= epsilon);
     }
   }
+  // ALS normal equation solvers
+  {
+    SECTION("SPD solve"){
+      // V = W^T W is positive definite, X = B V^{-1}
+      tensor W(4, 3), V(3, 3), X(2, 3), B(2, 3);
+      W.generate([](){ static double x = 0.1; x += 0.37; return x - std::floor(x); });
+      X.generate([](){ static double x = 0.2; x += 0.61; return x - std::floor(x); });
+      gemm(CblasTrans, CblasNoTrans, 1.0, W, W, 0.0, V);
+      gemm(CblasNoTrans, CblasNoTrans, 1.0, X, V, 0.0, B);
+
+      btas::SPDSolveCounter counter;
+      auto sol = B;
+      btas::spd_solve(V, sol, counter);
+      CHECK(counter.cholesky == 1);
+      for (size_t i = 0; i < X.size(); ++i) CHECK(std::abs(sol.data()[i] - X.data()[i]) <= epsilon);
+
+      // A rank deficient Gram matrix falls through to the eigenvalue pseudo-inverse
+      for (size_t i = 0; i < W.extent(0); ++i) W(i, 2) = W(i, 0) + W(i, 1);
+      gemm(CblasTrans, CblasNoTrans, 1.0, W, W, 0.0, V);
+      gemm(CblasNoTrans, CblasNoTrans, 1.0, X, V, 0.0, B);
+      sol = B;
+      btas::spd_solve(V, sol, counter);
+      CHECK(counter.cholesky == 1);
+      CHECK(counter.ldlt == 0);
+      CHECK(counter.eigen == 1);
+      tensor BV(2, 3);
+      gemm(CblasNoTrans, CblasNoTrans, 1.0, sol, V, 0.0, BV);
+      for (size_t i = 0; i < B.size(); ++i) CHECK(std::abs(BV.data()[i] - B.data()[i]) <= epsilon);
+
+      // In single precision the default tolerance scales with the float epsilon,
+      // the rank deficient Gram matrix is truncated to the minimum norm solution
+      using ftensor = btas::Tensor<float>;
+      ftensor Wf(4, 3), Vf(3, 3), Bf(2, 3);
+      std::copy(W.begin(), W.end(), Wf.begin());
+      std::copy(B.begin(), B.end(), Bf.begin());
+      gemm(CblasTrans, CblasNoTrans, 1.0, Wf, Wf, 0.0, Vf);
+      btas::SPDSolveCounter fcounter;
+      auto solf = Bf;
+      btas::spd_solve(Vf, solf, fcounter);
+      CHECK(fcounter.eigen == 1);
+      for (size_t i = 0; i < solf.extent(0); ++i) CHECK(std::abs(solf(i, 0) + solf(i, 1) - solf(i, 2)) <= 1e-4);
+      ftensor BVf(2, 3);
+      gemm(CblasNoTrans, CblasNoTrans, 1.0, solf, Vf, 0.0, BVf);
+      for (size_t i = 0; i < Bf.size(); ++i) CHECK(std::abs(BVf.data()[i] - Bf.data()[i]) <= 1e-4 * std::abs(Bf.data()[i]) + 1e-4);
+    }
+    SECTION("ALS MODE = 3, Shared const reference"){
+      const tensor d = D3;
+      CP_ALS<tensor, conv_class> A1(d), A2(d);
+      conv.set_norm(norm3);
+      double diff =
+              A1.compress_compute_tucker(0.1, conv, 5, true, false, 100, true);
+      CHECK((diff - results(2,0)) <= epsilon);
+      CHECK(std::equal(d.begin(), d.end(), D3.begin()));
+      // The sweeps of the nested core solver are counted
+      CHECK(A1.get_num_ALS() > 0);
+      diff = A2.compute_rank(5, conv, 1, false, 0, 100, false, false, true);
+      CHECK((diff - results(0,0)) <= epsilon);
+
+      // The in place MTTKRP agrees with the elementwise sum over the tensor
+      std::vector<tensor> factors;
+      for (size_t n = 0; n < D4.rank(); ++n) {
+        factors.push_back(tensor(D4.extent(n), 3));
+        factors.back().generate([](){ static double x = 0.3; x += 0.57; return x - std::floor(x); });
+      }
+      for (size_t n = 0; n < D4.rank(); ++n) {
+        tensor ref(D4.extent(n), 3);
+        ref.fill(0.0);
+        std::vector<size_t> idx(D4.rank(), 0);
+        for (size_t e = 0; e < D4.size(); ++e) {
+          for (size_t r = 0; r < 3; ++r) {
+            double p = D4.data()[e];
+            for (size_t k = 0; k < D4.rank(); ++k)
+              if (k != n) p *= factors[k](idx[k], r);
+            ref(idx[n], r) += p;
+          }
+          for (size_t k = D4.rank(); k > 0 && ++idx[k - 1] == D4.extent(k - 1); --k) idx[k - 1] = 0;
+        }
+        auto M = btas::detail::mttkrp_matricized(D4, factors, n);
+        M -= ref;
+        CHECK(std::sqrt(dot(M, M) / dot(ref, ref)) <= epsilon);
+      }
+    }
+    SECTION("ALS batch"){
+      std::vector<tensor> tensors{D3, D4, D5, D3};
+      std::vector<btas::CPBatchOptions<tensor>> options(4);
+      for (auto &opt : options) opt.max_als = 100;
+      options[0].rank = 5; options[1].rank = 5; options[2].rank = 3; options[3].rank = 2;
+      auto batch = btas::cp_als_batch(tensors, options, 2);
+      REQUIRE(batch.size() == 4);
+      for (size_t t = 0; t < tensors.size(); ++t) {
+        CP_ALS<tensor, conv_class> A1(tensors[t]);
+        conv_class conv_t(options[t].tol);
+        conv_t.set_norm(sqrt(dot(tensors[t], tensors[t])));
+        double fit = A1.compute_rank_random(options[t].rank, conv_t, options[t].max_als);
+        CHECK(batch[t].error.empty());
+        CHECK(std::abs(batch[t].fit - fit) <= epsilon);
+        CHECK(batch[t].iterations == A1.get_num_ALS());
+        auto factors = A1.get_factor_matrices();
+        for (size_t i = 0; i < factors.size(); ++i)
+          CHECK(std::equal(factors[i].begin(), factors[i].end(), batch[t].factors[i].begin()));
+      }
+    }
+    SECTION("ALS rank search"){
+      auto search = btas::cp_rank_search(D4, 0.3, 30, 2, 1e-3, 100);
+      CHECK(search.epsilon <= 0.3);
+      CHECK(search.rounds < search.rank);
+      // The next smaller rank must miss the cut, it only exists above rank 1
+      REQUIRE(search.rank >= 2);
+      CP_ALS<tensor, conv_class> A1(D4);
+      conv.set_norm(norm4);
+      CHECK(1.0 - A1.compute_rank_random(search.rank - 1, conv, 100) > 0.3);
+      auto diff = btas::reconstruct(search.factors, {0, 1, 2, 3}) - D4;
+      CHECK(std::abs(search.epsilon - sqrt(dot(diff, diff)) / norm4) <= 1e-3);
+    }
+    SECTION("ALS checkpoint and resume"){
+      conv_class conv1(1e-12), conv2(1e-12), conv3(1e-12);
+      conv1.set_norm(norm4); conv2.set_norm(norm4); conv3.set_norm(norm4);
+      char file[] = "/tmp/btas_cp_checkpoint_XXXXXX";
+      int fd = mkstemp(file);
+      REQUIRE(fd != -1);
+      close(fd);
+      CP_ALS<tensor, conv_class> A1(D4);
+      A1.set_checkpoint(file, 5);
+      A1.compute_rank_random(5, conv1, 10);
+
+      CP_ALS<tensor, conv_class> A2(D4), A3(D4);
+      A2.resume(file);
+      // Solvers which do not continue from a checkpoint reject it
+      CP_ARLS<tensor, conv_class> A4(D4);
+      CP_GN<tensor, conv_class> A5(D4);
+      CHECK_THROWS(A4.resume(file));
+      CHECK_THROWS(A5.set_checkpoint(file, 5));
+      std::remove(file);
+      CHECK(A2.get_num_ALS() == 10);
+      CHECK(A2.get_fit_history().size() == 10);
+      double fit = A2.compute_rank_random(5, conv2, 20);
+      CHECK(A2.get_num_ALS() == 20);
+      CHECK(std::abs(fit - A3.compute_rank_random(5, conv3, 20)) <= epsilon);
+      auto f2 = A2.get_factor_matrices(), f3 = A3.get_factor_matrices();
+      for (size_t i = 0; i < f2.size(); ++i) {
+        auto diff = f2[i] - f3[i];
+        CHECK(sqrt(dot(diff, diff)) <= epsilon);
+      }
+    }
+    SECTION("ALS observer"){
+      conv_class conv1(1e-3), conv2(1e-3);
+      conv1.set_norm(norm3); conv2.set_norm(norm3);
+      btas::CPRecorder recorder;
+      CP_ALS<tensor, conv_class> A1(D3), A2(D3);
+      A1.set_observer(&recorder);
+      double fit = A1.compute_rank_random(5, conv1, 100);
+      CHECK(std::abs(fit - A2.compute_rank_random(5, conv2, 100)) <= epsilon);
+      size_t sweeps = A1.get_num_ALS();
+      REQUIRE(recorder.sweeps().size() == sweeps);
+      REQUIRE(recorder.modes().size() == 3 * sweeps);
+      CHECK(recorder.sweeps().back().fit == fit);
+      for (auto &m : recorder.modes()) {
+        CHECK(std::string(m.solver) == "svd");
+        CHECK(m.stats.flops[static_cast<size_t>(btas::CPPhase::mttkrp)] == 2.0 * 5 * D3.size());
+      }
+      CHECK(recorder.sweeps().front().solves.svd == 3);
+      std::ostringstream csv, json;
+      recorder.write_csv(csv);
+      recorder.write_json(json);
+      auto lines = csv.str();
+      CHECK(std::count(lines.begin(), lines.end(), '\n') == 4 * sweeps + 1);
+      CHECK(json.str().find("\"sweeps\":[{\"sweep\":1,") != std::string::npos);
+      CHECK(json.str().find("\"svd\":3,\"fast_pinv\":0}") != std::string::npos);
+
+      // Gauss-Newton reports every step as a sweep
+      conv_class conv_gn(1e-6);
+      conv_gn.set_norm(norm3);
+      CP_GN<tensor, conv_class> A3(D3);
+      recorder.clear();
+      A3.set_observer(&recorder);
+      A3.compute_rank_random(5, conv_gn, 50);
+      CHECK(recorder.sweeps().size() == A3.get_num_ALS());
+      CHECK(recorder.modes().empty());
+      // one solve per mode for the preconditioner
+      auto &solves = recorder.sweeps().back().solves;
+      CHECK(solves.cholesky + solves.ldlt + solves.eigen == 3);
+    }
+    SECTION("ALS MODE = 3, Single and mixed precision"){
+      using ftensor = btas::Tensor<float>;
+      ftensor F3(D3.range());
+      std::copy(D3.begin(), D3.end(), F3.begin());
+      conv.set_norm(norm3);
+      CP_ALS<tensor, conv_class> A1(D3);
+      double fit = A1.compute_rank_random(5, conv, 100, true);
+      double error[2];
+      for (bool mixed : {false, true}) {
+        btas::FitCheck<ftensor> fconv(1e-3);
+        fconv.set_norm(norm3);
+        CP_ALS<ftensor, btas::FitCheck<ftensor>> A2(F3);
+        A2.set_mixed_precision(mixed);
+        error[mixed] = std::abs(A2.compute_rank_random(5, fconv, 100, true) - fit);
+        CHECK(error[mixed] <= 1e-4);
+        CHECK(A2.get_solve_counter().cholesky > 0);
+      }
+      CHECK(error[1] <= error[0]);
+    }
+    SECTION("ALS MODE = 3, Complex"){
+      using ctensor = btas::Tensor<std::complex<double>>;
+      std::mt19937 gen(3);
+      std::uniform_real_distribution<double> dist(-1.0, 1.0);
+      std::vector<ctensor> factors;
+      for (size_t i = 0; i < 3; ++i) {
+        factors.push_back(ctensor(5 + i, 3));
+        for (auto &x : factors.back()) x = std::complex<double>(dist(gen), dist(gen));
+      }
+      factors.push_back(ctensor(3));
+      factors.back().fill(1.0);
+      auto C3 = btas::reconstruct(factors, {0, 1, 2});
+      double cnorm = std::sqrt(std::abs(btas::dot(C3, C3)));
+      btas::FitCheck<ctensor> cconv(1e-8);
+      cconv.set_norm(cnorm);
+      CP_ALS<ctensor, btas::FitCheck<ctensor>> A1(C3);
+      CHECK(std::abs(A1.compute_rank_random(3, cconv, 500) - 1.0) <= epsilon);
+      auto diff = A1.reconstruct() - C3;
+      CHECK(std::sqrt(std::abs(btas::dot(diff, diff))) / cnorm <= 1e-6);
+      CP_RALS<ctensor, btas::FitCheck<ctensor>> A2(C3);
+      CHECK(std::abs(A2.compute_rank_random(3, cconv, 500) - 1.0) <= epsilon);
+    }
+    SECTION("ALS MODE = 3, Packed symmetric pair"){
+      tensor S3(D3.extent(0), D3.extent(2), D3.extent(2));
+      S3.fill(0.0);
+      for (size_t a = 0; a < D3.extent(0); ++a)
+        for (size_t j = 0; j < D3.extent(1); ++j)
+          for (size_t b = 0; b < D3.extent(2); ++b)
+            for (size_t c = 0; c < D3.extent(2); ++c) S3(a, b, c) += D3(a, j, b) * D3(a, j, c);
+      std::vector<size_t> symms = {0, 1, 1};
+      conv.set_norm(sqrt(dot(S3, S3)));
+      CP_ALS<tensor, conv_class> A1(S3, symms);
+      double fit = A1.compute_rank_random(5, conv, 100);
+      CP_ALS<tensor, conv_class> A2(S3, symms);
+      A2.set_symmetric_packing(true);
+      CHECK(std::abs(A2.compute_rank_random(5, conv, 100) - fit) <= epsilon);
+      CP_ALS<tensor, conv_class> A3(D3);
+      CHECK_THROWS(A3.set_symmetric_packing(true));
+    }
+    SECTION("Tucker MODE = 6, Sequential truncation"){
+      std::vector<tensor> transforms, seq_transforms;
+      tensor core, seq_core;
+      btas::tucker_compression(D44, 0.3, transforms, core);
+      btas::tucker_compression(D44, 0.3, seq_transforms, seq_core, true);
+      // Every discarded eigenvalue is below 0.3^2 ||D44||^2 / ndim
+      double discarded = 0;
+      for (size_t i = 0; i < D44.rank(); ++i) {
+        CHECK(seq_core.extent(i) <= core.extent(i));
+        discarded += D44.extent(i) - seq_core.extent(i);
+      }
+      // The factors are orthonormal, the truncation error is the norm lost by the core
+      double error = (norm42 * norm42 - dot(seq_core, seq_core)) / (norm42 * norm42);
+      CHECK(error <= discarded * 0.3 * 0.3 / D44.rank());
+    }
+    SECTION("Tucker MODE = 3, Complex"){
+      // A complex tensor of multilinear rank (2, 3, 2), the mode Gram matrices are formed with HERK
+      using ctensor = btas::Tensor<std::complex<double>>;
+      std::mt19937 gen(5);
+      std::uniform_real_distribution<double> dist(-1.0, 1.0);
+      auto random = [&](ctensor t) {
+        for (auto &x : t) x = std::complex<double>(dist(gen), dist(gen));
+        return t;
+      };
+      ctensor G = random(ctensor(2, 3, 2)), U0 = random(ctensor(4, 2)), U1 = random(ctensor(5, 3)),
+              U2 = random(ctensor(6, 2));
+      auto expand = [](const ctensor &C, const ctensor &V0, const ctensor &V1, const ctensor &V2) {
+        ctensor X(V0.extent(0), V1.extent(0), V2.extent(0));
+        X.fill(0.0);
+        for (size_t i = 0; i < X.extent(0); ++i)
+          for (size_t j = 0; j < X.extent(1); ++j)
+            for (size_t k = 0; k < X.extent(2); ++k)
+              for (size_t a = 0; a < C.extent(0); ++a)
+                for (size_t b = 0; b < C.extent(1); ++b)
+                  for (size_t c = 0; c < C.extent(2); ++c) X(i, j, k) += C(a, b, c) * V0(i, a) * V1(j, b) * V2(k, c);
+        return X;
+      };
+      auto C3 = expand(G, U0, U1, U2);
+      double cnorm = std::sqrt(std::abs(btas::dot(C3, C3)));
+      for (bool sequential : {false, true}) {
+        std::vector<ctensor> transforms;
+        ctensor core;
+        btas::tucker_compression(C3, 1e-6, transforms, core, sequential);
+        CHECK(core.extent(0) == 2);
+        CHECK(core.extent(1) == 3);
+        CHECK(core.extent(2) == 2);
+        auto diff = expand(core, transforms[0], transforms[1], transforms[2]) - C3;
+        CHECK(std::sqrt(std::abs(btas::dot(diff, diff))) / cnorm <= 1e-10);
+      }
+
+      // HOOI of a noisy copy at multilinear rank (2, 3, 2), the error it returns
+      // is the one of the reconstruction and does not exceed the ST-HOSVD error
+      ctensor noisy = random(ctensor(4, 5, 6));
+      for (size_t i = 0; i < noisy.size(); ++i) noisy.data()[i] = C3.data()[i] + 1e-2 * noisy.data()[i];
+      double nnorm = std::sqrt(std::abs(btas::dot(noisy, noisy)));
+      std::vector<ctensor> transforms;
+      ctensor core;
+      btas::tucker_compression(noisy, 0.05, transforms, core, true);
+      CHECK(core.extent(0) == 2);
+      CHECK(core.extent(1) == 3);
+      CHECK(core.extent(2) == 2);
+      auto diff = expand(core, transforms[0], transforms[1], transforms[2]) - noisy;
+      double hosvd_error = std::sqrt(std::abs(btas::dot(diff, diff))) / nnorm;
+      double error = btas::tucker_hooi(noisy, 0.05, transforms, core, 10);
+      diff = expand(core, transforms[0], transforms[1], transforms[2]) - noisy;
+      CHECK(std::abs(error - std::sqrt(std::abs(btas::dot(diff, diff))) / nnorm) <= 1e-8);
+      CHECK(error <= hosvd_error + epsilon);
+    }
+    SECTION("Tucker MODE = 6, HOOI"){
+      std::vector<tensor> transforms;
+      tensor core;
+      btas::tucker_compression(D44, 0.3, transforms, core, true);
+      double hosvd_error = sqrt(1.0 - dot(core, core) / (norm42 * norm42));
+      auto threaded_transforms = transforms;
+      double error = btas::tucker_hooi(D44, 0.3, transforms, core, 10);
+      CHECK(error <= hosvd_error + epsilon);
+      tensor threaded_core;
+      CHECK(std::abs(btas::tucker_hooi(D44, 0.3, threaded_transforms, threaded_core, 10, 1e-10, 2) - error) <= epsilon);
+
+      CP_ALS<tensor, conv_class> A1(D4);
+      conv.set_norm(norm4);
+      A1.set_tucker_hooi(5, 2);
+      double diff = A1.compress_compute_tucker(0.1, conv, 5, true, false, 1e4, true);
+      CHECK((diff - results(6,0)) <= epsilon);
+    }
+    SECTION("Mode-n Gram matrix"){
+      for (size_t i = 0; i < D5.rank(); ++i) {
+        auto flat = flatten(D5, i);
+        tensor S(flat.extent(0), flat.extent(0)), G;
+        gemm(CblasNoTrans, CblasTrans, 1.0, flat, flat, 0.0, S);
+        btas::mode_gram(D5, i, G);
+        S -= G;
+        CHECK(sqrt(dot(S, S)) <= epsilon);
+      }
+    }
+    SECTION("Flatten and fold"){
+      auto flat = flatten(D3, 1);
+      bool same = true;
+      for (size_t a = 0; a < D3.extent(0); ++a)
+        for (size_t b = 0; b < D3.extent(1); ++b)
+          for (size_t c = 0; c < D3.extent(2); ++c) same = same && flat(b, a + D3.extent(0) * c) == D3(a, b, c);
+      CHECK(same);
+      for (size_t i = 0; i < D5.rank(); ++i) {
+        for (size_t nthreads : {1, 3}) {
+          auto folded = btas::fold(flatten(D5, i, nthreads), i, D5.range(), nthreads);
+          CHECK(std::equal(D5.begin(), D5.end(), folded.begin()));
+        }
+      }
+    }
+    SECTION("Counter based random fill"){
+      // Known answer of Philox4x32-10
+      auto bits = btas::CounterRNG(0, 0)(0);
+      CHECK(bits[0] == 0x6627e8d5u);
+      CHECK(bits[3] == 0x9b00dbd8u);
+
+      tensor X(200, 100), Y(200, 100), Z(200, 100);
+      btas::fill_random_normal(X, 0.0, 1.0, 3, 0);
+      btas::fill_random_normal(Y, 0.0, 1.0, 3, 0, 4);
+      btas::fill_random_normal(Z, 0.0, 1.0, 3, 1);
+      CHECK(std::equal(X.begin(), X.end(), Y.begin()));
+      CHECK(!std::equal(X.begin(), X.end(), Z.begin()));
+      double mean = std::accumulate(X.begin(), X.end(), 0.0) / X.size();
+      CHECK(std::abs(mean) < 0.02);
+      CHECK(std::abs(dot(X, X) / X.size() - 1.0) < 0.03);
+
+      CP_ALS<tensor, conv_class> A1(D4), A2(D4);
+      conv.set_norm(norm4);
+      A1.set_parallel_random(1);
+      A2.set_parallel_random(3);
+      double fit = A1.compute_rank_random(5, conv, 100);
+      CHECK(std::abs(A2.compute_rank_random(5, conv, 100) - fit) <= epsilon);
+    }
+    SECTION("Randomized compression, Structured sketches"){
+      // A rank 2 tensor, every sketch must capture its mode-n ranges
+      auto T = rank2_tensor({6, 7, 8});
+      double normT = dot(T, T);
+      for (auto sketch : {btas::Sketch::gaussian, btas::Sketch::srht, btas::Sketch::sparse_sign,
+                          btas::Sketch::tensor_sketch}) {
+        std::vector<tensor> transforms, threaded_transforms;
+        tensor core, threaded_core;
+        btas::randomized_decomposition(T, core, transforms, 2, 2, 1, 1, sketch);
+        btas::randomized_decomposition(T, threaded_core, threaded_transforms, 2, 2, 1, 3, sketch);
+        CHECK(std::abs(normT - dot(core, core)) / normT <= epsilon);
+        CHECK(std::equal(core.begin(), core.end(), threaded_core.begin()));
+      }
+    }
+    SECTION("Tucker MODE = 4, Single pass streaming"){
+      // A rank 2 tensor is recovered from its sketches
+      auto T = rank2_tensor({6, 7, 8, 5});
+      double normT = dot(T, T);
+      for (auto sketch : {btas::Sketch::gaussian, btas::Sketch::sparse_sign, btas::Sketch::tensor_sketch}) {
+        std::vector<tensor> transforms, slab_transforms;
+        tensor core, slab_core;
+        btas::streaming_tucker(T, 2, core, transforms, 0, sketch);
+        CHECK(std::abs(normT - dot(core, core)) / normT <= epsilon);
+
+        // Slabs of two rows arriving out of order
+        btas::StreamingTucker<tensor> stream(T.range(), 2, 0, sketch, 3);
+        size_t row_size = T.size() / T.extent(0);
+        for (size_t first : {4, 0, 2}) stream.update(T.data() + first * row_size, 2, first);
+        stream.finalize(slab_core, slab_transforms);
+        slab_core -= core;
+        CHECK(sqrt(dot(slab_core, slab_core) / normT) <= epsilon);
+      }
+    }
+    SECTION("Tensor train MODE = 6, TT-SVD and rounding"){
+      // An order 6 tensor train of TT rank 2
+      std::vector<tensor> X;
+      size_t dims[6] = {3, 4, 2, 5, 3, 4};
+      for (size_t n = 0; n < 6; ++n) {
+        tensor G(n ? 2 : 1, dims[n], n < 5 ? 2 : 1);
+        btas::fill_random_normal(G, 0.0, 1.0, 3, n);
+        X.push_back(G);
+      }
+      auto T = btas::tt_reconstruct(X);
+      double normT = sqrt(dot(T, T));
+      CHECK(std::abs(btas::tt_norm(X) - normT) / normT <= epsilon);
+      // A train cut after its fifth core has a trailing rank of 2
+      std::vector<tensor> head(X.begin(), X.begin() + 5);
+      CHECK_THROWS(btas::tt_reconstruct(head));
+
+      std::vector<tensor> cores;
+      CHECK(btas::tt_svd(T, 1e-10, cores) <= 1e-10);
+      for (size_t n = 0; n + 1 < cores.size(); ++n) CHECK(cores[n].extent(2) == 2);
+      auto diff = btas::tt_reconstruct(cores) - T;
+      CHECK(sqrt(dot(diff, diff)) / normT <= epsilon);
+
+      // The exact TT-SVD has full ranks, rounding recovers the TT rank
+      std::vector<tensor> full;
+      btas::tt_svd(T, 0.0, full);
+      CHECK(full[2].extent(2) > 2);
+      btas::tt_round(full, 1e-10);
+      for (size_t n = 0; n + 1 < full.size(); ++n) CHECK(full[n].extent(2) == 2);
+      CHECK(std::abs(btas::tt_dot(full, X) - normT * normT) / (normT * normT) <= epsilon);
+
+      // A rank limit bounds the error by the discarded singular values
+      std::vector<tensor> limited;
+      double error = btas::tt_svd(T, 0.0, limited, 1);
+      diff = btas::tt_reconstruct(limited) - T;
+      CHECK(sqrt(dot(diff, diff)) / normT <= error + epsilon);
+    }
+    SECTION("CP format operations"){
+      // A rank 3 model of the dimensions of D4 and a rank 2 model
+      std::vector<tensor> A, B;
+      for (size_t n = 0; n < 4; ++n) {
+        tensor a(D4.extent(n), 3), b(D4.extent(n), 2);
+        btas::fill_random_normal(a, 0.0, 1.0, 5, n);
+        btas::fill_random_normal(b, 0.0, 1.0, 7, n);
+        A.push_back(a);
+        B.push_back(b);
+      }
+      tensor la(3), lb(2);
+      btas::fill_random_uniform(la, 0.5, 1.5, 5, 4);
+      btas::fill_random_uniform(lb, 0.5, 1.5, 7, 4);
+      A.push_back(la);
+      B.push_back(lb);
+      std::vector<size_t> order = {0, 1, 2, 3};
+      auto MA = btas::reconstruct(A, order), MB = btas::reconstruct(B, order);
+      double normA = sqrt(dot(MA, MA));
+
+      CHECK(std::abs(btas::cp_norm(A) - normA) / normA <= epsilon);
+      CHECK(std::abs(btas::cp_dot(A, B) - dot(MA, MB)) / normA <= epsilon);
+      CHECK(std::abs(btas::cp_dot(A, D4) - dot(MA, D4)) / normA <= epsilon);
+      auto diff = D4 - MA;
+      CHECK(std::abs(btas::cp_residual_norm(D4, A) - sqrt(dot(diff, diff))) <= epsilon);
+      // The residual of a tensor of exact CP rank, and of a tensor 1e-9 |MA|
+      // away from it, where the expansion cancels
+      CHECK(btas::cp_residual_norm(MA, A) <= 1e-12 * normA);
+      {
+        tensor E(MA.range());
+        btas::fill_random_normal(E, 0.0, 1.0, 11);
+        scal(1e-9 * normA / sqrt(dot(E, E)), E);
+        tensor ME = MA + E;
+        CHECK(std::abs(btas::cp_residual_norm(ME, A) - 1e-9 * normA) <= 1e-12 * normA);
+      }
+      {
+        // The rank search stops at rank 3 only if the residual resolves 1e-9 |MA|
+        btas::NormCheck<tensor> norm_check(1e-12);
+        CP_ALS<tensor, btas::NormCheck<tensor>> A1(MA);
+        A1.compute_error(norm_check, 1e-9 * normA, 1, 5);
+        auto f1 = A1.get_factor_matrices();
+        CHECK(f1[0].extent(1) == 3);
+        auto diff1 = btas::reconstruct(f1, order) - MA;
+        CHECK(sqrt(dot(diff1, diff1)) <= 1e-9 * normA);
+      }
+
+      // Matrix times mode 2
+      tensor U(D4.extent(2), 5);
+      btas::fill_random_normal(U, 0.0, 1.0, 9);
+      tensor MU;
+      btas::contract(1.0, MA, {1, 2, 3, 4}, U, {3, 5}, 0.0, MU, {1, 2, 5, 4});
+      auto AU = btas::cp_ttm(A, U, 2);
+      diff = btas::reconstruct(AU, order) - MU;
+      CHECK(sqrt(dot(diff, diff)) / normA <= epsilon);
+
+      // Elements and a slice of mode 1
+      std::vector<size_t> idx = {4, 2, 1, 6};
+      CHECK(std::abs(btas::cp_element(A, idx) - MA(4, 2, 1, 6)) / normA <= epsilon);
+      auto S = btas::cp_slice(A, 1, 2);
+      std::vector<size_t> order3 = {0, 1, 2};
+      auto MS = btas::reconstruct(S, order3);
+      for (size_t i = 0; i < D4.extent(0); ++i)
+        for (size_t k = 0; k < D4.extent(3); ++k)
+          CHECK(std::abs(MS(i, 1, k) - MA(i, 2, 1, k)) / normA <= epsilon);
+      CHECK_THROWS(btas::cp_slice(A, 1, -1));
+      CHECK_THROWS(btas::cp_slice(A, 1, A[1].extent(0)));
+    }
+    SECTION("Blocked reconstruction"){
+      std::vector<tensor> A;
+      for (size_t n = 0; n < 4; ++n) {
+        tensor a(D4.extent(n), 3);
+        btas::fill_random_normal(a, 0.0, 1.0, 5, n);
+        A.push_back(a);
+      }
+      tensor lambda(3);
+      btas::fill_random_uniform(lambda, 0.5, 1.5, 5, 4);
+      A.push_back(lambda);
+      auto factors = A;
+
+      // Every element against the CP model, the factors are not modified
+      std::vector<size_t> order = {2, 0, 3, 1};
+      auto M = btas::reconstruct(A, order, 3, 7);
+      double normM = sqrt(dot(M, M));
+      for (size_t n = 0; n < A.size(); ++n) CHECK(A[n] == factors[n]);
+      double error = 0.0;
+      for (size_t i = 0; i < D4.extent(0); ++i)
+        for (size_t j = 0; j < D4.extent(1); ++j)
+          for (size_t k = 0; k < D4.extent(2); ++k)
+            for (size_t l = 0; l < D4.extent(3); ++l) {
+              std::vector<size_t> idx = {i, j, k, l};
+              error = std::max(error, std::abs(M(k, i, l, j) - btas::cp_element(A, idx)));
+            }
+      CHECK(error / normM <= epsilon);
+
+      // Small slabs on several threads cover the tensor once
+      tensor slabs(M.range());
+      slabs.fill(0.0);
+      btas::reconstruct_blocked(A, order, [&](size_t first, size_t count, const double *data) {
+        for (size_t i = 0; i < count; ++i) slabs.data()[first + i] += data[i];
+      }, 20, 3);
+      auto diff = slabs - M;
+      CHECK(sqrt(dot(diff, diff)) / normM <= epsilon);
+
+      // The Tucker model of D4 without truncation
+      std::vector<tensor> transforms;
+      tensor core;
+      btas::tucker_compression(D4, 0.0, transforms, core);
+      diff = btas::tucker_reconstruct(core, transforms) - D4;
+      CHECK(sqrt(dot(diff, diff)) / norm4 <= epsilon);
+      slabs = tensor(D4.range());
+      slabs.fill(0.0);
+      btas::tucker_reconstruct_blocked(core, transforms, [&](size_t first, size_t count, const double *data) {
+        for (size_t i = 0; i < count; ++i) slabs.data()[first + i] += data[i];
+      }, 30, 2);
+      diff = slabs - D4;
+      CHECK(sqrt(dot(diff, diff)) / norm4 <= epsilon);
+    }
+    SECTION("Convergence checks from solver intermediates"){
+      std::vector<tensor> A, AtA;
+      for (size_t n = 0; n < 3; ++n) {
+        tensor a(D3.extent(n), 4), g(4, 4);
+        btas::fill_random_normal(a, 0.0, 1.0, 11, n);
+        gemm(CblasTrans, CblasNoTrans, 1.0, a, a, 0.0, g);
+        A.push_back(a);
+        AtA.push_back(g);
+      }
+      tensor lambda(4);
+      btas::fill_random_uniform(lambda, 0.5, 1.5, 11, 3);
+      A.push_back(lambda);
+
+      // MTTKRP of the last mode
+      tensor MtKRP(D3.extent(2), 4);
+      MtKRP.fill(0.0);
+      for (size_t i = 0; i < D3.extent(0); ++i)
+        for (size_t j = 0; j < D3.extent(1); ++j)
+          for (size_t k = 0; k < D3.extent(2); ++k)
+            for (size_t r = 0; r < 4; ++r) MtKRP(k, r) += D3(i, j, k) * A[0](i, r) * A[1](j, r);
+      double fit = 1.0 - btas::cp_residual_norm(D3, A, norm3) / norm3;
+
+      // With the cached Gram matrices and with recomputed ones
+      for (size_t cached = 0; cached < 2; ++cached) {
+        btas::FitCheck<tensor> check(1e-4);
+        check.set_norm(norm3);
+        for (size_t sweep = 0; sweep < 2; ++sweep) {
+          check.set_MtKRP(MtKRP);
+          CHECK(!check(A, cached ? AtA : std::vector<tensor>()));
+          CHECK(std::abs(check.get_last_fit() - fit) <= epsilon);
+        }
+        CHECK(check(A, AtA));
+      }
+
+      btas::NormCheck<tensor> norm_check(1e-10);
+      CHECK(!norm_check(A));
+      CHECK(norm_check(A));
+      A[1](0, 0) += 1.0;
+      CHECK(!norm_check(A));
+    }
+    SECTION("DF-ALS MODE = 4, Generated connected tensor"){
+      CP_DF_ALS<tensor, conv_class> dense(D4, D4);
+      conv_class conv_dense(1e-3);
+      conv_dense.set_norm(norm42);
+      dense.compute_rank_random(5, conv_dense, 20, false, true);
+
+      // Z is generated from D4 in tiles of 2 rows, the cache holds 2 of the 3 tiles
+      std::vector<size_t> extents = {D4.extent(0), D4.extent(1), D4.extent(2), D4.extent(3)};
+      size_t generated = 0;
+      btas::DFTileSource<tensor> right(extents, [&](size_t first, size_t last, double *tile) {
+        size_t row = D4.size() / D4.extent(0);
+        std::copy(D4.data() + first * row, D4.data() + last * row, tile);
+        ++generated;
+      }, 2, 2);
+      CP_DF_ALS<tensor, conv_class> tiled(btas::DFTileSource<tensor>(D4, 4), right);
+      conv_class conv_tiled(1e-3);
+      conv_tiled.set_norm(norm42);
+      tiled.compute_rank_random(5, conv_tiled, 20, false, true);
+
+      CHECK(std::abs(conv_tiled.get_fit() - conv_dense.get_fit()) <= epsilon);
+      auto diff = tiled.reconstruct() - dense.reconstruct();
+      CHECK(sqrt(dot(diff, diff)) / norm42 <= epsilon);
+      CHECK(generated > 3);
+      CP_DF_ALS<tensor, conv_class> svd_guess(btas::DFTileSource<tensor>(D4), right);
+      CHECK_THROWS(svd_guess.compute_rank(5, conv_tiled, 1, true, 5));
+    }
+  }
 }
 #endif //BTAS_HAS_CBLAS